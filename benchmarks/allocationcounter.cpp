@@ -0,0 +1,88 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<qint64> allocationCount(0);
+
+inline void countAllocation()
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+qint64 AllocationCounter::count()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+
+// The definitions in the executable take precedence over the ones of the C
+// library for every shared library loaded by the process
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+} // extern "C"
+
+bool AllocationCounter::countsMalloc()
+{
+    return true;
+}
+
+#else
+
+void *operator new(size_t size)
+{
+    countAllocation();
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+bool AllocationCounter::countsMalloc()
+{
+    return false;
+}
+
+#endif
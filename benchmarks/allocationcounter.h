@@ -0,0 +1,16 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts the heap allocations of the process, from every thread. With glibc
+// malloc, calloc and realloc are interposed, which also covers operator new
+// and the Qt containers; elsewhere only operator new is counted.
+class AllocationCounter
+{
+public:
+    static qint64 count();
+    static bool countsMalloc();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,60 @@
+#-------------------------------------------------
+#
+# Microbenchmarks of the CPU side setup paths, built separately from the
+# demo: qmake benchmarks/benchmarks.pro && make
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = setup-benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+SOURCES += main.cpp \
+    allocationcounter.cpp \
+    setupbenchmark.cpp \
+    ../globjectdescriptor.cpp \
+    ../shaderbuilder.cpp \
+    ../filtergraph.cpp \
+    ../colorlut.cpp \
+    ../meshloader.cpp \
+    ../meshcache.cpp \
+    ../meshlod.cpp \
+    ../vertexquantizer.cpp \
+    ../proceduralgeometry.cpp \
+    ../rawimage.cpp \
+    ../tracer.cpp
+
+HEADERS += allocationcounter.h \
+    setupbenchmark.h \
+    ../globjectdescriptor.h \
+    ../shaderbuilder.h \
+    ../filtergraph.h \
+    ../colorlut.h \
+    ../meshloader.h \
+    ../meshcache.h \
+    ../meshlod.h \
+    ../vertexquantizer.h \
+    ../proceduralgeometry.h \
+    ../rawimage.h \
+    ../tracer.h
+
+CONFIG(debug, debug|release) {
+    DESTDIR = build/debug
+} else {
+    DESTDIR = build/release
+}
+
+OBJECTS_DIR = $${DESTDIR}/.obj
+MOC_DIR = $${DESTDIR}/.moc
+RCC_DIR = $${DESTDIR}/.rcc
+
+RESOURCES += \
+    ../images.qrc \
+    ../shaders.qrc
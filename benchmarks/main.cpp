@@ -0,0 +1,27 @@
+#include "allocationcounter.h"
+#include "setupbenchmark.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the CPU side setup paths, prints CSV to stdout.");
+    parser.addHelpOption();
+    QCommandLineOption minimumTimeOption("min-time", "Measure every case for at least <ms> milliseconds, 200 by default.", "ms", "200");
+    parser.addOption(minimumTimeOption);
+    QCommandLineOption filterOption("filter", "Only run the benchmarks whose name contains <name>.", "name");
+    parser.addOption(filterOption);
+    parser.process(a);
+
+    if (!AllocationCounter::countsMalloc())
+        qWarning() << "Only operator new is counted, allocations of the Qt containers are missing";
+
+    SetupBenchmark benchmark(parser.value(minimumTimeOption).toDouble(), parser.value(filterOption));
+    return benchmark.run();
+}
@@ -0,0 +1,173 @@
+#include "setupbenchmark.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include "allocationcounter.h"
+#include "globjectdescriptor.h"
+#include "shaderbuilder.h"
+
+namespace {
+
+ShaderConfig shaderConfig(ShaderConfig::IPShader imageProcessShader)
+{
+    ShaderConfig config;
+    config.animEnabled = false;
+    config.vertexShader = ShaderConfig::NoVertexShader;
+    config.gray = false;
+    config.invert = false;
+    config.threshold = false;
+    config.imageProcessShader = imageProcessShader;
+    config.reducedPrecision = false;
+    config.comparisonView = false;
+    return config;
+}
+
+} // namespace
+
+SetupBenchmark::SetupBenchmark(double minimumTime, const QString &filter)
+    : m_minimumTime(minimumTime)
+    , m_filter(filter)
+    , m_out(stdout)
+{
+}
+
+int SetupBenchmark::run()
+{
+    m_out << "benchmark,parameter,iterations,ns_per_op,allocs_per_op\n";
+    m_out.flush();
+
+    QVector<float> kernel;
+    const int kernelRadii[] = { 1, 2, 4, 8, 16 };
+    for (unsigned i = 0; i < sizeof(kernelRadii) / sizeof(kernelRadii[0]); ++i) {
+        const int radius = kernelRadii[i];
+        measure("computeGaussianKernel", QString::number(radius), [&]() {
+            kernel = ShaderBuilder::computeGaussianKernel(radius, 3.5);
+        });
+    }
+
+    {
+        ShaderBuilder shaderBuilder("120");
+        QStringList code;
+        measure("readShaderFile", "functions-120.frag", [&]() {
+            code = shaderBuilder.readShaderFile(":/shaders/functions-120.frag");
+        });
+    }
+
+    const ShaderConfig::IPShader shaders[] = {
+        ShaderConfig::None,
+        ShaderConfig::Gauss,
+        ShaderConfig::Sobel,
+        ShaderConfig::SobelGauss,
+        ShaderConfig::Canny,
+        ShaderConfig::LargeBlur,
+        ShaderConfig::AdaptiveThreshold,
+        ShaderConfig::Median,
+        ShaderConfig::Bilateral
+    };
+    const char *shaderNames[] = { "none", "gauss", "sobel", "sobelgauss", "canny", "largeblur", "adaptivethreshold", "median", "bilateral" };
+
+    for (unsigned i = 0; i < sizeof(shaders) / sizeof(shaders[0]); ++i) {
+        ShaderConfig config = shaderConfig(shaders[i]);
+
+        // The variables and main body of the image object
+        ShaderBuilder shaderBuilder("120");
+        shaderBuilder.setVariables(QOpenGLShader::Vertex, QStringList()
+                                   << "uniform mat4 mvpMatrix;"
+                                   << "attribute vec4 vertex;"
+                                   << "attribute vec2 textureCoordinate;"
+                                   << "varying vec2 varyingTextureCoordinate;");
+        shaderBuilder.setMainBody(QOpenGLShader::Vertex, QStringList()
+                                  << "varyingTextureCoordinate = textureCoordinate;"
+                                  << "gl_Position = mvpMatrix * vertex;");
+        shaderBuilder.setVariables(QOpenGLShader::Fragment, QStringList()
+                                   << "uniform int animProgress;"
+                                   << "uniform sampler2D texture;"
+                                   << "uniform sampler2D inputTexture;"
+                                   << "uniform vec2 textureSize;"
+                                   << "varying vec2 varyingTextureCoordinate;");
+        shaderBuilder.setMainBody(QOpenGLShader::Fragment, QStringList()
+                                  << "gl_FragColor = texture2D(texture, varyingTextureCoordinate);");
+        shaderBuilder.setShaderConfig(&config);
+
+        QStringList code;
+        measure("getShaderCode.vertex", shaderNames[i], [&]() {
+            code = shaderBuilder.getShaderCode(QOpenGLShader::Vertex);
+        });
+        measure("getShaderCode.fragment", shaderNames[i], [&]() {
+            code = shaderBuilder.getShaderCode(QOpenGLShader::Fragment);
+        });
+
+        GLObjectDescriptor descriptor;
+        measure("buildShaderCode", shaderNames[i], [&]() {
+            descriptor.buildShaderCode(GLObjectDescriptor::ImageObject, &config);
+        });
+    }
+
+    ShaderConfig config = shaderConfig(ShaderConfig::None);
+
+    const int triangleCounts[] = { 16, 256, 4096 };
+    for (unsigned i = 0; i < sizeof(triangleCounts) / sizeof(triangleCounts[0]); ++i) {
+        const int triangleCount = triangleCounts[i];
+        measure("createConeDescriptor", QString::number(triangleCount), [&]() {
+            delete GLObjectDescriptor::createConeDescriptor(&config, triangleCount);
+        });
+    }
+
+    measure("createCubeDescriptor", "-", [&]() {
+        delete GLObjectDescriptor::createCubeDescriptor(&config);
+    });
+
+    measure("createImageDescriptor", "qt-logo.png", [&]() {
+        delete GLObjectDescriptor::createImageDescriptor(&config, ":/images/qt-logo.png");
+    });
+
+    const GLObjectDescriptor::GLObjectId shapes[] = {
+        GLObjectDescriptor::SphereObject,
+        GLObjectDescriptor::TorusObject,
+        GLObjectDescriptor::GridObject
+    };
+    const char *shapeNames[] = { "sphere", "torus", "grid" };
+    const int segmentCounts[] = { 16, 64, 256 };
+    for (unsigned i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+        for (unsigned j = 0; j < sizeof(segmentCounts) / sizeof(segmentCounts[0]); ++j) {
+            const GLObjectDescriptor::GLObjectId shape = shapes[i];
+            const int segments = segmentCounts[j];
+            measure("createProceduralDescriptor", QString("%0 %1").arg(shapeNames[i]).arg(segments), [&]() {
+                delete GLObjectDescriptor::createProceduralDescriptor(&config, shape, segments);
+            });
+        }
+    }
+
+    return 0;
+}
+
+void SetupBenchmark::measure(const QString &name, const QString &parameter, const std::function<void()> &operation)
+{
+    if (!m_filter.isEmpty() && !name.contains(m_filter, Qt::CaseInsensitive))
+        return;
+
+    // The first call fills the static caches, the second one sizes the batch
+    operation();
+
+    QElapsedTimer timer;
+    timer.start();
+    operation();
+    const qint64 single = qMax(timer.nsecsElapsed(), qint64(1));
+    const qint64 iterations = qBound(qint64(1), qint64(m_minimumTime * 1000000.0 / single), qint64(10000000));
+
+    const qint64 allocations = AllocationCounter::count();
+    timer.restart();
+    for (qint64 i = 0; i < iterations; ++i)
+        operation();
+    const qint64 elapsed = timer.nsecsElapsed();
+    const qint64 allocated = AllocationCounter::count() - allocations;
+
+    m_out << QString("%0,%1,%2,%3,%4\n")
+             .arg(name)
+             .arg(parameter)
+             .arg(iterations)
+             .arg(double(elapsed) / iterations, 0, 'f', 1)
+             .arg(double(allocated) / iterations, 0, 'f', 2);
+    m_out.flush();
+}
@@ -0,0 +1,29 @@
+#ifndef SETUPBENCHMARK_H
+#define SETUPBENCHMARK_H
+
+#include <QString>
+#include <QTextStream>
+
+#include <functional>
+
+// Measures the CPU side setup paths which run on startup and whenever the
+// object descriptor is rebuilt: the Gaussian kernel, reading the shader
+// functions, assembling the shader code and creating the descriptors. Each
+// case is swept over its parameter and printed as one CSV line with the
+// nanoseconds and heap allocations per operation.
+class SetupBenchmark
+{
+public:
+    explicit SetupBenchmark(double minimumTime = 200.0, const QString &filter = QString());
+
+    int run();
+
+private:
+    void measure(const QString &name, const QString &parameter, const std::function<void()> &operation);
+
+    double m_minimumTime;
+    QString m_filter;
+    QTextStream m_out;
+};
+
+#endif // SETUPBENCHMARK_H
@@ -0,0 +1,169 @@
+#include "colorlut.h"
+
+#include <math.h>
+#include <QOpenGLTexture>
+#include <QStringList>
+#include <QtConcurrent>
+
+namespace {
+
+// lightness() in functions-120.frag
+inline float lightness(const QVector3D &color)
+{
+    const float cmax = qMax(color.x(), qMax(color.y(), color.z()));
+    const float cmin = qMin(color.x(), qMin(color.y(), color.z()));
+    return (cmax + cmin) / 2.0f;
+}
+
+inline float clamp01(float value)
+{
+    return qBound(0.0f, value, 1.0f);
+}
+
+inline QVector3D clamp01(const QVector3D &color)
+{
+    return QVector3D(clamp01(color.x()), clamp01(color.y()), clamp01(color.z()));
+}
+
+float levels(float value, float black, float white, float gamma)
+{
+    value = clamp01((value - black) / qMax(white - black, 1.0e-4f));
+    return pow(value, 1.0f / qMax(gamma, 1.0e-4f));
+}
+
+// Catmull-Rom spline through the control values, which are placed at evenly
+// spaced inputs. The end values are repeated as the outer control points.
+float curve(float value, const QVector<float> &points)
+{
+    const int segments = points.count() - 1;
+    const float position = clamp01(value) * segments;
+    const int segment = qMin(int(position), segments - 1);
+    const float t = position - segment;
+
+    const float p0 = points.at(qMax(segment - 1, 0));
+    const float p1 = points.at(segment);
+    const float p2 = points.at(segment + 1);
+    const float p3 = points.at(qMin(segment + 2, segments));
+
+    return clamp01(0.5f * (2.0f * p1
+                           + (p2 - p0) * t
+                           + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t
+                           + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t * t * t));
+}
+
+// ASC CDL slope, offset and power
+float grade(float value, float slope, float offset, float power)
+{
+    return clamp01(pow(qMax(value * slope + offset, 0.0f), power));
+}
+
+QVector3D applyNode(const FilterNode &node, const QVector3D &color)
+{
+    switch (node.operation) {
+    case FilterNode::Gray: {
+        const float l = lightness(color);
+        return QVector3D(l, l, l);
+    }
+    case FilterNode::Invert:
+        return QVector3D(1.0f, 1.0f, 1.0f) - color;
+    case FilterNode::Threshold: {
+        const float i = lightness(color) < node.parameter(0, 0.5) ? 0.0f : 1.0f;
+        return QVector3D(i, i, i);
+    }
+    case FilterNode::Levels: {
+        const float black = node.parameter(0, 0.0);
+        const float white = node.parameter(1, 1.0);
+        const float gamma = node.parameter(2, 1.0);
+        return QVector3D(levels(color.x(), black, white, gamma),
+                         levels(color.y(), black, white, gamma),
+                         levels(color.z(), black, white, gamma));
+    }
+    case FilterNode::Curves:
+        return QVector3D(curve(color.x(), node.parameters),
+                         curve(color.y(), node.parameters),
+                         curve(color.z(), node.parameters));
+    case FilterNode::Saturation: {
+        // Rec. 709 luma keeps the perceived brightness
+        const float luma = QVector3D::dotProduct(color, QVector3D(0.2126f, 0.7152f, 0.0722f));
+        const QVector3D gray(luma, luma, luma);
+        return clamp01(gray + (color - gray) * node.parameter(0, 1.0));
+    }
+    case FilterNode::Grade: {
+        // Three parameters apply to every channel, nine to one channel each
+        const int stride = (node.parameters.count() == 9) ? 3 : 1;
+        QVector3D result;
+        for (int channel = 0; channel < 3; ++channel) {
+            const int index = (stride == 3) ? channel : 0;
+            result[channel] = grade(color[channel],
+                                    node.parameter(index, 1.0),
+                                    node.parameter(index + stride, 0.0),
+                                    node.parameter(index + 2 * stride, 1.0));
+        }
+        return result;
+    }
+    default:
+        return color;
+    }
+}
+
+} // namespace
+
+QVector<GLubyte> ColorLut::bake(const QVector<FilterNode> &nodes, int size)
+{
+    QVector<GLubyte> table(size * size * size * 4);
+    GLubyte *tableData = table.data();
+
+    // One blue slice per task, the slices do not share any output
+    QVector<int> slices;
+    for (int blue = 0; blue < size; ++blue)
+        slices.append(blue);
+
+    QtConcurrent::blockingMap(slices, [&](int &blue) {
+        GLubyte *texel = tableData + blue * size * size * 4;
+        for (int green = 0; green < size; ++green) {
+            for (int red = 0; red < size; ++red) {
+                const QVector3D input(float(red) / (size - 1), float(green) / (size - 1), float(blue) / (size - 1));
+                const QVector3D output = clamp01(apply(nodes, input));
+                *texel++ = qRound(output.x() * 255.0f);
+                *texel++ = qRound(output.y() * 255.0f);
+                *texel++ = qRound(output.z() * 255.0f);
+                *texel++ = 255;
+            }
+        }
+    });
+
+    return table;
+}
+
+QVector3D ColorLut::apply(const QVector<FilterNode> &nodes, const QVector3D &color)
+{
+    QVector3D result = color;
+    foreach (const FilterNode &node, nodes)
+        result = applyNode(node, result);
+
+    return result;
+}
+
+QOpenGLTexture *ColorLut::createTexture(const QVector<FilterNode> &nodes)
+{
+    const QVector<GLubyte> table = bake(nodes);
+
+    QOpenGLTexture *texture = new QOpenGLTexture(QOpenGLTexture::Target3D);
+    texture->setSize(Size, Size, Size);
+    texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    texture->allocateStorage();
+    texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, table.constData());
+
+    return texture;
+}
+
+QString ColorLut::key(const QVector<FilterNode> &nodes)
+{
+    FilterGraph graph;
+    foreach (const FilterNode &node, nodes)
+        graph.append(node);
+
+    return graph.toString();
+}
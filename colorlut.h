@@ -0,0 +1,32 @@
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <QOpenGLFunctions>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+#include "filtergraph.h"
+
+class QOpenGLTexture;
+
+// Bakes a chain of point-wise filter nodes into a Size^3 RGBA8 lookup table
+// indexed by the input color, red varying fastest. The nodes are evaluated
+// with the same definitions as functions-120.frag, applyColorLut() samples
+// the table at the texel centres so black and white map exactly.
+class ColorLut
+{
+public:
+    static const int Size = 33;
+
+    static QVector<GLubyte> bake(const QVector<FilterNode> &nodes, int size = Size);
+    static QVector3D apply(const QVector<FilterNode> &nodes, const QVector3D &color);
+
+    // Bakes the table into a linearly filtered 3D texture, needs a current context
+    static QOpenGLTexture *createTexture(const QVector<FilterNode> &nodes);
+
+    // Equal keys bake equal tables
+    static QString key(const QVector<FilterNode> &nodes);
+};
+
+#endif // COLORLUT_H
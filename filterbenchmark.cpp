@@ -0,0 +1,573 @@
+#include "filterbenchmark.h"
+
+#include <algorithm>
+#include <math.h>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMatrix4x4>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QTextStream>
+#include <QVector4D>
+
+#include "filterpipeline.h"
+#include "globjectdescriptor.h"
+#include "rendertargetpool.h"
+#include "shaderbuilder.h"
+#include "shadercompiler.h"
+
+namespace {
+
+// Single channel image for the reference of the large blur
+struct Plane {
+    explicit Plane(const QSize &size) : size(size), values(size.width() * size.height(), 0.0f) {}
+
+    float at(int x, int y) const
+    {
+        x = qBound(0, x, size.width() - 1);
+        y = qBound(0, y, size.height() - 1);
+        return values.at(y * size.width() + x);
+    }
+
+    // Bilinear filtering with clamp to edge, as the targets are sampled
+    float sample(float s, float t) const
+    {
+        const float x = s * size.width() - 0.5f;
+        const float y = t * size.height() - 0.5f;
+        const int x0 = int(floor(x));
+        const int y0 = int(floor(y));
+        const float fx = x - x0;
+        const float fy = y - y0;
+        return (at(x0, y0) * (1.0f - fx) + at(x0 + 1, y0) * fx) * (1.0f - fy)
+                + (at(x0, y0 + 1) * (1.0f - fx) + at(x0 + 1, y0 + 1) * fx) * fy;
+    }
+
+    QSize size;
+    QVector<float> values;
+};
+
+QSize levelSize(const QSize &size, int level)
+{
+    return QSize(qMax(size.width() >> level, 1), qMax(size.height() >> level, 1));
+}
+
+// The same taps as dualDownsample() and dualUpsample() in functions-120.frag
+Plane resample(const Plane &input, const QSize &outputSize, bool down)
+{
+    Plane output(outputSize);
+    const float dx = 0.5f / outputSize.width();
+    const float dy = 0.5f / outputSize.height();
+    for (int y = 0; y < outputSize.height(); ++y) {
+        for (int x = 0; x < outputSize.width(); ++x) {
+            const float s = (x + 0.5f) / outputSize.width();
+            const float t = (y + 0.5f) / outputSize.height();
+            float value;
+            if (down) {
+                value = (input.sample(s, t) * 4.0f
+                         + input.sample(s - dx, t - dy) + input.sample(s + dx, t + dy)
+                         + input.sample(s + dx, t - dy) + input.sample(s - dx, t + dy)) / 8.0f;
+            } else {
+                value = (input.sample(s - 2.0f * dx, t) + input.sample(s + 2.0f * dx, t)
+                         + input.sample(s, t - 2.0f * dy) + input.sample(s, t + 2.0f * dy)
+                         + 2.0f * (input.sample(s - dx, t + dy) + input.sample(s + dx, t + dy)
+                                   + input.sample(s + dx, t - dy) + input.sample(s - dx, t - dy))) / 12.0f;
+            }
+            output.values[y * outputSize.width() + x] = value;
+        }
+    }
+
+    return output;
+}
+
+QRgb clampedPixel(const QImage &image, int x, int y)
+{
+    x = qBound(0, x, image.width() - 1);
+    y = qBound(0, y, image.height() - 1);
+    return reinterpret_cast<const QRgb *>(image.constScanLine(y))[x];
+}
+
+// Sorts the whole window of every channel
+QImage medianReference(const QImage &image, int windowSize)
+{
+    QImage result(image.size(), QImage::Format_RGB32);
+    const int radius = windowSize / 2;
+    const int count = windowSize * windowSize;
+    int values[3][25];
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(result.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            int n = 0;
+            for (int j = -radius; j <= radius; ++j) {
+                for (int i = -radius; i <= radius; ++i, ++n) {
+                    const QRgb pixel = clampedPixel(image, x + i, y + j);
+                    values[0][n] = qRed(pixel);
+                    values[1][n] = qGreen(pixel);
+                    values[2][n] = qBlue(pixel);
+                }
+            }
+            for (int channel = 0; channel < 3; ++channel)
+                std::sort(values[channel], values[channel] + count);
+            line[x] = qRgb(values[0][count / 2], values[1][count / 2], values[2][count / 2]);
+        }
+    }
+
+    return result;
+}
+
+// The full square window with the weights of bilateralPass()
+QImage bilateralReference(const QImage &image, int radius, float sigmaRange)
+{
+    QImage result(image.size(), QImage::Format_RGB32);
+    const float spatialScale = -2.0f / (radius * radius);
+    const float rangeScale = -0.5f / (sigmaRange * sigmaRange);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(result.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const QRgb center = clampedPixel(image, x, y);
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            float weightSum = 0.0f;
+            for (int j = -radius; j <= radius; ++j) {
+                for (int i = -radius; i <= radius; ++i) {
+                    const QRgb pixel = clampedPixel(image, x + i, y + j);
+                    const float dr = (qRed(pixel) - qRed(center)) / 255.0f;
+                    const float dg = (qGreen(pixel) - qGreen(center)) / 255.0f;
+                    const float db = (qBlue(pixel) - qBlue(center)) / 255.0f;
+                    const float weight = exp((i * i + j * j) * spatialScale + (dr * dr + dg * dg + db * db) * rangeScale);
+                    sum[0] += qRed(pixel) * weight;
+                    sum[1] += qGreen(pixel) * weight;
+                    sum[2] += qBlue(pixel) * weight;
+                    weightSum += weight;
+                }
+            }
+            line[x] = qRgb(qRound(sum[0] / weightSum), qRound(sum[1] / weightSum), qRound(sum[2] / weightSum));
+        }
+    }
+
+    return result;
+}
+
+Plane largeBlur(const Plane &input, int levels)
+{
+    Plane plane = input;
+    for (int level = 1; level <= levels; ++level)
+        plane = resample(plane, levelSize(input.size, level), true);
+    for (int level = levels - 1; level >= 0; --level)
+        plane = resample(plane, levelSize(input.size, level), false);
+
+    return plane;
+}
+
+} // namespace
+
+FilterBenchmark::FilterBenchmark(const QSize &imageSize, int iterations)
+    : m_imageSize(imageSize)
+    , m_iterations(iterations)
+{
+}
+
+int FilterBenchmark::run()
+{
+    QOffscreenSurface surface;
+    surface.create();
+
+    QOpenGLContext context;
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        qWarning() << "Unable to create OpenGL context for the benchmark";
+        return 1;
+    }
+    initializeOpenGLFunctions();
+
+    const bool reducedSupported = RenderTargetPool::supportsReducedFormats(&context);
+
+    // Deterministic noise over a gradient so the edge detectors have work
+    QImage image(m_imageSize, QImage::Format_RGB32);
+    quint32 seed = 1;
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            seed = seed * 1664525 + 1013904223;
+            int noise = (seed >> 24) & 0x3f;
+            line[x] = qRgb((x * 255 / image.width() + noise) & 0xff, (y * 255 / image.height()) & 0xff, noise * 4);
+        }
+    }
+
+    {
+        QOpenGLTexture texture(image);
+        ShaderCompiler shaderCompiler(0);
+        RenderTargetPool renderTargetPool;
+        FilterPipeline filterPipeline;
+        filterPipeline.initialize(&shaderCompiler, &renderTargetPool);
+
+        const ShaderConfig::IPShader shaders[] = {
+            ShaderConfig::Gauss,
+            ShaderConfig::Sobel,
+            ShaderConfig::SobelGauss,
+            ShaderConfig::Canny,
+            ShaderConfig::AdaptiveThreshold
+        };
+        const char *shaderNames[] = { "Gauss", "Sobel", "SobelGauss", "Canny", "AdaptThresh" };
+
+        QVector<ShaderConfig> shaderConfigs;
+        QStringList names;
+        for (unsigned i = 0; i < sizeof(shaders) / sizeof(shaders[0]); ++i) {
+            ShaderConfig shaderConfig;
+            shaderConfig.animEnabled = false;
+            shaderConfig.vertexShader = ShaderConfig::NoVertexShader;
+            shaderConfig.gray = false;
+            shaderConfig.invert = false;
+            shaderConfig.threshold = false;
+            shaderConfig.imageProcessShader = shaders[i];
+            shaderConfig.reducedPrecision = false;
+            shaderConfig.comparisonView = false;
+            shaderConfigs.append(shaderConfig);
+            names.append(shaderNames[i]);
+        }
+
+        // Each level doubles the radius of the large blur
+        for (int levels = 1; levels <= FilterPlanner::MaxLargeBlurLevels; ++levels) {
+            ShaderConfig shaderConfig = shaderConfigs.first();
+            shaderConfig.imageProcessShader = ShaderConfig::LargeBlur;
+            shaderConfig.filterGraph.append(FilterNode::LargeBlur, levels);
+            shaderConfigs.append(shaderConfig);
+            names.append(QString("LargeBlur(%0)").arg(levels));
+        }
+
+        // The box filter reads four corners of the summed area table
+        const int boxRadii[] = { 2, 32, 512 };
+        for (unsigned i = 0; i < sizeof(boxRadii) / sizeof(boxRadii[0]); ++i) {
+            ShaderConfig shaderConfig = shaderConfigs.first();
+            shaderConfig.imageProcessShader = ShaderConfig::None;
+            shaderConfig.filterGraph.append(FilterNode::BoxBlur, boxRadii[i]);
+            shaderConfigs.append(shaderConfig);
+            names.append(QString("Box(%0)").arg(boxRadii[i]));
+        }
+
+        // Edge preserving denoise, also compared with brute force
+        // references after the tables
+        const int medianSizes[] = { 3, 5 };
+        for (unsigned i = 0; i < sizeof(medianSizes) / sizeof(medianSizes[0]); ++i) {
+            ShaderConfig shaderConfig = shaderConfigs.first();
+            shaderConfig.imageProcessShader = ShaderConfig::None;
+            shaderConfig.filterGraph.append(FilterNode::Median, medianSizes[i]);
+            shaderConfigs.append(shaderConfig);
+            names.append(QString("Median(%0)").arg(medianSizes[i]));
+        }
+        const int bilateralRadii[] = { 2, 4, 8 };
+        for (unsigned i = 0; i < sizeof(bilateralRadii) / sizeof(bilateralRadii[0]); ++i) {
+            ShaderConfig shaderConfig = shaderConfigs.first();
+            shaderConfig.imageProcessShader = ShaderConfig::None;
+            shaderConfig.filterGraph.append(FilterNode::Bilateral, bilateralRadii[i]);
+            shaderConfigs.append(shaderConfig);
+            names.append(QString("Bilateral(%0)").arg(bilateralRadii[i]));
+        }
+
+        const double pixels = double(m_imageSize.width()) * m_imageSize.height();
+
+        QOpenGLFramebufferObject *output = renderTargetPool.acquire(m_imageSize);
+
+        QTextStream out(stdout);
+        out << QString("Filter benchmark %0x%1, %2 iterations\n").arg(m_imageSize.width()).arg(m_imageSize.height()).arg(m_iterations);
+        out << QString("%0 %1 %2 %3 %4 %5\n")
+               .arg("filter", -13).arg("precision", -10).arg("passes", 7)
+               .arg("fetches/px", 11).arg("MB/frame", 10).arg("ms/frame", 10);
+
+        for (int i = 0; i < shaderConfigs.count(); ++i) {
+            for (int reduced = 0; reduced <= 1; ++reduced) {
+                if (reduced && !reducedSupported)
+                    continue;
+
+                ShaderConfig shaderConfig = shaderConfigs.at(i);
+                shaderConfig.reducedPrecision = reduced;
+
+                GLObjectDescriptor descriptor;
+                descriptor.buildShaderCode(GLObjectDescriptor::ImageObject, &shaderConfig);
+                filterPipeline.setPasses(&descriptor);
+
+                QOpenGLShaderProgram *program = shaderCompiler.program(descriptor.getVertexShaderCode(), descriptor.getFragmentShaderCode());
+                const double frameTime = renderFrames(&filterPipeline, program, texture.textureId(), output);
+
+                const FilterPlan &plan = descriptor.getFilterPlan();
+                out << QString("%0 %1 %2 %3 %4 %5\n")
+                       .arg(names.at(i), -13)
+                       .arg(reduced ? "reduced" : "full", -10)
+                       .arg(plan.passCount(), 7)
+                       .arg(plan.fetchesPerPixel(), 11, 'f', 1)
+                       .arg(plan.estimatedBytesPerPixel() * pixels / (1024.0 * 1024.0), 10, 'f', 1)
+                       .arg(frameTime, 10, 'f', 2);
+                out.flush();
+            }
+        }
+
+        // A centred region of interest, every step is scissored to what the
+        // following ones read of it
+        out << "\nRegion of interest, centred\n";
+        out << QString("%0 %1 %2\n").arg("filter", -13).arg("area %", 7).arg("ms/frame", 10);
+        const double areas[] = { 1.0, 0.25, 0.0625, 0.01 };
+        // Gauss, Sobel, SobelGauss and Canny
+        for (int i = 0; i < 4; ++i) {
+            ShaderConfig shaderConfig = shaderConfigs.at(i);
+            GLObjectDescriptor descriptor;
+            descriptor.buildShaderCode(GLObjectDescriptor::ImageObject, &shaderConfig);
+            filterPipeline.setPasses(&descriptor);
+            QOpenGLShaderProgram *program = shaderCompiler.program(descriptor.getVertexShaderCode(), descriptor.getFragmentShaderCode());
+
+            for (unsigned j = 0; j < sizeof(areas) / sizeof(areas[0]); ++j) {
+                const double side = sqrt(areas[j]);
+                const QSize regionSize = (QSizeF(m_imageSize) * side).toSize();
+                const QRect region(QPoint((m_imageSize.width() - regionSize.width()) / 2,
+                                          (m_imageSize.height() - regionSize.height()) / 2), regionSize);
+                const bool whole = (areas[j] >= 1.0);
+                filterPipeline.setRegionOfInterest(whole ? QRect() : region);
+                const QVector4D textureRegion = whole ? QVector4D()
+                        : QVector4D(region.left() / double(m_imageSize.width()), region.top() / double(m_imageSize.height()),
+                                    (region.left() + region.width()) / double(m_imageSize.width()),
+                                    (region.top() + region.height()) / double(m_imageSize.height()));
+
+                out << QString("%0 %1 %2\n")
+                       .arg(names.at(i), -13)
+                       .arg(100.0 * areas[j], 7, 'f', 1)
+                       .arg(renderFrames(&filterPipeline, program, texture.textureId(), output, textureRegion), 10, 'f', 2);
+                out.flush();
+            }
+        }
+
+        filterPipeline.setRegionOfInterest(QRect());
+        filterPipeline.setPasses(0);
+        renderTargetPool.release(output);
+
+        compareEdgePreserving(&shaderCompiler, &renderTargetPool);
+    }
+
+    context.doneCurrent();
+
+    compareLargeBlur();
+    return 0;
+}
+
+// The offscreen passes and the object's pass into output, the first frame
+// compiles and allocates and is not measured. Returns the milliseconds per
+// frame, output holds the last one.
+double FilterBenchmark::renderFrames(FilterPipeline *filterPipeline, QOpenGLShaderProgram *program, GLuint texture,
+                                     QOpenGLFramebufferObject *output, const QVector4D &region)
+{
+    const QSize size = output->size();
+
+    QElapsedTimer timer;
+    for (int frame = 0; frame <= m_iterations; ++frame) {
+        if (frame == 1)
+            timer.start();
+
+        filterPipeline->invalidate();
+        GLuint resultTexture = filterPipeline->process(texture, size);
+
+        output->bind();
+        glViewport(0, 0, size.width(), size.height());
+        program->bind();
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, resultTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        program->setUniformValue("mvpMatrix", QMatrix4x4());
+        program->setUniformValue("texture", 0);
+        program->setUniformValue("inputTexture", 1);
+        program->setUniformValue("textureSize", QVector2D(size.width(), size.height()));
+        program->setUniformValue("animProgress", 0);
+        program->setUniformValue("regionOfInterest", region);
+        filterPipeline->drawQuad(program);
+        program->release();
+        output->release();
+
+        glFinish();
+    }
+
+    return double(timer.nsecsElapsed()) / m_iterations / 1000000.0;
+}
+
+void FilterBenchmark::compareEdgePreserving(ShaderCompiler *shaderCompiler, RenderTargetPool *renderTargetPool)
+{
+    // Flat squares under noise, which the filters should smooth without
+    // blurring the edges between them. The references run on the CPU, so
+    // the image is kept small.
+    const QSize size(512, 512);
+    const QRgb colors[] = { qRgb(40, 60, 200), qRgb(220, 180, 40), qRgb(120, 200, 120), qRgb(200, 60, 80) };
+    QImage image(size, QImage::Format_RGB32);
+    quint32 seed = 7;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const QRgb color = colors[(x / 64 + 3 * (y / 64)) % 4];
+            seed = seed * 1664525 + 1013904223;
+            const int noise = int((seed >> 24) & 0x3f) - 32;
+            line[x] = qRgb(qBound(0, qRed(color) + noise, 255),
+                           qBound(0, qGreen(color) + noise, 255),
+                           qBound(0, qBlue(color) + noise, 255));
+        }
+    }
+
+    // The references clamp to the edge and read the texels unfiltered
+    QOpenGLTexture texture(image, QOpenGLTexture::DontGenerateMipMaps);
+    texture.setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+    texture.setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    FilterPipeline filterPipeline;
+    filterPipeline.initialize(shaderCompiler, renderTargetPool);
+    QOpenGLFramebufferObject *output = renderTargetPool->acquire(size);
+
+    QVector<FilterNode> nodes;
+    QStringList names;
+    nodes << FilterNode(FilterNode::Median, 3.0) << FilterNode(FilterNode::Median, 5.0);
+    names << "Median(3)" << "Median(5)";
+    const int bilateralRadii[] = { 2, 4, 8 };
+    for (unsigned i = 0; i < sizeof(bilateralRadii) / sizeof(bilateralRadii[0]); ++i) {
+        QVector<float> parameters;
+        parameters << bilateralRadii[i] << 0.1;
+        nodes << FilterNode(FilterNode::Bilateral, parameters);
+        names << QString("Bilateral(%0)").arg(bilateralRadii[i]);
+    }
+
+    QTextStream out(stdout);
+    out << QString("\nMedian and bilateral filters against brute force references, %0x%1\n").arg(size.width()).arg(size.height());
+    out << QString("%0 %1 %2 %3 %4 %5 %6\n")
+           .arg("filter", -13).arg("fetches/px", 11).arg("brute/px", 9)
+           .arg("gpu ms", 8).arg("brute ms", 9).arg("max error", 10).arg("rms error", 10);
+
+    for (int i = 0; i < nodes.count(); ++i) {
+        const FilterNode &node = nodes.at(i);
+
+        ShaderConfig shaderConfig;
+        shaderConfig.animEnabled = false;
+        shaderConfig.vertexShader = ShaderConfig::NoVertexShader;
+        shaderConfig.gray = false;
+        shaderConfig.invert = false;
+        shaderConfig.threshold = false;
+        shaderConfig.imageProcessShader = ShaderConfig::None;
+        shaderConfig.reducedPrecision = false;
+        shaderConfig.comparisonView = false;
+        shaderConfig.filterGraph.append(node);
+
+        GLObjectDescriptor descriptor;
+        descriptor.buildShaderCode(GLObjectDescriptor::ImageObject, &shaderConfig);
+        filterPipeline.setPasses(&descriptor);
+        QOpenGLShaderProgram *program = shaderCompiler->program(descriptor.getVertexShaderCode(), descriptor.getFragmentShaderCode());
+        const double frameTime = renderFrames(&filterPipeline, program, texture.textureId(), output);
+
+        // Rows are read bottom up, which is the order of the image rows in
+        // the texture
+        QImage result(size, QImage::Format_RGBA8888);
+        output->bind();
+        glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, result.bits());
+        output->release();
+
+        QElapsedTimer timer;
+        timer.start();
+        int window;
+        QImage reference;
+        if (node.operation == FilterNode::Median) {
+            window = int(node.parameter(0));
+            reference = medianReference(image, window);
+        } else {
+            const int radius = int(node.parameter(0));
+            window = 2 * radius + 1;
+            reference = bilateralReference(image, radius, node.parameter(1));
+        }
+        const double referenceTime = double(timer.nsecsElapsed()) / 1000000.0;
+
+        int maxError = 0;
+        double squaredError = 0.0;
+        for (int y = 0; y < size.height(); ++y) {
+            for (int x = 0; x < size.width(); ++x) {
+                const QRgb filtered = result.pixel(x, y);
+                const QRgb expected = reference.pixel(x, y);
+                const int errors[] = { qAbs(qRed(filtered) - qRed(expected)),
+                                       qAbs(qGreen(filtered) - qGreen(expected)),
+                                       qAbs(qBlue(filtered) - qBlue(expected)) };
+                for (int channel = 0; channel < 3; ++channel) {
+                    maxError = qMax(maxError, errors[channel]);
+                    squaredError += errors[channel] * errors[channel];
+                }
+            }
+        }
+
+        out << QString("%0 %1 %2 %3 %4 %5 %6\n")
+               .arg(names.at(i), -13)
+               .arg(descriptor.getFilterPlan().fetchesPerPixel(), 11, 'f', 1)
+               .arg(window * window, 9)
+               .arg(frameTime, 8, 'f', 2)
+               .arg(referenceTime, 9, 'f', 1)
+               .arg(maxError, 10)
+               .arg(sqrt(squaredError / (3.0 * size.width() * size.height())), 10, 'f', 2);
+        out.flush();
+    }
+
+    filterPipeline.setPasses(0);
+    renderTargetPool->release(output);
+}
+
+void FilterBenchmark::compareLargeBlur()
+{
+    QTextStream out(stdout);
+    out << "\nLarge blur against the exact Gaussian of the same standard deviation\n";
+    out << QString("%0 %1 %2 %3 %4 %5 %6\n")
+           .arg("levels", 6).arg("sigma", 7).arg("radius", 7)
+           .arg("fetches/px", 11).arg("gauss 2D", 10).arg("separable", 10)
+           .arg("kernel error %", 15);
+
+    for (int levels = 1; levels <= FilterPlanner::MaxLargeBlurLevels; ++levels) {
+        // The response to an impulse is the kernel of the whole pyramid
+        const int size = 32 << levels;
+        Plane impulse(QSize(size, size));
+        const int center = size / 2;
+        impulse.values[center * size + center] = 1.0f;
+        const Plane response = largeBlur(impulse, levels);
+
+        double sum = 0.0, meanX = 0.0, meanY = 0.0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const float value = response.at(x, y);
+                sum += value;
+                meanX += value * x;
+                meanY += value * y;
+            }
+        }
+        meanX /= sum;
+        meanY /= sum;
+
+        double variance = 0.0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x)
+                variance += response.at(x, y) * ((x - meanX) * (x - meanX) + (y - meanY) * (y - meanY));
+        }
+        const double sigma = sqrt(variance / sum / 2.0);
+
+        // Root mean square difference of the kernels over the support of
+        // the Gaussian, relative to its peak
+        const int radius = int(ceil(3.0 * sigma));
+        const int kernelSize = 2 * radius + 1;
+        const QVector<float> kernel = ShaderBuilder::computeGaussianKernel(radius, sigma);
+        double squaredError = 0.0;
+        for (int i = -radius; i <= radius; ++i) {
+            for (int j = -radius; j <= radius; ++j) {
+                const double difference = response.at(center + j, center + i) / sum - kernel.at((j + radius) + (i + radius) * kernelSize);
+                squaredError += difference * difference;
+            }
+        }
+        const double kernelError = sqrt(squaredError / (kernelSize * kernelSize)) / kernel.at(radius + radius * kernelSize);
+
+        FilterGraph graph;
+        graph.append(FilterNode::LargeBlur, levels);
+        const FilterPlan plan = FilterPlanner::plan(graph);
+
+        out << QString("%0 %1 %2 %3 %4 %5 %6\n")
+               .arg(levels, 6)
+               .arg(sigma, 7, 'f', 2)
+               .arg(radius, 7)
+               .arg(plan.fetchesPerPixel(), 11, 'f', 1)
+               .arg(kernelSize * kernelSize, 10)
+               .arg(2 * kernelSize, 10)
+               .arg(100.0 * kernelError, 15, 'f', 2);
+        out.flush();
+    }
+}
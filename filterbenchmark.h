@@ -0,0 +1,37 @@
+#ifndef FILTERBENCHMARK_H
+#define FILTERBENCHMARK_H
+
+#include <QOpenGLFunctions>
+#include <QSize>
+#include <QVector4D>
+
+class FilterPipeline;
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+class RenderTargetPool;
+class ShaderCompiler;
+
+// Renders the filter plans of the image shaders offscreen with full and
+// reduced precision intermediates and prints the estimated bandwidth and the
+// measured frame time of each of them, also restricted to regions of
+// interest of decreasing area. The large blur is also compared with the
+// exact Gaussian of the same width, on a reference of its passes, and the
+// median and bilateral filters with brute force references on the CPU.
+class FilterBenchmark : protected QOpenGLFunctions
+{
+public:
+    explicit FilterBenchmark(const QSize &imageSize = QSize(3840, 2160), int iterations = 20);
+
+    int run();
+
+private:
+    double renderFrames(FilterPipeline *filterPipeline, QOpenGLShaderProgram *program, GLuint texture,
+                        QOpenGLFramebufferObject *output, const QVector4D &region = QVector4D());
+    void compareEdgePreserving(ShaderCompiler *shaderCompiler, RenderTargetPool *renderTargetPool);
+    void compareLargeBlur();
+
+    QSize m_imageSize;
+    int m_iterations;
+};
+
+#endif // FILTERBENCHMARK_H
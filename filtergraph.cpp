@@ -0,0 +1,536 @@
+#include "filtergraph.h"
+#include "shaderbuilder.h"
+
+#include <math.h>
+#include <QRegExp>
+#include <QStringList>
+
+static const struct {
+    FilterNode::Operation operation;
+    const char *name;
+    bool parsable;
+    int minParameters;
+    int maxParameters;
+} filterNames[] = {
+    { FilterNode::GaussBlur, "blur", true, 0, 0 },
+    { FilterNode::Sobel, "sobel", true, 0, 0 },
+    { FilterNode::SobelGauss, "sobelgauss", true, 0, 0 },
+    { FilterNode::Canny, "canny", true, 0, 0 },
+    // Number of half resolution levels of the pyramid
+    { FilterNode::LargeBlur, "largeblur", true, 0, 1 },
+    // Radius of the box, the cost does not depend on it
+    { FilterNode::BoxBlur, "box", true, 0, 1 },
+    // Radius of the window and Sauvola's k
+    { FilterNode::AdaptiveThreshold, "adaptivethreshold", true, 0, 2 },
+    // Size of the square window, 3 or 5
+    { FilterNode::Median, "median", true, 0, 1 },
+    // Radius of the window and sigma of the color difference
+    { FilterNode::Bilateral, "bilateral", true, 0, 2 },
+    // Only produced by the planner, they need a floating point target
+    { FilterNode::Gradient, "gradient", false, 0, 0 },
+    { FilterNode::EdgeSuppression, "suppress", false, 0, 0 },
+    // Only produced by the planner, a large blur is split into them
+    { FilterNode::Downsample, "downsample", false, 0, 0 },
+    { FilterNode::Upsample, "upsample", false, 0, 0 },
+    // Axis, stride, first pass and luma moments, see prefixSum()
+    { FilterNode::IntegralImage, "integral", false, 4, 4 },
+    // Axis, radius and range sigma, a bilateral filter is split into them
+    { FilterNode::BilateralPass, "bilateralpass", false, 3, 3 },
+    { FilterNode::Gray, "gray", true, 0, 0 },
+    { FilterNode::Invert, "invert", true, 0, 0 },
+    { FilterNode::Threshold, "threshold", true, 0, 1 },
+    // Black point, white point and gamma
+    { FilterNode::Levels, "levels", true, 0, 3 },
+    // Output values at evenly spaced inputs from 0 to 1
+    { FilterNode::Curves, "curves", true, 2, 16 },
+    { FilterNode::Saturation, "saturation", true, 1, 1 },
+    // Slope, offset and power, for all channels or for each of them
+    { FilterNode::Grade, "grade", true, 3, 9 },
+};
+
+static const int filterNameCount = sizeof(filterNames) / sizeof(filterNames[0]);
+
+FilterNode::FilterNode(Operation operation)
+    : operation(operation)
+{
+}
+
+FilterNode::FilterNode(Operation operation, float parameter)
+    : operation(operation)
+{
+    parameters.append(parameter);
+}
+
+FilterNode::FilterNode(Operation operation, const QVector<float> &parameters)
+    : operation(operation)
+    , parameters(parameters)
+{
+}
+
+bool FilterNode::isPointWise() const
+{
+    switch (operation) {
+    case Gray:
+    case Invert:
+    case Threshold:
+    case Levels:
+    case Curves:
+    case Saturation:
+    case Grade:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FilterNode::requiresColorLut() const
+{
+    switch (operation) {
+    case Levels:
+    case Curves:
+    case Saturation:
+    case Grade:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FilterNode::isDerivative() const
+{
+    switch (operation) {
+    case Sobel:
+    case SobelGauss:
+    case Canny:
+    case Gradient:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int FilterNode::fetchCount() const
+{
+    const int kernelSize = 2 * ShaderBuilder::gaussianKernelRadius() + 1;
+    const int gaussFetches = kernelSize * kernelSize;
+
+    switch (operation) {
+    case GaussBlur:
+        return gaussFetches;
+    case Sobel:
+        return 9;
+    case SobelGauss:
+        // Every Sobel tap is blurred separately
+        return 9 * gaussFetches;
+    case Canny:
+        // Gradient at the pixel and at both neighbours along the gradient
+        return 3 * 9 * gaussFetches;
+    case Gradient:
+        return 9;
+    case EdgeSuppression:
+        return 3;
+    case Downsample:
+        // The pixel and the four diagonal corners between the input texels
+        return 5;
+    case Upsample:
+        return 8;
+    case IntegralImage:
+        return FilterPlanner::IntegralImageRadix;
+    case BoxBlur:
+        // The corners of the box in the summed area table
+        return 4;
+    case AdaptiveThreshold:
+        // The corners of the window and the luma of the pixel
+        return 5;
+    case Median:
+        return parameter(0, 3.0) >= 5.0 ? 25 : 9;
+    case BilateralPass:
+        return 2 * int(parameter(1)) + 1;
+    default:
+        return 0;
+    }
+}
+
+int FilterNode::reach() const
+{
+    const int gaussRadius = ShaderBuilder::gaussianKernelRadius();
+
+    switch (operation) {
+    case GaussBlur:
+        return gaussRadius;
+    case Sobel:
+    case Gradient:
+    case EdgeSuppression:
+        return 1;
+    case SobelGauss:
+        return gaussRadius + 1;
+    case Canny:
+        // The gradients of both neighbours along the gradient
+        return gaussRadius + 2;
+    case Downsample:
+    case Upsample:
+        // The bilinear taps reach into the next texel of the input
+        return 1;
+    case IntegralImage:
+        // A prefix sum adds everything before the texel
+        return -1;
+    case BoxBlur:
+        return int(ceil(qMax(parameter(0, 4.0), 0.0f))) + 1;
+    case AdaptiveThreshold:
+        return int(ceil(qMax(parameter(0, 16.0), 0.0f))) + 1;
+    case Median:
+        return parameter(0, 3.0) >= 5.0 ? 2 : 1;
+    case BilateralPass:
+        return int(parameter(1));
+    default:
+        return 0;
+    }
+}
+
+QString FilterNode::name() const
+{
+    for (int i = 0; i < filterNameCount; ++i) {
+        if (filterNames[i].operation == operation)
+            return QString(filterNames[i].name);
+    }
+
+    return QString();
+}
+
+float FilterNode::parameter(int index, float defaultValue) const
+{
+    return parameters.value(index, defaultValue);
+}
+
+FilterGraph::FilterGraph()
+{
+}
+
+FilterGraph &FilterGraph::append(FilterNode::Operation operation)
+{
+    m_nodes.append(FilterNode(operation));
+    return *this;
+}
+
+FilterGraph &FilterGraph::append(FilterNode::Operation operation, float parameter)
+{
+    m_nodes.append(FilterNode(operation, parameter));
+    return *this;
+}
+
+FilterGraph &FilterGraph::append(const FilterNode &node)
+{
+    m_nodes.append(node);
+    return *this;
+}
+
+QString FilterGraph::toString() const
+{
+    QStringList names;
+    foreach (const FilterNode &node, m_nodes) {
+        if (node.parameters.isEmpty()) {
+            names.append(node.name());
+            continue;
+        }
+
+        QStringList parameters;
+        foreach (float parameter, node.parameters)
+            parameters.append(QString::number(parameter));
+        names.append(QString("%0(%1)").arg(node.name(), parameters.join(" ")));
+    }
+
+    return names.join(", ");
+}
+
+FilterGraph FilterGraph::fromString(const QString &chain, bool *ok)
+{
+    FilterGraph graph;
+    if (ok)
+        *ok = true;
+
+    // Parameters are separated by spaces, commas separate the nodes
+    QRegExp nodeRegExp("([a-z]+)(?:\\(([-0-9.\\s]*)\\))?");
+    foreach (QString token, chain.toLower().split(QRegExp("\\s*(,|->)\\s*"), QString::SkipEmptyParts)) {
+        token = token.trimmed();
+        if (!nodeRegExp.exactMatch(token)) {
+            if (ok)
+                *ok = false;
+            return FilterGraph();
+        }
+
+        int i = 0;
+        while (i < filterNameCount && (!filterNames[i].parsable || nodeRegExp.cap(1) != filterNames[i].name))
+            ++i;
+
+        QVector<float> parameters;
+        bool valid = (i < filterNameCount);
+        foreach (const QString &value, nodeRegExp.cap(2).split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+            bool isNumber = false;
+            parameters.append(value.toFloat(&isNumber));
+            valid = valid && isNumber;
+        }
+
+        if (valid) {
+            valid = parameters.count() >= filterNames[i].minParameters
+                    && parameters.count() <= filterNames[i].maxParameters;
+            if (filterNames[i].operation == FilterNode::Grade)
+                valid = valid && (parameters.count() == 3 || parameters.count() == 9);
+            if (filterNames[i].operation == FilterNode::Median)
+                valid = valid && (parameters.isEmpty() || parameters.first() == 3.0 || parameters.first() == 5.0);
+        }
+
+        if (!valid) {
+            if (ok)
+                *ok = false;
+            return FilterGraph();
+        }
+
+        graph.append(FilterNode(filterNames[i].operation, parameters));
+    }
+
+    return graph;
+}
+
+FilterPass::FilterPass()
+    : colorLut(false)
+    , targetFormat(RGBA8)
+    , level(0)
+{
+}
+
+bool FilterPass::readsNeighbourhood() const
+{
+    return !nodes.isEmpty() && !nodes.first().isPointWise();
+}
+
+bool FilterPass::resamples() const
+{
+    return !nodes.isEmpty() && (nodes.first().operation == FilterNode::Downsample
+                                || nodes.first().operation == FilterNode::Upsample);
+}
+
+int FilterPass::fetchCount() const
+{
+    // A pass without a neighbourhood operation still reads its own pixel
+    const int lutFetches = colorLut ? 1 : 0;
+    if (!readsNeighbourhood())
+        return 1 + lutFetches;
+
+    return nodes.first().fetchCount() + lutFetches;
+}
+
+int FilterPass::reach() const
+{
+    if (!readsNeighbourhood())
+        return 0;
+
+    return nodes.first().reach();
+}
+
+double FilterPass::pixelFraction() const
+{
+    return 1.0 / double(1 << (2 * level));
+}
+
+QVector<FilterNode> FilterPass::pointWiseNodes() const
+{
+    QVector<FilterNode> pointWise;
+    foreach (const FilterNode &node, nodes) {
+        if (node.isPointWise())
+            pointWise.append(node);
+    }
+
+    return pointWise;
+}
+
+int FilterPass::bytesPerTexel(TargetFormat format)
+{
+    switch (format) {
+    case R8:
+        return 1;
+    case R16F:
+        return 2;
+    case RGBA32F:
+        return 16;
+    case RG16F:
+    case RGBA8:
+    default:
+        return 4;
+    }
+}
+
+double FilterPlan::fetchesPerPixel() const
+{
+    double fetches = 0.0;
+    foreach (const FilterPass &pass, passes)
+        fetches += pass.fetchCount() * pass.pixelFraction();
+
+    return fetches;
+}
+
+double FilterPlan::estimatedBytesPerPixel() const
+{
+    // Texel bytes read by every fetch plus the bytes written by every pass,
+    // the source image and the framebuffer are RGBA8.
+    double bytes = 0.0;
+    int inputBytes = FilterPass::bytesPerTexel(FilterPass::RGBA8);
+    for (int i = 0; i < passes.count(); ++i) {
+        const FilterPass &pass = passes.at(i);
+        const bool isLast = (i == passes.count() - 1);
+        const int outputBytes = FilterPass::bytesPerTexel(isLast ? FilterPass::RGBA8 : pass.targetFormat);
+
+        // The lookup table is small enough to stay in the texture cache
+        const int inputFetches = pass.fetchCount() - (pass.colorLut ? 1 : 0);
+        bytes += (inputFetches * inputBytes + outputBytes) * pass.pixelFraction();
+        inputBytes = outputBytes;
+    }
+
+    return bytes;
+}
+
+QString FilterPlan::summary() const
+{
+    return QString("Filter passes: %0, estimated fetches per pixel: %1, bytes per pixel: %2")
+            .arg(passCount())
+            .arg(fetchesPerPixel(), 0, 'g', 4)
+            .arg(estimatedBytesPerPixel(), 0, 'g', 4);
+}
+
+FilterPlan FilterPlanner::plan(const FilterGraph &graph, bool reducedPrecision, bool sharedViews)
+{
+    FilterPlan plan;
+
+    // Canny only uses the lightness of the gradient, so with reduced
+    // precision it is split into passes working on single channel luma and a
+    // two channel gradient field instead of blurring all taps in one pass.
+    // Between compared views the blur of Sobel and Canny stays a pass of its
+    // own, the views then read the same blurred texture, which is rendered
+    // once per frame instead of once per view.
+    QVector<FilterNode> nodes;
+    foreach (const FilterNode &node, graph.nodes()) {
+        if (sharedViews && node.operation == FilterNode::SobelGauss) {
+            nodes.append(FilterNode(FilterNode::GaussBlur));
+            nodes.append(FilterNode(FilterNode::Sobel));
+        } else if (sharedViews && node.operation == FilterNode::Canny) {
+            nodes.append(FilterNode(FilterNode::GaussBlur));
+            nodes.append(FilterNode(FilterNode::Gradient));
+            nodes.append(FilterNode(FilterNode::EdgeSuppression));
+        } else if (reducedPrecision && node.operation == FilterNode::Canny) {
+            nodes.append(FilterNode(FilterNode::GaussBlur));
+            nodes.append(FilterNode(FilterNode::Gray));
+            nodes.append(FilterNode(FilterNode::Gradient));
+            nodes.append(FilterNode(FilterNode::EdgeSuppression));
+        } else if (node.operation == FilterNode::LargeBlur) {
+            // Every level halves the resolution on the way down and doubles
+            // it on the way up. Each pass spreads its taps by about one
+            // texel of the smaller level, so the radius doubles with every
+            // level while the cost per image pixel converges to 5 / 3
+            // fetches down and 8 * 4 / 3 fetches up, whatever the radius.
+            const int levels = qBound(1, int(node.parameter(0, DefaultLargeBlurLevels)), int(MaxLargeBlurLevels));
+            for (int level = 0; level < levels; ++level)
+                nodes.append(FilterNode(FilterNode::Downsample));
+            for (int level = 0; level < levels; ++level)
+                nodes.append(FilterNode(FilterNode::Upsample));
+        } else if (node.operation == FilterNode::BoxBlur || node.operation == FilterNode::AdaptiveThreshold) {
+            // The summed area table is a parallel prefix sum along the rows
+            // and then along the columns, every pass adds the texels up to
+            // radix^pass before it. The threshold only sums the luma and
+            // its square, for the mean and the deviation of the window.
+            const float moments = (node.operation == FilterNode::AdaptiveThreshold) ? 1.0 : 0.0;
+            for (int axis = 0; axis < 2; ++axis) {
+                float stride = 1.0;
+                for (int pass = 0; pass < IntegralImagePasses; ++pass) {
+                    QVector<float> parameters;
+                    parameters << axis << stride << (axis == 0 && pass == 0 ? 1.0 : 0.0) << moments;
+                    nodes.append(FilterNode(FilterNode::IntegralImage, parameters));
+                    stride *= IntegralImageRadix;
+                }
+            }
+            nodes.append(node);
+        } else if (node.operation == FilterNode::Bilateral) {
+            // Filtering the rows and then the columns of the result
+            // approximates the 2D window with 2 * (2r + 1) fetches instead
+            // of (2r + 1)^2, the color differences of the second pass are
+            // taken on the already smoothed rows.
+            const int radius = qBound(1, qRound(node.parameter(0, DefaultBilateralRadius)), int(MaxBilateralRadius));
+            const float sigmaRange = qMax(node.parameter(1, 0.1), 0.01f);
+            for (int axis = 0; axis < 2; ++axis) {
+                QVector<float> parameters;
+                parameters << axis << radius << sigmaRange;
+                nodes.append(FilterNode(FilterNode::BilateralPass, parameters));
+            }
+        } else {
+            nodes.append(node);
+        }
+    }
+
+    // Point-wise operations are fused into the shader of the preceding pass,
+    // a new pass (and so an intermediate texture) is only needed when a
+    // neighbourhood operation has to read the result of the previous nodes.
+    foreach (const FilterNode &node, nodes) {
+        if (plan.passes.isEmpty() || !node.isPointWise())
+            plan.passes.append(FilterPass());
+        plan.passes.last().nodes.append(node);
+    }
+
+    int level = 0;
+    for (int i = 0; i < plan.passes.count(); ++i) {
+        FilterPass &pass = plan.passes[i];
+        if (pass.nodes.first().operation == FilterNode::Downsample)
+            ++level;
+        else if (pass.nodes.first().operation == FilterNode::Upsample)
+            --level;
+        pass.level = level;
+    }
+
+    // A single gray, invert or threshold is cheaper in ALU than a dependent
+    // fetch, and threshold stays exact instead of being interpolated
+    // between the cells of the table.
+    for (int i = 0; i < plan.passes.count(); ++i) {
+        FilterPass &pass = plan.passes[i];
+        const QVector<FilterNode> pointWise = pass.pointWiseNodes();
+        pass.colorLut = pointWise.count() > 1;
+        foreach (const FilterNode &node, pointWise)
+            pass.colorLut = pass.colorLut || node.requiresColorLut();
+    }
+
+    // Pick the narrowest intermediate format which holds what the pass writes
+    enum Content { Color, Luma, GradientField } content = Color;
+    for (int i = 0; i < plan.offscreenPassCount(); ++i) {
+        FilterPass &pass = plan.passes[i];
+        if (pass.nodes.first().operation == FilterNode::IntegralImage) {
+            pass.targetFormat = FilterPass::RGBA32F;
+            continue;
+        }
+
+        foreach (const FilterNode &node, pass.nodes) {
+            switch (node.operation) {
+            case FilterNode::Gray:
+            case FilterNode::Threshold:
+            case FilterNode::AdaptiveThreshold:
+            case FilterNode::Canny:
+            case FilterNode::EdgeSuppression:
+                content = Luma;
+                break;
+            case FilterNode::Gradient:
+                content = GradientField;
+                break;
+            case FilterNode::Grade:
+                // Per channel slopes and offsets tint the luma
+                content = Color;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (content == GradientField)
+            pass.targetFormat = FilterPass::RG16F;
+        else if (reducedPrecision && content == Luma)
+            pass.targetFormat = plan.passes.at(i + 1).nodes.first().isDerivative() ? FilterPass::R16F : FilterPass::R8;
+        else
+            pass.targetFormat = FilterPass::RGBA8;
+    }
+
+    return plan;
+}
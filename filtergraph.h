@@ -0,0 +1,150 @@
+#ifndef FILTERGRAPH_H
+#define FILTERGRAPH_H
+
+#include <QString>
+#include <QVector>
+
+struct FilterNode {
+    enum Operation {
+        // Neighbourhood operations read several texels of their input
+        GaussBlur = 0,
+        Sobel,
+        SobelGauss,
+        Canny,
+        Gradient,
+        EdgeSuppression,
+        LargeBlur,
+        Downsample,
+        Upsample,
+        BoxBlur,
+        AdaptiveThreshold,
+        IntegralImage,
+        Median,
+        Bilateral,
+        BilateralPass,
+
+        // Point-wise operations only depend on the color of the same pixel
+        Gray,
+        Invert,
+        Threshold,
+
+        // Point-wise operations which are only available through the color
+        // lookup table, see ColorLut
+        Levels,
+        Curves,
+        Saturation,
+        Grade
+    };
+
+    FilterNode(Operation operation = Gray);
+    FilterNode(Operation operation, float parameter);
+    FilterNode(Operation operation, const QVector<float> &parameters);
+
+    bool isPointWise() const;
+    bool requiresColorLut() const;
+    bool isDerivative() const;
+    int fetchCount() const;
+    // Texels of the input around the pixel which are read, -1 if the result
+    // depends on the whole input
+    int reach() const;
+    QString name() const;
+
+    float parameter(int index = 0, float defaultValue = 0.0) const;
+
+    Operation operation;
+    QVector<float> parameters;
+};
+
+class FilterGraph
+{
+public:
+    FilterGraph();
+
+    FilterGraph &append(FilterNode::Operation operation);
+    FilterGraph &append(FilterNode::Operation operation, float parameter);
+    FilterGraph &append(const FilterNode &node);
+
+    const QVector<FilterNode> &nodes() const { return m_nodes; }
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    void clear() { m_nodes.clear(); }
+
+    QString toString() const;
+    static FilterGraph fromString(const QString &chain, bool *ok = 0);
+
+private:
+    QVector<FilterNode> m_nodes;
+};
+
+// A pass renders one neighbourhood operation (if any) followed by the
+// point-wise operations fused into the same shader. Chains of point-wise
+// operations are baked into a 3D lookup table, so they cost one fetch per
+// pixel however many of them there are.
+struct FilterPass {
+    enum TargetFormat {
+        RGBA8,
+        R8,     // Luma, sampled as (l, l, l, 1)
+        R16F,   // Luma which is differentiated by the next pass
+        RG16F,  // Signed gradient field
+        RGBA32F // Summed area table, the sums outgrow half floats
+    };
+
+    FilterPass();
+
+    bool readsNeighbourhood() const;
+    // Reads its input at another level, with bilinear filtering
+    bool resamples() const;
+    int fetchCount() const;
+    int reach() const;
+    double pixelFraction() const;
+    QVector<FilterNode> pointWiseNodes() const;
+
+    static int bytesPerTexel(TargetFormat format);
+
+    QVector<FilterNode> nodes;
+
+    // The point-wise nodes are applied by a single colorLut fetch
+    bool colorLut;
+
+    // Format of the intermediate texture, unused by the last pass
+    TargetFormat targetFormat;
+
+    // The target is the image size halved level times, the pyramid of a
+    // large blur always returns to level 0 before the last pass
+    int level;
+};
+
+struct FilterPlan {
+    bool isEmpty() const { return passes.isEmpty(); }
+    int passCount() const { return passes.count(); }
+    int offscreenPassCount() const { return passes.isEmpty() ? 0 : passes.count() - 1; }
+    // Per pixel of the image, passes at a lower level count less
+    double fetchesPerPixel() const;
+    double estimatedBytesPerPixel() const;
+    QString summary() const;
+
+    // The last pass is drawn by the object's fragment shader, every other
+    // pass is rendered into an intermediate texture.
+    QVector<FilterPass> passes;
+};
+
+class FilterPlanner
+{
+public:
+    // With sharedViews the plan is one of several compared views, see
+    // FilterPipeline::setViews()
+    static FilterPlan plan(const FilterGraph &graph, bool reducedPrecision = false, bool sharedViews = false);
+
+    static const int DefaultLargeBlurLevels = 3;
+    static const int MaxLargeBlurLevels = 6;
+
+    // Passes along each axis of a summed area table, 4^7 texels cover the
+    // largest texture size
+    static const int IntegralImageRadix = 4;
+    static const int IntegralImagePasses = 7;
+
+    // Radius in texels of the bilateral window, each pass reads 2r + 1 texels
+    static const int DefaultBilateralRadius = 4;
+    static const int MaxBilateralRadius = 16;
+};
+
+#endif // FILTERGRAPH_H
@@ -0,0 +1,380 @@
+#include "filterpipeline.h"
+
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QVector2D>
+
+#include "colorlut.h"
+#include "globjectdescriptor.h"
+#include "rendertargetpool.h"
+#include "shadercompiler.h"
+#include "tracer.h"
+
+static const GLfloat quadVertices[] = {
+    // x, y, s, t
+    -1.0, -1.0, 0.0, 0.0,
+     1.0, -1.0, 1.0, 0.0,
+    -1.0,  1.0, 0.0, 1.0,
+     1.0,  1.0, 1.0, 1.0,
+};
+
+static GLenum internalFormat(FilterPass::TargetFormat format)
+{
+    switch (format) {
+    case FilterPass::R8:
+        return GL_R8;
+    case FilterPass::R16F:
+        return GL_R16F;
+    case FilterPass::RG16F:
+        return GL_RG16F;
+    case FilterPass::RGBA32F:
+        return GL_RGBA32F;
+    case FilterPass::RGBA8:
+    default:
+        return GL_RGBA8;
+    }
+}
+
+// The part of its input a pass reads to render region, both in pixels of the
+// source. One more texel of the input's level covers the rounding to them.
+static QRect readRegion(const QRect &region, int reach, int inputLevel, const QRect &image)
+{
+    if (reach < 0)
+        return image;
+
+    const int margin = (reach + 1) << inputLevel;
+    return region.adjusted(-margin, -margin, margin, margin) & image;
+}
+
+FilterPipeline::FilterPipeline()
+    : m_shaderCompiler(0)
+    , m_renderTargetPool(0)
+    , m_viewPassCount(0)
+    , m_dirty(true)
+    , m_sourceTexture(0)
+{
+}
+
+FilterPipeline::~FilterPipeline()
+{
+    if (m_renderTargetPool)
+        releaseTargets();
+    qDeleteAll(m_colorLutTextures);
+    m_quadBuffer.destroy();
+}
+
+void FilterPipeline::initialize(ShaderCompiler *shaderCompiler, RenderTargetPool *renderTargetPool)
+{
+    initializeOpenGLFunctions();
+    m_shaderCompiler = shaderCompiler;
+    m_renderTargetPool = renderTargetPool;
+
+    m_quadBuffer.create();
+    m_quadBuffer.bind();
+    m_quadBuffer.allocate(quadVertices, sizeof(quadVertices));
+    m_quadBuffer.release();
+}
+
+void FilterPipeline::setPasses(const GLObjectDescriptor *objectDescriptor)
+{
+    QVector<const GLObjectDescriptor *> objectDescriptors;
+    if (objectDescriptor)
+        objectDescriptors.append(objectDescriptor);
+
+    setViews(objectDescriptors);
+}
+
+void FilterPipeline::setViews(const QVector<const GLObjectDescriptor *> &objectDescriptors)
+{
+    releaseTargets();
+    m_steps.clear();
+    m_readerCounts.clear();
+    m_viewSteps.clear();
+    m_viewLinearResults.clear();
+    m_viewReaches.clear();
+    m_viewPassCount = 0;
+    m_objectColorLuts.clear();
+    m_dirty = true;
+
+    // Tables which are still used are moved back, the rest are deleted
+    QHash<QString, QOpenGLTexture *> previousTextures;
+    previousTextures.swap(m_colorLutTextures);
+
+    // A step is identified by its input and the code it runs, so views whose
+    // plans start the same way walk down the same branch of the tree
+    QHash<QString, int> stepIndices;
+
+    foreach (const GLObjectDescriptor *objectDescriptor, objectDescriptors) {
+        const QString vertexCode = objectDescriptor->getFilterPassVertexShaderCode();
+        const FilterPlan &plan = objectDescriptor->getFilterPlan();
+
+        int input = -1;
+        for (int pass = 0; pass < objectDescriptor->getFilterPassCount(); ++pass) {
+            const QString fragmentCode = objectDescriptor->getFilterPassFragmentShaderCode(pass);
+            const FilterPass &filterPass = plan.passes.at(pass);
+            const QString key = QString("%0 %1 %2 %3")
+                    .arg(input)
+                    .arg(filterPass.targetFormat)
+                    .arg(filterPass.colorLut ? ColorLut::key(filterPass.pointWiseNodes()) : QString())
+                    .arg(QString::fromLatin1(ShaderCompiler::programKey(vertexCode, fragmentCode).toHex()));
+
+            int step = stepIndices.value(key, -1);
+            if (step < 0) {
+                Step newStep;
+                newStep.input = input;
+                newStep.program = m_shaderCompiler->program(vertexCode, fragmentCode);
+                newStep.targetFormat = internalFormat(filterPass.targetFormat);
+                newStep.colorLut = colorLutTexture(filterPass, &previousTextures);
+                newStep.level = filterPass.level;
+                newStep.linearInput = filterPass.resamples();
+                newStep.reach = filterPass.reach();
+
+                step = m_steps.count();
+                m_steps.append(newStep);
+                m_readerCounts.append(0);
+                if (input >= 0)
+                    ++m_readerCounts[input];
+                stepIndices.insert(key, step);
+            }
+
+            input = step;
+            ++m_viewPassCount;
+        }
+
+        m_viewSteps.append(input);
+        m_viewLinearResults.append(!plan.isEmpty() && plan.passes.last().resamples());
+        m_viewReaches.append(plan.isEmpty() ? 0 : plan.passes.last().reach());
+        m_objectColorLuts.append(plan.isEmpty() ? 0 : colorLutTexture(plan.passes.last(), &previousTextures));
+    }
+
+    m_targets.fill(0, m_steps.count());
+
+    qDeleteAll(previousTextures);
+}
+
+QOpenGLTexture *FilterPipeline::colorLutTexture(const FilterPass &pass, QHash<QString, QOpenGLTexture *> *previousTextures)
+{
+    if (!pass.colorLut)
+        return 0;
+
+    const QVector<FilterNode> nodes = pass.pointWiseNodes();
+    const QString key = ColorLut::key(nodes);
+    if (QOpenGLTexture *texture = m_colorLutTextures.value(key))
+        return texture;
+
+    QOpenGLTexture *texture = previousTextures->take(key);
+    if (!texture) {
+        TRACE_ZONE("FilterPipeline::bakeColorLut");
+        texture = ColorLut::createTexture(nodes);
+    }
+
+    m_colorLutTextures.insert(key, texture);
+    return texture;
+}
+
+void FilterPipeline::bindColorLut(QOpenGLTexture *texture, QOpenGLShaderProgram *program)
+{
+    glActiveTexture(GL_TEXTURE0 + ColorLutUnit);
+    texture->bind();
+    glActiveTexture(GL_TEXTURE0);
+    program->setUniformValue("colorLut", ColorLutUnit);
+}
+
+bool FilterPipeline::bindObjectColorLut(QOpenGLShaderProgram *program, int view)
+{
+    QOpenGLTexture *texture = m_objectColorLuts.value(view);
+    if (!texture)
+        return false;
+
+    bindColorLut(texture, program);
+    return true;
+}
+
+void FilterPipeline::releaseColorLut()
+{
+    glActiveTexture(GL_TEXTURE0 + ColorLutUnit);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+qint64 FilterPipeline::colorLutBytes() const
+{
+    return qint64(m_colorLutTextures.count()) * ColorLut::Size * ColorLut::Size * ColorLut::Size * 4;
+}
+
+QSize FilterPipeline::levelSize(const QSize &size, int level)
+{
+    return QSize(qMax(size.width() >> level, 1), qMax(size.height() >> level, 1));
+}
+
+QRect FilterPipeline::levelRegion(const QRect &region, int level)
+{
+    // Every texel which covers a pixel of the region, top() is the bottom row
+    const int scale = 1 << level;
+    const int left = region.left() >> level;
+    const int bottom = region.top() >> level;
+    const int right = (region.left() + region.width() + scale - 1) >> level;
+    const int top = (region.top() + region.height() + scale - 1) >> level;
+    return QRect(left, bottom, right - left, top - bottom);
+}
+
+QVector<QRect> FilterPipeline::stepRegions(const QSize &size) const
+{
+    const QRect image(QPoint(0, 0), size);
+    const QRect region = m_regionOfInterest & image;
+    if (region.isEmpty())
+        return QVector<QRect>(m_steps.count(), image);
+
+    QVector<QRect> regions(m_steps.count());
+    for (int view = 0; view < m_viewSteps.count(); ++view) {
+        const int step = m_viewSteps.at(view);
+        if (step >= 0)
+            regions[step] |= readRegion(region, m_viewReaches.at(view), m_steps.at(step).level, image);
+    }
+
+    // The readers of a step always come after it
+    for (int step = m_steps.count() - 1; step >= 0; --step) {
+        const Step &current = m_steps.at(step);
+        if (current.input >= 0 && !regions.at(step).isEmpty())
+            regions[current.input] |= readRegion(regions.at(step), current.reach, m_steps.at(current.input).level, image);
+    }
+
+    return regions;
+}
+
+void FilterPipeline::setRegionOfInterest(const QRect &region)
+{
+    if (region == m_regionOfInterest)
+        return;
+
+    m_regionOfInterest = region;
+    m_dirty = true;
+}
+
+void FilterPipeline::setInputFilter(GLuint texture, bool linear)
+{
+    // The pooled targets are created with nearest filtering, which the
+    // passes reading whole texels at the same level rely on
+    const GLint filter = linear ? GL_LINEAR : GL_NEAREST;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+}
+
+void FilterPipeline::releaseTargets()
+{
+    for (int step = 0; step < m_targets.count(); ++step) {
+        m_renderTargetPool->release(m_targets.at(step));
+        m_targets[step] = 0;
+    }
+}
+
+GLuint FilterPipeline::process(GLuint sourceTexture, const QSize &size)
+{
+    TRACE_ZONE("FilterPipeline::process");
+    if (m_steps.isEmpty() || size.isEmpty()) {
+        m_sourceTexture = sourceTexture;
+        return sourceTexture;
+    }
+
+    if (!m_dirty && sourceTexture == m_sourceTexture && size == m_size)
+        return resultTexture(0);
+
+    releaseTargets();
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_SCISSOR_TEST);
+    const QVector<QRect> regions = stepRegions(size);
+
+    // A target goes back to the pool as soon as every step reading it has
+    // been drawn, only the results of the views are kept. With a single view
+    // every step only has one reader, so two targets per format are enough.
+    QVector<bool> results(m_steps.count(), false);
+    foreach (int step, m_viewSteps) {
+        if (step >= 0)
+            results[step] = true;
+    }
+
+    QVector<int> pendingReaders = m_readerCounts;
+    for (int step = 0; step < m_steps.count(); ++step) {
+        const Step &current = m_steps.at(step);
+        const QSize targetSize = levelSize(size, current.level);
+        QOpenGLFramebufferObject *target = m_renderTargetPool->acquire(targetSize, current.targetFormat);
+        QOpenGLShaderProgram *program = current.program;
+
+        target->bind();
+        glViewport(0, 0, targetSize.width(), targetSize.height());
+        const QRect scissor = levelRegion(regions.at(step), current.level);
+        glScissor(scissor.x(), scissor.y(), scissor.width(), scissor.height());
+        program->bind();
+        glActiveTexture(GL_TEXTURE0);
+        if (current.input < 0)
+            glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        else
+            setInputFilter(m_targets.at(current.input)->texture(), current.linearInput);
+        program->setUniformValue("inputTexture", 0);
+        // The size of the target, a pass which resamples derives the size
+        // of its input from it
+        program->setUniformValue("textureSize", QVector2D(targetSize.width(), targetSize.height()));
+        if (current.colorLut)
+            bindColorLut(current.colorLut, program);
+
+        drawQuad(program);
+
+        program->release();
+        m_targets[step] = target;
+
+        if (current.input >= 0 && --pendingReaders[current.input] == 0 && !results.at(current.input)) {
+            m_renderTargetPool->release(m_targets.at(current.input));
+            m_targets[current.input] = 0;
+        }
+    }
+
+    // The object draws the last pass, which reads the result of its view
+    for (int view = 0; view < m_viewSteps.count(); ++view) {
+        const int step = m_viewSteps.at(view);
+        if (step >= 0)
+            setInputFilter(m_targets.at(step)->texture(), m_viewLinearResults.at(view));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    releaseColorLut();
+    glDisable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    m_dirty = false;
+    m_sourceTexture = sourceTexture;
+    m_size = size;
+
+    return resultTexture(0);
+}
+
+GLuint FilterPipeline::resultTexture(int view) const
+{
+    const int step = m_viewSteps.value(view, -1);
+    if (step < 0 || !m_targets.at(step))
+        return m_sourceTexture;
+
+    return m_targets.at(step)->texture();
+}
+
+void FilterPipeline::drawQuad(QOpenGLShaderProgram *program)
+{
+    m_quadBuffer.bind();
+    program->setAttributeBuffer("vertex", GL_FLOAT, 0, 2, 4 * sizeof(GLfloat));
+    program->enableAttributeArray("vertex");
+    program->setAttributeBuffer("textureCoordinate", GL_FLOAT, 2 * sizeof(GLfloat), 2, 4 * sizeof(GLfloat));
+    program->enableAttributeArray("textureCoordinate");
+    m_quadBuffer.release();
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program->disableAttributeArray("vertex");
+    program->disableAttributeArray("textureCoordinate");
+}
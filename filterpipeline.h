@@ -0,0 +1,119 @@
+#ifndef FILTERPIPELINE_H
+#define FILTERPIPELINE_H
+
+#include <QHash>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QRect>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+class GLObjectDescriptor;
+struct FilterPass;
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+class QOpenGLTexture;
+class RenderTargetPool;
+class ShaderCompiler;
+
+// Renders the offscreen passes of a filter plan in image space. The result
+// is kept until the passes or the source texture change, so the passes are
+// not rendered again for every frame. It also owns the color lookup tables
+// of the passes, which are only baked again when their nodes change.
+//
+// Several views, each with its own plan, can be processed together. Their
+// passes form a tree: a pass which reads the same input with the same
+// shader in more than one view is rendered once and its target is read by
+// all of them. The passes of a large blur render into targets of a lower
+// level, see FilterPass::level.
+//
+// With a region of interest every pass is scissored to the part of the image
+// which the following passes read, the region grown by their reach, so the
+// cost follows the area of the region. Passes whose result depends on the
+// whole input, like the summed area table, are still rendered in full.
+class FilterPipeline : protected QOpenGLFunctions
+{
+public:
+    FilterPipeline();
+    ~FilterPipeline();
+
+    void initialize(ShaderCompiler *shaderCompiler, RenderTargetPool *renderTargetPool);
+    void setPasses(const GLObjectDescriptor *objectDescriptor);
+    void setViews(const QVector<const GLObjectDescriptor *> &objectDescriptors);
+    void invalidate() { m_dirty = true; }
+
+    // In pixels of the source, with the origin at the bottom left as the
+    // texture is stored. An empty region processes the whole image.
+    void setRegionOfInterest(const QRect &region);
+    QRect regionOfInterest() const { return m_regionOfInterest; }
+
+    bool isEmpty() const { return m_steps.isEmpty(); }
+    int viewCount() const { return m_viewSteps.count(); }
+
+    // Distinct passes rendered, and passes the views would render on their own
+    int passCount() const { return m_steps.count(); }
+    int viewPassCount() const { return m_viewPassCount; }
+
+    // Renders every view, returns the result of the first one
+    GLuint process(GLuint sourceTexture, const QSize &size);
+    GLuint resultTexture(int view) const;
+    void drawQuad(QOpenGLShaderProgram *program);
+
+    // Binds the table of the pass drawn by the object to unit ColorLutUnit
+    bool bindObjectColorLut(QOpenGLShaderProgram *program, int view = 0);
+    void releaseColorLut();
+    qint64 colorLutBytes() const;
+
+    static const int ColorLutUnit = 2;
+
+private:
+    struct Step {
+        // Step whose target is read, -1 for the source texture
+        int input;
+        QOpenGLShaderProgram *program;
+        GLenum targetFormat;
+        QOpenGLTexture *colorLut;
+        // The target is the image size halved level times
+        int level;
+        bool linearInput;
+        // Texels of the input read around a pixel, -1 for all of them
+        int reach;
+    };
+
+    static QSize levelSize(const QSize &size, int level);
+    static QRect levelRegion(const QRect &region, int level);
+    QVector<QRect> stepRegions(const QSize &size) const;
+    void setInputFilter(GLuint texture, bool linear);
+
+    QOpenGLTexture *colorLutTexture(const FilterPass &pass, QHash<QString, QOpenGLTexture *> *previousTextures);
+    void bindColorLut(QOpenGLTexture *texture, QOpenGLShaderProgram *program);
+    void releaseTargets();
+
+    ShaderCompiler *m_shaderCompiler;
+    RenderTargetPool *m_renderTargetPool;
+
+    // In drawing order, every step comes after its input
+    QVector<Step> m_steps;
+    QVector<int> m_readerCounts;
+    QVector<QOpenGLFramebufferObject *> m_targets;
+
+    // Last step of every view, -1 if the view has no offscreen pass
+    QVector<int> m_viewSteps;
+    QVector<bool> m_viewLinearResults;
+    QVector<int> m_viewReaches;
+    int m_viewPassCount;
+
+    // Indexed by view, the tables of the passes drawn by the objects
+    QVector<QOpenGLTexture *> m_objectColorLuts;
+    QHash<QString, QOpenGLTexture *> m_colorLutTextures;
+    QOpenGLBuffer m_quadBuffer;
+
+    QRect m_regionOfInterest;
+
+    bool m_dirty;
+    GLuint m_sourceTexture;
+    QSize m_size;
+};
+
+#endif // FILTERPIPELINE_H
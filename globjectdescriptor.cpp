@@ -1,16 +1,93 @@
 #include "globjectdescriptor.h"
+#include "meshcache.h"
+#include "meshloader.h"
+#include "proceduralgeometry.h"
+#include "rawimage.h"
 #include "shaderbuilder.h"
+#include "tracer.h"
+#include "vertexquantizer.h"
 
 #include "math.h"
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QImage>
 #include <QSize>
+#include <QThread>
+#include <QtConcurrent>
 
 GLObjectDescriptor *GLObjectDescriptor::createConeDescriptor(ShaderConfig *shaderConfig, int triangleCount)
 {
-    GLObjectDescriptor *cone = new GLObjectDescriptor();
+    TRACE_ZONE("GLObjectDescriptor::createConeDescriptor");
+    return create(ConeObject, QString(), triangleCount, shaderConfig);
+}
+
+GLObjectDescriptor *GLObjectDescriptor::createCubeDescriptor(ShaderConfig *shaderConfig)
+{
+    TRACE_ZONE("GLObjectDescriptor::createCubeDescriptor");
+    return create(CubeObject, QString(), 0, shaderConfig);
+}
 
+GLObjectDescriptor *GLObjectDescriptor::createImageDescriptor(ShaderConfig *shaderConfig, const QString &imagePath)
+{
+    TRACE_ZONE("GLObjectDescriptor::createImageDescriptor");
+    return create(ImageObject, imagePath, 0, shaderConfig);
+}
+
+GLObjectDescriptor *GLObjectDescriptor::createMeshDescriptor(ShaderConfig *shaderConfig, const QString &meshPath)
+{
+    TRACE_ZONE("GLObjectDescriptor::createMeshDescriptor");
+    return create(MeshObject, meshPath, 0, shaderConfig);
+}
+
+GLObjectDescriptor *GLObjectDescriptor::createProceduralDescriptor(ShaderConfig *shaderConfig, GLObjectId objectId, int segments)
+{
+    TRACE_ZONE("GLObjectDescriptor::createProceduralDescriptor");
+    return create(objectId, QString(), segments, shaderConfig);
+}
+
+GLObjectDescriptor *GLObjectDescriptor::create(GLObjectId objectId, const QString &sourcePath, int tessellation, ShaderConfig *shaderConfig)
+{
+    GLObjectDescriptor *descriptor = new GLObjectDescriptor();
+    descriptor->m_objectId = objectId;
+    descriptor->m_sourcePath = sourcePath;
+    descriptor->m_tessellation = tessellation;
+
+    if (!descriptor->loadGeometry()) {
+        delete descriptor;
+        return 0;
+    }
+
+    descriptor->buildShaderCode(objectId, shaderConfig);
+
+    return descriptor;
+}
+
+bool GLObjectDescriptor::loadGeometry()
+{
+    switch (m_objectId) {
+    case ConeObject:
+        generateCone(m_tessellation);
+        return true;
+    case CubeObject:
+        generateCube();
+        return true;
+    case ImageObject:
+        return loadImage(m_sourcePath);
+    case MeshObject:
+        return loadMesh(m_sourcePath);
+    case SphereObject:
+    case TorusObject:
+    case GridObject:
+        return generateShape(m_objectId, m_tessellation);
+    case None:
+    default:
+        return false;
+    }
+}
+
+void GLObjectDescriptor::generateCone(int triangleCount)
+{
     float angleStep = 2.0 * M_PI / triangleCount;
     float angle = 0.0;
     float radius = 1.0;
@@ -43,43 +120,12 @@ GLObjectDescriptor *GLObjectDescriptor::createConeDescriptor(ShaderConfig *shade
         angle += angleStep;
     }
 
-    cone->setVertices(coneVertices, vertexCount);
-    cone->setColors(coneColors, vertexCount);
-
-    ShaderBuilder shaderBuilder("120");
-    QStringList vertexVariables;
-    vertexVariables.append("uniform mat4 mvpMatrix;");
-    vertexVariables.append("attribute vec4 vertex;");
-    vertexVariables.append("attribute vec4 color;");
-    vertexVariables.append("varying vec4 varyingColor;");
-    shaderBuilder.setVariables(QOpenGLShader::Vertex, vertexVariables);
-
-    QStringList vertexMain;
-    vertexMain.append("varyingColor = color;");
-    vertexMain.append("gl_Position = mvpMatrix * vertex;");
-    shaderBuilder.setMainBody(QOpenGLShader::Vertex, vertexMain);
-
-    QStringList fragmentVariables;
-    fragmentVariables.append("uniform int animProgress;");
-    fragmentVariables.append("varying vec4 varyingColor;");
-    shaderBuilder.setVariables(QOpenGLShader::Fragment, fragmentVariables);
-
-    QStringList fragmentMain;
-    fragmentMain.append("gl_FragColor = varyingColor;");
-    shaderBuilder.setMainBody(QOpenGLShader::Fragment, fragmentMain);
-
-    shaderBuilder.setShaderConfig(shaderConfig);
-
-    cone->setVertexShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Vertex));
-    cone->setFragmentShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Fragment));
-
-    return cone;
+    setVertices(coneVertices, vertexCount);
+    setColors(coneColors, vertexCount);
 }
 
-GLObjectDescriptor *GLObjectDescriptor::createCubeDescriptor(ShaderConfig *shaderConfig)
+void GLObjectDescriptor::generateCube()
 {
-    GLObjectDescriptor *cube = new GLObjectDescriptor();
-
     int cubeVertices[][3] = {
         // Bottom
         { 1, -1,  1}, {-1, -1,  1}, {-1, -1, -1},
@@ -133,52 +179,30 @@ GLObjectDescriptor *GLObjectDescriptor::createCubeDescriptor(ShaderConfig *shade
     };
 
     int vertexCount = sizeof(cubeVertices) / (3 * sizeof(int));
-    cube->setVertices(cubeVertices, vertexCount);
-    cube->setColors(cubeColors, vertexCount);
-
-    ShaderBuilder shaderBuilder("120");
-    QStringList vertexVariables;
-    vertexVariables.append("uniform mat4 mvpMatrix;");
-    vertexVariables.append("attribute vec4 vertex;");
-    vertexVariables.append("attribute vec4 color;");
-    vertexVariables.append("varying vec4 varyingColor;");
-    shaderBuilder.setVariables(QOpenGLShader::Vertex, vertexVariables);
-
-    QStringList vertexMain;
-    vertexMain.append("varyingColor = color;");
-    vertexMain.append("gl_Position = mvpMatrix * vertex;");
-    shaderBuilder.setMainBody(QOpenGLShader::Vertex, vertexMain);
-
-    QStringList fragmentVariables;
-    fragmentVariables.append("uniform int animProgress;");
-    fragmentVariables.append("varying vec4 varyingColor;");
-    shaderBuilder.setVariables(QOpenGLShader::Fragment, fragmentVariables);
-
-    QStringList fragmentMain;
-    fragmentMain.append("gl_FragColor = varyingColor;");
-    shaderBuilder.setMainBody(QOpenGLShader::Fragment, fragmentMain);
-
-    shaderBuilder.setShaderConfig(shaderConfig);
-
-    cube->setVertexShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Vertex));
-    cube->setFragmentShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Fragment));
-
-    return cube;
+    setVertices(cubeVertices, vertexCount);
+    setColors(cubeColors, vertexCount);
 }
 
-GLObjectDescriptor *GLObjectDescriptor::createImageDescriptor(ShaderConfig *shaderConfig, const QString &imagePath)
+bool GLObjectDescriptor::loadImage(const QString &imagePath)
 {
-    GLObjectDescriptor *image = new GLObjectDescriptor(imagePath);
-    if (!image->hasTextureImage()) {
+    QFileInfo imageFile(imagePath);
+    if (RawImage::isRawImage(imagePath))
+        m_rawImage.reset(RawImage::open(imagePath));
+    if (m_rawImage.isNull() && imageFile.exists() && imageFile.isFile())
+        m_image.reset(new QImage(imagePath));
+
+    if (m_rawImage.isNull() && (m_image.isNull() || m_image->isNull())) {
         qWarning() << "Unable to load image: " << imagePath;
-        return 0;
+        m_image.reset();
+        return false;
     }
 
-    QSize imageSize = image->getTextureImageSize();
+    QSize imageSize = m_rawImage.isNull() ? m_image->size() : m_rawImage->getSize();
     if (imageSize.width() == 0) {
         qWarning() << "Invalid image size: " << imageSize;
-        return 0;
+        return false;
     }
+    m_imageSize = imageSize;
 
     // Canvas Height
     double ch = (double)imageSize.height() / (double)imageSize.width();
@@ -193,49 +217,189 @@ GLObjectDescriptor *GLObjectDescriptor::createImageDescriptor(ShaderConfig *shad
     };
 
     int vertexCount = sizeof(canvasVertices) / (3 * sizeof(double));
-    image->setVertices(canvasVertices, vertexCount);
-    image->setTextureCoordinates(textureCoodinates, vertexCount);
+    setVertices(canvasVertices, vertexCount);
+    setTextureCoordinates(textureCoodinates, vertexCount);
+
+    return true;
+}
+
+bool GLObjectDescriptor::loadMesh(const QString &meshPath)
+{
+    QVector3D boundsMin, boundsMax;
+
+    // A cached mesh is mapped and uploaded without being parsed or copied
+    const QString cachePath = MeshCache::cachePath(meshPath);
+    QElapsedTimer timer;
+    timer.start();
+    m_meshCache.reset(MeshCache::open(cachePath));
+
+    if (!m_meshCache.isNull()) {
+        boundsMin = m_meshCache->getBoundsMin();
+        boundsMax = m_meshCache->getBoundsMax();
+        m_loadStatistics = QString("%0 vertices, %1 triangles, mapped from cache in %2 ms")
+                .arg(getVertexCount())
+                .arg(getTriangleCount())
+                .arg(timer.elapsed());
+    } else {
+        MeshLoader::Statistics statistics;
+        if (!MeshLoader::load(meshPath, &m_vertices, &m_indices, &boundsMin, &boundsMax, &statistics)
+                || m_vertices.isEmpty()) {
+            return false;
+        }
+
+        MeshCache::write(cachePath, m_vertices, QVector<QVector3D>(), m_indices, boundsMin, boundsMax);
+        m_loadStatistics = statistics.summary();
+    }
+
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+
+    // Center the mesh and scale its longest side to the size of the cube
+    m_modelMatrix.setToIdentity();
+    const QVector3D extent = boundsMax - boundsMin;
+    float maxExtent = qMax(extent.x(), qMax(extent.y(), extent.z()));
+    if (maxExtent > 0.0f)
+        m_modelMatrix.scale(2.0 / maxExtent);
+    m_modelMatrix.translate(-(boundsMin + boundsMax) / 2.0);
+
+    return true;
+}
+
+bool GLObjectDescriptor::generateShape(GLObjectId objectId, int segments)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    switch (objectId) {
+    case SphereObject:
+        ProceduralGeometry::generateSphere(segments, &m_vertices, &m_indices);
+        break;
+    case TorusObject:
+        ProceduralGeometry::generateTorus(segments, &m_vertices, &m_indices);
+        break;
+    case GridObject:
+        ProceduralGeometry::generateDisplacedGrid(segments, &m_vertices, &m_indices);
+        break;
+    default:
+        return false;
+    }
+
+    m_loadStatistics = QString("%0 vertices, %1 triangles, generated in %2 ms on %3 threads")
+            .arg(getVertexCount())
+            .arg(getTriangleCount())
+            .arg(timer.elapsed())
+            .arg(QThread::idealThreadCount());
+
+    // The shapes fit the unit cube, the bounds are only needed for the LODs
+    m_boundsMin = QVector3D(-1.0, -1.0, -1.0);
+    m_boundsMax = QVector3D(1.0, 1.0, 1.0);
+
+    return true;
+}
+
+void GLObjectDescriptor::buildShaderCode(GLObjectId objectId, ShaderConfig *shaderConfig)
+{
+    m_objectId = objectId;
 
     ShaderBuilder shaderBuilder("120");
     QStringList vertexVariables;
-    vertexVariables.append("uniform mat4 mvpMatrix;");
-    vertexVariables.append("attribute vec4 vertex;");
-    vertexVariables.append("attribute vec2 textureCoordinate;");
-    vertexVariables.append("varying vec2 varyingTextureCoordinate;");
-    shaderBuilder.setVariables(QOpenGLShader::Vertex, vertexVariables);
-
     QStringList vertexMain;
-    vertexMain.append("varyingTextureCoordinate = textureCoordinate;");
-    vertexMain.append("gl_Position = mvpMatrix * vertex;");
-    shaderBuilder.setMainBody(QOpenGLShader::Vertex, vertexMain);
-
     QStringList fragmentVariables;
-    fragmentVariables.append("uniform int animProgress;");
-    fragmentVariables.append("uniform sampler2D texture;");
-    fragmentVariables.append("uniform vec2 textureSize;");
-    fragmentVariables.append("varying vec2 varyingTextureCoordinate;");
-    shaderBuilder.setVariables(QOpenGLShader::Fragment, fragmentVariables);
-
     QStringList fragmentMain;
-    fragmentMain.append("gl_FragColor = texture2D(texture, varyingTextureCoordinate);");
-    shaderBuilder.setMainBody(QOpenGLShader::Fragment, fragmentMain);
 
+    switch (objectId) {
+    case ConeObject:
+    case CubeObject:
+        vertexVariables.append("uniform mat4 mvpMatrix;");
+        vertexVariables.append("attribute vec4 vertex;");
+        vertexVariables.append("attribute vec4 color;");
+        vertexVariables.append("varying vec4 varyingColor;");
+
+        vertexMain.append("varyingColor = color;");
+        vertexMain.append("gl_Position = mvpMatrix * vertex;");
+
+        fragmentVariables.append("uniform int animProgress;");
+        fragmentVariables.append("varying vec4 varyingColor;");
+
+        fragmentMain.append("gl_FragColor = varyingColor;");
+        break;
+    case ImageObject:
+        vertexVariables.append("uniform mat4 mvpMatrix;");
+        vertexVariables.append("attribute vec4 vertex;");
+        vertexVariables.append("attribute vec2 textureCoordinate;");
+        vertexVariables.append("varying vec2 varyingTextureCoordinate;");
+
+        vertexMain.append("varyingTextureCoordinate = textureCoordinate;");
+        vertexMain.append("gl_Position = mvpMatrix * vertex;");
+
+        fragmentVariables.append("uniform int animProgress;");
+        fragmentVariables.append("uniform sampler2D texture;");
+        fragmentVariables.append("uniform sampler2D inputTexture;");
+        fragmentVariables.append("uniform vec2 textureSize;");
+        fragmentVariables.append("varying vec2 varyingTextureCoordinate;");
+
+        fragmentMain.append("gl_FragColor = texture2D(texture, varyingTextureCoordinate);");
+        break;
+    case MeshObject:
+    case SphereObject:
+    case TorusObject:
+    case GridObject:
+        vertexVariables.append("uniform mat4 mvpMatrix;");
+        vertexVariables.append("attribute vec4 vertex;");
+        vertexVariables.append("varying vec3 varyingPosition;");
+
+        vertexMain.append("varyingPosition = vertex.xyz;");
+        vertexMain.append("gl_Position = mvpMatrix * vertex;");
+
+        fragmentVariables.append("uniform int animProgress;");
+        fragmentVariables.append("varying vec3 varyingPosition;");
+
+        // Meshes and shapes have no normals, the faces are flat shaded
+        fragmentMain.append("vec3 normal = normalize(cross(dFdx(varyingPosition), dFdy(varyingPosition)));");
+        fragmentMain.append("float light = 0.2 + 0.8 * abs(dot(normal, normalize(vec3(0.3, 0.5, 1.0))));");
+        fragmentMain.append("gl_FragColor = vec4(vec3(light), 1.0);");
+        break;
+    case None:
+    default:
+        return;
+    }
+
+    shaderBuilder.setVariables(QOpenGLShader::Vertex, vertexVariables);
+    shaderBuilder.setMainBody(QOpenGLShader::Vertex, vertexMain);
+    shaderBuilder.setVariables(QOpenGLShader::Fragment, fragmentVariables);
+    shaderBuilder.setMainBody(QOpenGLShader::Fragment, fragmentMain);
     shaderBuilder.setShaderConfig(shaderConfig);
+    shaderBuilder.setRegionOfInterestEnabled(objectId == ImageObject);
+
+    setVertexShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Vertex));
+    setFragmentShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Fragment));
 
-    image->setVertexShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Vertex));
-    image->setFragmentShaderCode(shaderBuilder.getShaderCode(QOpenGLShader::Fragment));
+    m_filterPlan = shaderBuilder.getFilterPlan();
+    m_filterPassVertexShaderCode.clear();
+    m_filterPassFragmentShaderCode.clear();
+    if (objectId != ImageObject)
+        return;
 
-    return image;
+    for (int pass = 0; pass < m_filterPlan.offscreenPassCount(); ++pass) {
+        if (m_filterPassVertexShaderCode.isEmpty())
+            m_filterPassVertexShaderCode = shaderBuilder.getFilterPassShaderCode(QOpenGLShader::Vertex, pass);
+        m_filterPassFragmentShaderCode.append(shaderBuilder.getFilterPassShaderCode(QOpenGLShader::Fragment, pass));
+    }
 }
 
-GLObjectDescriptor::GLObjectDescriptor(const QString &imagePath)
+GLObjectDescriptor::GLObjectDescriptor()
     : m_image(0)
+    , m_rawImage(0)
+    , m_tessellation(0)
+    , m_cpuDataReleased(false)
+    , m_releasedVertexCount(0)
+    , m_releasedIndexCount(0)
+    , m_releasedHasColors(false)
+    , m_releasedHasTexture(false)
+    , m_objectId(None)
     , m_cullFaceEnabled(false)
     , m_polygonLineModeEnabled(false)
 {
-    QFileInfo imageFile(imagePath);
-    if (imageFile.exists() && imageFile.isFile())
-        m_image.reset(new QImage(imagePath));
 }
 
 
@@ -243,10 +407,147 @@ GLObjectDescriptor::~GLObjectDescriptor()
 {
 }
 
-QSize GLObjectDescriptor::getTextureImageSize()
+bool GLObjectDescriptor::hasColors() const
+{
+    if (m_cpuDataReleased)
+        return m_releasedHasColors;
+
+    return !m_colors.isEmpty();
+}
+
+bool GLObjectDescriptor::hasTexture() const
+{
+    if (m_cpuDataReleased)
+        return m_releasedHasTexture;
+
+    return !m_textureCoordinates.isEmpty();
+}
+
+int GLObjectDescriptor::getVertexCount() const
+{
+    if (m_cpuDataReleased)
+        return m_releasedVertexCount;
+
+    if (!m_meshCache.isNull())
+        return m_meshCache->getVertexCount();
+
+    return m_vertices.count();
+}
+
+int GLObjectDescriptor::getIndexCount() const
 {
-    if (m_image.isNull())
-        return QSize(0, 0);
+    if (m_cpuDataReleased)
+        return m_releasedIndexCount;
+
+    if (!m_meshCache.isNull())
+        return m_meshCache->getIndexCount();
+
+    return m_indices.count();
+}
+
+int GLObjectDescriptor::getTriangleCount() const
+{
+    return (hasIndices() ? getIndexCount() : getVertexCount()) / 3;
+}
+
+bool GLObjectDescriptor::supportsLod() const
+{
+    switch (m_objectId) {
+    case MeshObject:
+    case SphereObject:
+    case TorusObject:
+    case GridObject:
+        return getTriangleCount() >= MeshLod::MinimumTriangleCount;
+    default:
+        return false;
+    }
+}
+
+QFuture<MeshLodChain> GLObjectDescriptor::generateLodChain() const
+{
+    const QSharedPointer<MeshCache> meshCache = m_meshCache;
+    const QVector<QVector3D> vertices = m_vertices;
+    const QVector<GLuint> indices = m_indices;
+    const QVector3D boundsMin = m_boundsMin;
+    const QVector3D boundsMax = m_boundsMax;
+
+    return QtConcurrent::run([=]() -> MeshLodChain {
+        TRACE_ZONE("GLObjectDescriptor::generateLodChain");
+        if (meshCache) {
+            // The cache holds quantized positions, the clustering needs floats
+            QVector<QVector3D> positions(meshCache->getVertexCount());
+            const uchar *vertexData = meshCache->getVertexData();
+            for (int v = 0; v < positions.count(); ++v) {
+                const GLshort *encoded = reinterpret_cast<const GLshort *>(vertexData + qint64(v) * meshCache->getVertexStride());
+                positions[v] = VertexQuantizer::decodePosition(encoded, boundsMin, boundsMax);
+            }
+
+            const GLuint *indexData = reinterpret_cast<const GLuint *>(meshCache->getIndexData());
+            return MeshLod::generate(reinterpret_cast<const uchar *>(positions.constData()), sizeof(QVector3D), positions.count(),
+                                     meshCache->getIndexCount() ? indexData : 0, meshCache->getIndexCount(),
+                                     boundsMin, boundsMax);
+        }
+
+        return MeshLod::generate(reinterpret_cast<const uchar *>(vertices.constData()), sizeof(QVector3D), vertices.count(),
+                                 indices.isEmpty() ? 0 : indices.constData(), indices.count(),
+                                 boundsMin, boundsMax);
+    });
+}
+
+void GLObjectDescriptor::releaseCpuData()
+{
+    if (m_cpuDataReleased)
+        return;
+
+    TRACE_ZONE("GLObjectDescriptor::releaseCpuData");
+    m_releasedVertexCount = getVertexCount();
+    m_releasedIndexCount = getIndexCount();
+    m_releasedHasColors = hasColors();
+    m_releasedHasTexture = hasTexture();
+
+    // clear() keeps the capacity, swapping with an empty vector frees it
+    QVector<QVector3D>().swap(m_vertices);
+    QVector<QVector3D>().swap(m_colors);
+    QVector<QVector2D>().swap(m_textureCoordinates);
+    QVector<GLuint>().swap(m_indices);
+    m_image.reset();
+    m_rawImage.reset();
+    m_meshCache.clear();
+
+    m_cpuDataReleased = true;
+}
+
+bool GLObjectDescriptor::reloadCpuData()
+{
+    if (!m_cpuDataReleased)
+        return true;
+
+    TRACE_ZONE("GLObjectDescriptor::reloadCpuData");
+    m_cpuDataReleased = false;
+    if (!loadGeometry()) {
+        qWarning() << "Unable to reload the geometry of" << m_sourcePath;
+        releaseCpuData();
+        return false;
+    }
+
+    return true;
+}
+
+qint64 GLObjectDescriptor::getCpuMemoryUsage() const
+{
+    qint64 bytes = qint64(m_vertices.capacity()) * sizeof(QVector3D)
+            + qint64(m_colors.capacity()) * sizeof(QVector3D)
+            + qint64(m_textureCoordinates.capacity()) * sizeof(QVector2D)
+            + qint64(m_indices.capacity()) * sizeof(GLuint);
+
+    if (!m_image.isNull())
+        bytes += qint64(m_image->bytesPerLine()) * m_image->height();
+
+    if (!m_rawImage.isNull())
+        bytes += m_rawImage->getDataSize();
+
+    if (!m_meshCache.isNull())
+        bytes += m_meshCache->getVertexDataSize() + m_meshCache->getIndexDataSize();
 
-    return m_image->size();
+    return bytes;
 }
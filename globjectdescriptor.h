@@ -1,57 +1,119 @@
 #ifndef GLOBJECTDESCRIPTOR_H
 #define GLOBJECTDESCRIPTOR_H
 
+#include <QFuture>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
 #include <QScopedPointer>
+#include <QSharedPointer>
+#include <QSize>
 #include <QString>
 #include <QStringList>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector>
 
+#include "filtergraph.h"
+#include "meshlod.h"
+
+class MeshCache;
 class QImage;
+class RawImage;
 class ShaderConfig;
 
 class GLObjectDescriptor
 {
 public:
+    enum GLObjectId {
+        None,
+        ConeObject,
+        CubeObject,
+        ImageObject,
+        MeshObject,
+        SphereObject,
+        TorusObject,
+        GridObject
+    };
+
     static GLObjectDescriptor *createConeDescriptor(ShaderConfig* shaderConfig, int triangleCount);
     static GLObjectDescriptor *createCubeDescriptor(ShaderConfig* shaderConfig);
     static GLObjectDescriptor *createImageDescriptor(ShaderConfig* shaderConfig, const QString &imagePath);
+    static GLObjectDescriptor *createMeshDescriptor(ShaderConfig* shaderConfig, const QString &meshPath);
+    static GLObjectDescriptor *createProceduralDescriptor(ShaderConfig* shaderConfig, GLObjectId objectId, int segments);
 
-    GLObjectDescriptor(const QString &imagePath = QString());
+    GLObjectDescriptor();
     ~GLObjectDescriptor();
 
     QVector<QVector3D> getVertices() const { return m_vertices; }
 
     QVector<QVector3D> getColors() const { return m_colors; }
-    bool hasColors() const { return !m_colors.isEmpty(); }
+    bool hasColors() const;
 
     QVector<QVector2D> getTextureCoordinates() const { return m_textureCoordinates; }
-    bool hasTexture() const { return !m_textureCoordinates.isEmpty(); }
+    bool hasTexture() const;
 
+    // The image is null once the CPU data has been released, its size is kept.
+    // Raw images are mapped instead of decoded into a QImage.
     QImage *getTextureImage() { return m_image.data(); }
-    bool hasTextureImage() { return !m_image.isNull(); }
-    QSize getTextureImageSize();
+    const RawImage *getRawTextureImage() const { return m_rawImage.data(); }
+    bool hasTextureImage() const { return !m_imageSize.isEmpty(); }
+    QSize getTextureImageSize() const { return m_imageSize; }
+
+    GLObjectId getObjectId() const { return m_objectId; }
+
+    int getVertexCount() const;
+    int getTriangleCount() const;
+
+    const QVector<GLuint> &getIndices() const { return m_indices; }
+    bool hasIndices() const { return getIndexCount() > 0; }
+    int getIndexCount() const;
+
+    // Geometry mapped from the mesh cache instead of the vectors above
+    const MeshCache *getMeshCache() const { return m_meshCache.data(); }
+
+    // Maps the object into the [-1, 1] cube, identity for the built-in objects
+    QMatrix4x4 getModelMatrix() const { return m_modelMatrix; }
+    QString getLoadStatistics() const { return m_loadStatistics; }
+
+    // Simplifies the mesh in a worker thread, the geometry is shared with the
+    // task so the descriptor can be deleted before it finishes.
+    bool supportsLod() const;
+    QFuture<MeshLodChain> generateLodChain() const;
 
-    int getVertexCount() const { return m_vertices.count(); }
+    // Frees the vertices, indices, image and mapped cache once they have
+    // been uploaded. The counts and flags above stay valid, the geometry is
+    // loaded again from its source by reloadCpuData().
+    void releaseCpuData();
+    bool reloadCpuData();
+    bool isCpuDataReleased() const { return m_cpuDataReleased; }
+    qint64 getCpuMemoryUsage() const;
 
     QString getVertexShaderCode() const { return m_vertexShaderCode.join("\n"); }
     QString getFragmentShaderCode() const { return m_fragmentShaderCode.join("\n"); }
 
+    const FilterPlan &getFilterPlan() const { return m_filterPlan; }
+    int getFilterPassCount() const { return m_filterPassFragmentShaderCode.count(); }
+    QString getFilterPassVertexShaderCode() const { return m_filterPassVertexShaderCode.join("\n"); }
+    QString getFilterPassFragmentShaderCode(int pass) const { return m_filterPassFragmentShaderCode.value(pass).join("\n"); }
+
     void setCullFace(bool enabled) { m_cullFaceEnabled = enabled; }
     bool isCullFaceEnabled() const { return m_cullFaceEnabled; }
 
     void setPolygonLineMode(bool enabled) { m_polygonLineModeEnabled = enabled; }
     bool isPolygonLineModeEnabled() const { return m_polygonLineModeEnabled; }
 
-    enum GLObjectId {
-        None,
-        ConeObject,
-        CubeObject,
-        ImageObject
-    };
+    void buildShaderCode(GLObjectId objectId, ShaderConfig *shaderConfig);
 
 private:
+    static GLObjectDescriptor *create(GLObjectId objectId, const QString &sourcePath, int tessellation, ShaderConfig *shaderConfig);
+
+    bool loadGeometry();
+    void generateCone(int triangleCount);
+    void generateCube();
+    bool loadImage(const QString &imagePath);
+    bool loadMesh(const QString &meshPath);
+    bool generateShape(GLObjectId objectId, int segments);
+
     template<typename T>
     void setVertices(T vertices[][3], int count)
     {
@@ -99,12 +161,36 @@ private:
     QVector<QVector3D> m_vertices;
     QVector<QVector3D> m_colors;
     QVector<QVector2D> m_textureCoordinates;
+    QVector<GLuint> m_indices;
+    QSharedPointer<MeshCache> m_meshCache;
+    QVector3D m_boundsMin;
+    QVector3D m_boundsMax;
+
+    QMatrix4x4 m_modelMatrix;
+    QString m_loadStatistics;
 
     QScopedPointer<QImage> m_image;
+    QScopedPointer<RawImage> m_rawImage;
+    QSize m_imageSize;
+
+    // Source of the geometry, to load it again after it has been released
+    QString m_sourcePath;
+    int m_tessellation;
+
+    bool m_cpuDataReleased;
+    int m_releasedVertexCount;
+    int m_releasedIndexCount;
+    bool m_releasedHasColors;
+    bool m_releasedHasTexture;
 
     QStringList m_vertexShaderCode;
     QStringList m_fragmentShaderCode;
 
+    FilterPlan m_filterPlan;
+    QStringList m_filterPassVertexShaderCode;
+    QVector<QStringList> m_filterPassFragmentShaderCode;
+
+    GLObjectId m_objectId;
     bool m_cullFaceEnabled;
     bool m_polygonLineModeEnabled;
 };
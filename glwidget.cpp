@@ -1,16 +1,67 @@
 #include "glwidget.h"
 
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QJsonObject>
 #include <QMouseEvent>
+#include <QOpenGLFramebufferObject>
+#include <QStringList>
 #include <QTimer>
+#include <QVector4D>
 #include <QWheelEvent>
 
+#include "filterpipeline.h"
 #include "globjectdescriptor.h"
+#include "meshcache.h"
+#include "portablepixmap.h"
+#include "rawimage.h"
+#include "rendertargetpool.h"
+#include "sessionrecorder.h"
+#include "shadercompiler.h"
+#include "thumbnailgallery.h"
+#include "tracer.h"
+#include "vertexquantizer.h"
 
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget(parent)
+    , m_shaderCompiler(0)
+    , m_renderTargetPool(0)
+    , m_filterPipeline(0)
+    , m_reducedPrecisionSupported(false)
+    , m_shaderProgram(0)
+    , m_backgroundCompilationEnabled(true)
+    , m_indexBuffer(QOpenGLBuffer::IndexBuffer)
+    , m_vertexBufferSize(0)
+    , m_interleavedVertexStride(0)
+    , m_interleavedColors(false)
+    , m_lodWatcher(new QFutureWatcher<MeshLodChain>(this))
+    , m_lodIndexBuffer(QOpenGLBuffer::IndexBuffer)
+    , m_lodBufferSize(0)
+    , m_lodLevel(0)
+    , m_trianglesDrawn(0)
+    , m_gallery(0)
+    , m_galleryVisible(false)
     , m_texture(QOpenGLTexture::Target2D)
+    , m_textureSize(0)
     , m_objectDescriptor(0)
+    , m_releaseCpuData(true)
+    , m_selectingRegion(false)
     , m_shaderAnimTimer(new QTimer(this))
+    , m_vertexShaderTime(0.0)
+    , m_previewRefineTimer(new QTimer(this))
+    , m_adaptivePreviewEnabled(true)
+    , m_previewSupported(false)
+    , m_interacting(false)
+    , m_previewScale(1.0)
+    , m_previewTargetFrameTime(1000.0 / 60.0)
+    , m_previewRefineDelay(300)
+    , m_antialiasingMode(NoAntialiasing)
+    , m_maxSamples(0)
+    , m_fxaaProgram(0)
 {
     m_distance = 5.0;
     //m_yRotateAngle = 25;
@@ -21,10 +72,29 @@ GLWidget::GLWidget(QWidget *parent)
     m_yCameraPosition = 0.0;
 
     connect(m_shaderAnimTimer, SIGNAL(timeout()), this, SLOT(shaderAnimTimerTimeout()));
+    m_vertexShaderClock.start();
+
+    m_previewRefineTimer->setSingleShot(true);
+    connect(m_previewRefineTimer, SIGNAL(timeout()), this, SLOT(refinePreview()));
+
+    connect(m_lodWatcher, SIGNAL(finished()), this, SLOT(onLodChainReady()));
 }
 
 GLWidget::~GLWidget()
 {
+    // Programs and buffers have to be released with the context current
+    makeCurrent();
+    m_gallery.reset();
+    qDeleteAll(m_comparisonDescriptors);
+    m_filterPipeline.reset();
+    m_renderTargetPool.reset();
+    m_shaderCompiler.reset();
+    m_vertexBuffer.destroy();
+    m_indexBuffer.destroy();
+    m_lodVertexBuffer.destroy();
+    m_lodIndexBuffer.destroy();
+    m_texture.destroy();
+    doneCurrent();
 }
 
 void GLWidget::initializeGL()
@@ -34,6 +104,76 @@ void GLWidget::initializeGL()
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     m_vertexBuffer.create();
+    m_indexBuffer.create();
+    m_lodVertexBuffer.create();
+    m_lodIndexBuffer.create();
+
+    m_shaderCompiler.reset(new ShaderCompiler(context()));
+    connect(m_shaderCompiler.data(), SIGNAL(programReady(QByteArray)), this, SLOT(onShaderProgramReady(QByteArray)));
+    connect(m_shaderCompiler.data(), SIGNAL(programFailed(QByteArray)), this, SLOT(onShaderProgramFailed(QByteArray)));
+    m_shaderProgram = 0;
+    m_comparisonPrograms.clear();
+    m_shaderProgramVertexCode.clear();
+    m_pendingShaderProgramKey.clear();
+
+    m_filterPipeline.reset();
+    m_renderTargetPool.reset(new RenderTargetPool);
+    m_filterPipeline.reset(new FilterPipeline);
+    m_filterPipeline->initialize(m_shaderCompiler.data(), m_renderTargetPool.data());
+    m_filterPipeline->setRegionOfInterest(m_regionOfInterest);
+    m_reducedPrecisionSupported = RenderTargetPool::supportsReducedFormats(context());
+    m_previewSupported = QOpenGLFramebufferObject::hasOpenGLFramebufferBlit();
+
+    m_maxSamples = 0;
+    if (m_previewSupported && QOpenGLFramebufferObject::hasOpenGLFramebufferMultisample())
+        glGetIntegerv(GL_MAX_SAMPLES, &m_maxSamples);
+
+    // The anti-aliasing pass draws the scene target over the whole widget
+    ShaderBuilder shaderBuilder("120");
+    shaderBuilder.setVariables(QOpenGLShader::Vertex, QStringList()
+                               << "attribute vec4 vertex;"
+                               << "attribute vec2 textureCoordinate;"
+                               << "varying vec2 varyingTextureCoordinate;");
+    shaderBuilder.setMainBody(QOpenGLShader::Vertex, QStringList()
+                              << "varyingTextureCoordinate = textureCoordinate;"
+                              << "gl_Position = vertex;");
+    shaderBuilder.setVariables(QOpenGLShader::Fragment, QStringList()
+                               << "uniform sampler2D texture;"
+                               << "uniform vec2 textureSize;"
+                               << "varying vec2 varyingTextureCoordinate;");
+    shaderBuilder.setMainBody(QOpenGLShader::Fragment, QStringList()
+                              << "gl_FragColor = fxaa(texture, textureSize, varyingTextureCoordinate);");
+    m_fxaaProgram = m_shaderCompiler->program(shaderBuilder.getShaderCode(QOpenGLShader::Vertex).join("\n"),
+                                              shaderBuilder.getShaderCode(QOpenGLShader::Fragment).join("\n"));
+    if (!m_fxaaProgram->isLinked())
+        m_fxaaProgram = 0;
+
+    // A recreated context loses the thumbnails, they are decoded again
+    QScopedPointer<ThumbnailGallery> previousGallery(m_gallery.take());
+    if (ThumbnailGallery::isSupported(context())) {
+        m_gallery.reset(new ThumbnailGallery);
+        m_gallery->initialize(m_shaderCompiler.data());
+        connect(m_gallery.data(), SIGNAL(thumbnailReady()), this, SLOT(update()));
+        if (previousGallery) {
+            m_gallery->setShaderConfig(previousGallery->shaderConfig());
+            if (m_galleryVisible)
+                m_gallery->setImages(m_galleryImagePaths);
+        }
+    } else {
+        m_galleryVisible = false;
+    }
+
+    // The descriptor may have been set before the context was ready, or the
+    // context was recreated after the CPU copies had been released
+    if (!m_objectDescriptor.isNull() && m_objectDescriptor->reloadCpuData()) {
+        updateVertexBuffer();
+        updateTexture();
+        updateShaderProgram();
+        updateFilterPipeline();
+        uploadLodChain();
+        if (m_releaseCpuData)
+            m_objectDescriptor->releaseCpuData();
+    }
 }
 
 void GLWidget::resizeGL(int width, int height)
@@ -45,34 +185,181 @@ void GLWidget::resizeGL(int width, int height)
     m_projection.perspective(60.0, (float) width / (float) height, 0.001, 1000);
 
     glViewport(0, 0, width, height);
+
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("width", width);
+        arguments.insert("height", height);
+        SessionRecorder::record("resize", arguments);
+    }
+}
+
+double GLWidget::renderFrame()
+{
+    // A hidden widget is never painted, it is drawn into its framebuffer
+    // object which lives on an offscreen surface
+    if (!isVisible() && !m_shaderCompiler) {
+        grabFramebuffer();
+        makeCurrent();
+        resizeGL(width(), height());
+        doneCurrent();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (isVisible()) {
+        repaint();
+        makeCurrent();
+    } else {
+        makeCurrent();
+        paintGL();
+    }
+
+    glFinish();
+    doneCurrent();
+
+    return timer.nsecsElapsed() / 1000000.0;
 }
 
 void GLWidget::paintGL()
 {
+    TRACE_ZONE("GLWidget::paintGL");
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    m_renderTargetPool->beginFrame();
+    m_trianglesDrawn = 0;
+    m_vertexShaderTime = m_vertexShaderClock.nsecsElapsed() / 1000000000.0;
+    SessionRecorder::record("frame");
+
+    if (m_galleryVisible) {
+        paintGallery();
+        return;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const QSize viewportSize(viewport[2], viewport[3]);
+
+    // Intermediate filter passes are rendered before the object is drawn
+    GLuint filterResultTexture = 0;
+    if (!m_objectDescriptor.isNull() && m_objectDescriptor->hasTextureImage())
+        filterResultTexture = m_filterPipeline->process(m_texture.textureId(), m_objectDescriptor->getTextureImageSize());
+
+    // While the user interacts the scene is drawn into a smaller target which
+    // is scaled up to the widget, the full resolution frame is drawn once the
+    // input has been idle for the refine delay. Anti-aliasing also draws the
+    // scene offscreen, into a multisampled target or one for the FXAA pass.
+    QSize targetSize = viewportSize;
+    if (m_interacting && m_previewScale < 1.0 && m_previewSupported)
+        targetSize = (QSizeF(viewportSize) * m_previewScale).toSize().expandedTo(QSize(1, 1));
+
+    const AntialiasingMode antialiasing = effectiveAntialiasingMode();
+    const int samples = antialiasingSamples(antialiasing);
+    const bool fxaa = (antialiasing == Fxaa);
+    QOpenGLFramebufferObject *sceneTarget = 0;
+    if (targetSize != viewportSize || samples > 0 || fxaa) {
+        sceneTarget = m_renderTargetPool->acquire(targetSize, GL_RGBA8, QOpenGLFramebufferObject::CombinedDepthStencil, samples);
+        sceneTarget->bind();
+        glViewport(0, 0, targetSize.width(), targetSize.height());
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    }
+    selectLodLevel(targetSize.height());
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // If object descriptor is not set there is nothing to paint
-    if (m_objectDescriptor.isNull())
-        return;
+    if (!m_comparisonPrograms.isEmpty())
+        drawComparisonViews(targetSize, QRect(QPoint(0, 0), targetSize));
+    else if (!m_objectDescriptor.isNull() && m_shaderProgram)
+        drawObject(m_projection * viewMatrix() * modelMatrix() * m_objectDescriptor->getModelMatrix() * m_positionDecodeMatrix, m_shaderProgram, filterResultTexture);
 
-    if (m_objectDescriptor->isCullFaceEnabled())
-        glEnable(GL_CULL_FACE);
-    else
-        glDisable(GL_CULL_FACE);
+    if (sceneTarget) {
+        // A blit only resolves the samples without scaling, the preview is
+        // resolved at its own size first
+        QOpenGLFramebufferObject *resolvedTarget = sceneTarget;
+        if (samples > 0 && targetSize != viewportSize) {
+            resolvedTarget = m_renderTargetPool->acquire(targetSize, GL_RGBA8);
+            QOpenGLFramebufferObject::blitFramebuffer(resolvedTarget, sceneTarget, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
 
-    if (m_objectDescriptor->isPolygonLineModeEnabled())
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    else
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (fxaa) {
+            drawFxaa(resolvedTarget->texture(), targetSize);
+        } else {
+            QOpenGLFramebufferObject::blitFramebuffer(0, QRect(QPoint(0, 0), viewportSize),
+                                                      resolvedTarget, QRect(QPoint(0, 0), targetSize),
+                                                      GL_COLOR_BUFFER_BIT, targetSize == viewportSize ? GL_NEAREST : GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        }
+
+        if (resolvedTarget != sceneTarget)
+            m_renderTargetPool->release(resolvedTarget);
+        m_renderTargetPool->release(sceneTarget);
+    }
 
+    QStringList statistics;
+    statistics.append(m_renderTargetPool->statistics());
+    if (!m_objectDescriptor.isNull()) {
+        QString triangles = QString("Triangles: %0").arg(m_trianglesDrawn);
+        if (!m_lodChain.isEmpty())
+            triangles.append(QString(" (LOD %0/%1)").arg(m_lodLevel).arg(m_lodChain.count()));
+        statistics.append(triangles);
+        if (!m_regionOfInterest.isEmpty() && m_objectDescriptor->hasTextureImage()) {
+            const QSize imageSize = m_objectDescriptor->getTextureImageSize();
+            statistics.append(QString("Region: %0x%1, %2% of the image")
+                              .arg(m_regionOfInterest.width())
+                              .arg(m_regionOfInterest.height())
+                              .arg(100.0 * m_regionOfInterest.width() * m_regionOfInterest.height()
+                                   / (double(imageSize.width()) * imageSize.height()), 0, 'f', 1));
+        }
+        if (!m_comparisonPrograms.isEmpty()) {
+            statistics.append(QString("Views: %0, filter passes: %1 of %2")
+                              .arg(m_comparisonPrograms.count())
+                              .arg(m_filterPipeline->passCount())
+                              .arg(m_filterPipeline->viewPassCount()));
+        }
+        statistics.append(QString("Memory: %0").arg(totalMemoryUsage().toString()));
+    }
+    if (antialiasing != NoAntialiasing) {
+        statistics.append(QString("Anti-aliasing: %0, %1 MB")
+                          .arg(antialiasingModeName(antialiasing))
+                          .arg(antialiasingMemoryUsage().gpuBytes / (1024.0 * 1024.0), 0, 'f', 1));
+    }
+
+    if (m_interacting) {
+        // The frame time is only measured while it is used to pick the scale
+        glFinish();
+        adaptPreviewScale(frameTimer.nsecsElapsed() / 1000000.0);
+        statistics.append(QString("Preview: %0%").arg(qRound(m_previewScale * 100)));
+    }
+
+    Q_EMIT(frameStatisticsChanged(statistics.join(", ")));
+
+    // A displacing vertex shader keeps the widget drawing
+    if (m_shaderProgram && m_shaderProgram->uniformLocation("time") >= 0)
+        update();
+}
+
+QMatrix4x4 GLWidget::modelMatrix() const
+{
     QMatrix4x4 mMatrix;
-    QMatrix4x4 vMatrix;
 
     QMatrix4x4 rotationMatrix;
     rotationMatrix.rotate(m_yRotateAngle, 0, 1, 0);
     rotationMatrix.rotate(m_xRotateAngle, 1, 0, 0);
     mMatrix *= rotationMatrix;
 
+    return mMatrix;
+}
+
+QMatrix4x4 GLWidget::viewMatrix() const
+{
+    QMatrix4x4 vMatrix;
+
     QMatrix4x4 translationMatrix;
     translationMatrix.translate(m_xCameraPosition, m_yCameraPosition, 0);
     QVector3D eye = translationMatrix * QVector3D(0, 0, m_distance);
@@ -80,79 +367,544 @@ void GLWidget::paintGL()
     QVector3D up = QVector3D(0, 1, 0);
     vMatrix.lookAt(eye, center, up);
 
+    return vMatrix;
+}
 
-    m_shaderProgram.bind();
-    m_shaderProgram.setUniformValue("mvpMatrix", m_projection * vMatrix * mMatrix);
+void GLWidget::drawObject(const QMatrix4x4 &mvpMatrix, QOpenGLShaderProgram *program, GLuint filterResultTexture, int view)
+{
+    if (m_objectDescriptor->isCullFaceEnabled())
+        glEnable(GL_CULL_FACE);
+    else
+        glDisable(GL_CULL_FACE);
+
+    if (m_objectDescriptor->isPolygonLineModeEnabled())
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    else
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    program->bind();
+    program->setUniformValue("mvpMatrix", mvpMatrix);
     if (m_objectDescriptor->hasTextureImage()) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, filterResultTexture);
+        glActiveTexture(GL_TEXTURE0);
         m_texture.bind();
-        m_shaderProgram.setUniformValue("texture", 0);
+        program->setUniformValue("texture", 0);
+        program->setUniformValue("inputTexture", 1);
         QSize textureSize = m_objectDescriptor->getTextureImageSize();
-        m_shaderProgram.setUniformValue("textureSize", QVector2D(textureSize.width(), textureSize.height()));
+        program->setUniformValue("textureSize", QVector2D(textureSize.width(), textureSize.height()));
+
+        // Left, bottom, right and top in texture coordinates
+        QVector4D region;
+        if (!m_regionOfInterest.isEmpty()) {
+            region = QVector4D(m_regionOfInterest.left() / GLfloat(textureSize.width()),
+                               m_regionOfInterest.top() / GLfloat(textureSize.height()),
+                               (m_regionOfInterest.left() + m_regionOfInterest.width()) / GLfloat(textureSize.width()),
+                               (m_regionOfInterest.top() + m_regionOfInterest.height()) / GLfloat(textureSize.height()));
+        }
+        program->setUniformValue("regionOfInterest", region);
     }
-    m_shaderProgram.setUniformValue("animProgress", m_shaderAnimProgress);
+    program->setUniformValue("animProgress", m_shaderAnimProgress);
+
+    // The displacement works in the space of the object fitted into the unit
+    // cube, only the programs with a vertex shader function use these
+    const QMatrix4x4 objectMatrix = m_objectDescriptor->getModelMatrix() * m_positionDecodeMatrix;
+    program->setUniformValue("time", m_vertexShaderTime);
+    program->setUniformValue("objectMatrix", objectMatrix);
+    program->setUniformValue("objectMatrixInverse", objectMatrix.inverted());
+    const bool colorLutBound = m_filterPipeline->bindObjectColorLut(program, view);
 
     int offset = 0;
     int vertexCount = m_objectDescriptor->getVertexCount();
 
-    m_vertexBuffer.bind();
-    m_shaderProgram.setAttributeBuffer("vertex", GL_FLOAT, offset, 3, 0);
-    m_shaderProgram.enableAttributeArray("vertex");
-    offset += vertexCount * 3 * sizeof(GLfloat);
+    // Positions are normalized shorts, colors normalized bytes and texture
+    // coordinates normalized unsigned shorts, see VertexQuantizer.
+    if (m_lodLevel > 0) {
+        // Simplified levels only have positions
+        m_lodVertexBuffer.bind();
+        program->setAttributeBuffer("vertex", GL_SHORT, 0, 3, VertexQuantizer::PositionStride);
+        program->enableAttributeArray("vertex");
+        m_lodVertexBuffer.release();
+    } else {
+        m_vertexBuffer.bind();
+        if (m_interleavedVertexStride) {
+            // Cached meshes are interleaved
+            const int stride = m_interleavedVertexStride;
+            program->setAttributeBuffer("vertex", GL_SHORT, 0, 3, stride);
+            program->enableAttributeArray("vertex");
+            if (m_interleavedColors) {
+                program->setAttributeBuffer("color", GL_UNSIGNED_BYTE, VertexQuantizer::PositionStride, 3, stride);
+                program->enableAttributeArray("color");
+            }
+        } else {
+            program->setAttributeBuffer("vertex", GL_SHORT, offset, 3, VertexQuantizer::PositionStride);
+            program->enableAttributeArray("vertex");
+            offset += vertexCount * VertexQuantizer::PositionStride;
 
-    if (m_objectDescriptor->hasColors()) {
-        m_shaderProgram.setAttributeBuffer("color", GL_FLOAT, offset, 3, 0);
-        m_shaderProgram.enableAttributeArray("color");
-        offset += vertexCount * 3 * sizeof(GLfloat);
-    }
+            if (m_objectDescriptor->hasColors()) {
+                program->setAttributeBuffer("color", GL_UNSIGNED_BYTE, offset, 3, VertexQuantizer::ColorStride);
+                program->enableAttributeArray("color");
+                offset += vertexCount * VertexQuantizer::ColorStride;
+            }
 
-    if (m_objectDescriptor->hasTexture()) {
-        m_shaderProgram.setAttributeBuffer("textureCoordinate", GL_FLOAT, offset, 2, 0);
-        m_shaderProgram.enableAttributeArray("textureCoordinate");
-        offset += vertexCount * 2 * sizeof(GLfloat);
+            if (m_objectDescriptor->hasTexture()) {
+                program->setAttributeBuffer("textureCoordinate", GL_UNSIGNED_SHORT, offset, 2, VertexQuantizer::TextureCoordinateStride);
+                program->enableAttributeArray("textureCoordinate");
+                offset += vertexCount * VertexQuantizer::TextureCoordinateStride;
+            }
+        }
+
+        m_vertexBuffer.release();
     }
 
-    m_vertexBuffer.release();
+    if (m_lodLevel > 0) {
+        const int indexCount = m_lodIndexCounts.at(m_lodLevel - 1);
+        const qintptr indexOffset = m_lodIndexOffsets.at(m_lodLevel - 1) * sizeof(GLuint);
+        m_lodIndexBuffer.bind();
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, reinterpret_cast<const void *>(indexOffset));
+        m_lodIndexBuffer.release();
+        m_trianglesDrawn = indexCount / 3;
+    } else if (m_objectDescriptor->hasIndices()) {
+        m_indexBuffer.bind();
+        glDrawElements(GL_TRIANGLES, m_objectDescriptor->getIndexCount(), GL_UNSIGNED_INT, 0);
+        m_indexBuffer.release();
+        m_trianglesDrawn = m_objectDescriptor->getTriangleCount();
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        m_trianglesDrawn = m_objectDescriptor->getTriangleCount();
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    program->disableAttributeArray("vertex");
+    program->disableAttributeArray("color");
+    program->disableAttributeArray("textureCoordinate");
 
-    m_shaderProgram.disableAttributeArray("vertex");
-    m_shaderProgram.disableAttributeArray("color");
+    program->release();
 
-    m_shaderProgram.release();
+    if (colorLutBound)
+        m_filterPipeline->releaseColorLut();
 
     if (m_objectDescriptor->hasTextureImage()) {
         Q_ASSERT(m_texture.isBound());
         m_texture.release();
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+}
+
+void GLWidget::drawComparisonViews(const QSize &targetSize, const QRect &tile)
+{
+    // The views split the target into columns, each of them is drawn with
+    // the projection of its own aspect ratio so the whole image is visible.
+    // The tile is the part of the target in the viewport, an exported tile
+    // only draws the parts of the columns it covers.
+    const int viewCount = m_comparisonPrograms.count();
+    const int columnWidth = qMax(targetSize.width() / viewCount, 1);
+
+    QMatrix4x4 projection;
+    projection.perspective(60.0, float(columnWidth) / float(targetSize.height()), 0.001, 1000);
+    const QMatrix4x4 modelViewMatrix = viewMatrix() * modelMatrix() * m_objectDescriptor->getModelMatrix() * m_positionDecodeMatrix;
+
+    for (int view = 0; view < viewCount; ++view) {
+        const QRect column(view * columnWidth, 0, columnWidth, targetSize.height());
+        const QRect visible = column.intersected(tile);
+        if (visible.isEmpty())
+            continue;
+
+        glViewport(visible.x() - tile.x(), visible.y() - tile.y(), visible.width(), visible.height());
+        drawObject(regionProjection(projection, column.size(), visible.translated(-column.topLeft())) * modelViewMatrix,
+                   m_comparisonPrograms.at(view), m_filterPipeline->resultTexture(view), view);
+    }
+
+    glViewport(0, 0, tile.width(), tile.height());
+}
+
+QMatrix4x4 GLWidget::regionProjection(const QMatrix4x4 &projection, const QSize &size, const QRect &region)
+{
+    // Scales and moves clip space so the region of a viewport of the given
+    // size fills the whole viewport. Regions are in window coordinates,
+    // with the origin at the bottom left.
+    const float centerX = (2.0f * region.x() + region.width()) / size.width() - 1.0f;
+    const float centerY = (2.0f * region.y() + region.height()) / size.height() - 1.0f;
+
+    QMatrix4x4 crop;
+    crop.scale(float(size.width()) / region.width(), float(size.height()) / region.height(), 1.0f);
+    crop.translate(-centerX, -centerY, 0.0f);
+
+    return crop * projection;
+}
+
+bool GLWidget::exportImage(const QString &path, const QSize &size, int tileSize)
+{
+    TRACE_ZONE("GLWidget::exportImage");
+    if (m_objectDescriptor.isNull() || m_galleryVisible || !m_shaderCompiler || size.isEmpty())
+        return false;
+
+    PortablePixmapWriter writer;
+    if (!writer.open(path, size))
+        return false;
+
+    makeCurrent();
+    m_vertexShaderTime = m_vertexShaderClock.nsecsElapsed() / 1000000000.0;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // A tile and its overlap have to fit the viewport and the depth buffer
+    GLint maxViewportDims[2];
+    GLint maxRenderbufferSize;
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+    const int maxTileSize = qMin(qMin(maxViewportDims[0], maxViewportDims[1]), maxRenderbufferSize) - 2 * ExportTileOverlap;
+    tileSize = qBound(1, tileSize, maxTileSize);
+
+    // The filter passes work in image space on the whole image, so every
+    // tile samples the same filtered texels as its neighbours and the
+    // neighbourhood filters have no seams. Only the projection is split.
+    GLuint filterResultTexture = 0;
+    if (m_objectDescriptor->hasTextureImage())
+        filterResultTexture = m_filterPipeline->process(m_texture.textureId(), m_objectDescriptor->getTextureImageSize());
+
+    // The widget's projection with the aspect ratio of the exported image
+    QMatrix4x4 projection;
+    projection.scale((float(width()) / qMax(height(), 1)) / (float(size.width()) / size.height()), 1.0f, 1.0f);
+    projection *= m_projection;
+    const QMatrix4x4 modelViewMatrix = viewMatrix() * modelMatrix() * m_objectDescriptor->getModelMatrix() * m_positionDecodeMatrix;
+
+    selectLodLevel(size.height());
+
+    const QSize renderSize(tileSize + 2 * ExportTileOverlap, tileSize + 2 * ExportTileOverlap);
+    QOpenGLFramebufferObject *target = m_renderTargetPool->acquire(renderSize, GL_RGBA8, QOpenGLFramebufferObject::CombinedDepthStencil);
+    QByteArray pixels(tileSize * tileSize * 3, Qt::Uninitialized);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    bool written = true;
+    for (int y = 0; y < size.height() && written; y += tileSize) {
+        for (int x = 0; x < size.width() && written; x += tileSize) {
+            TRACE_ZONE("GLWidget::exportTile");
+            const QRect tile(x, y, qMin(tileSize, size.width() - x), qMin(tileSize, size.height() - y));
+
+            // The tile in window coordinates with its overlap
+            const QRect region(tile.x() - ExportTileOverlap, size.height() - tile.bottom() - 1 - ExportTileOverlap,
+                               tile.width() + 2 * ExportTileOverlap, tile.height() + 2 * ExportTileOverlap);
+
+            target->bind();
+            glViewport(0, 0, region.width(), region.height());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            if (!m_comparisonPrograms.isEmpty())
+                drawComparisonViews(size, region);
+            else if (m_shaderProgram)
+                drawObject(regionProjection(projection, size, region) * modelViewMatrix, m_shaderProgram, filterResultTexture);
+
+            glReadPixels(ExportTileOverlap, ExportTileOverlap, tile.width(), tile.height(), GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+            written = writer.writeTile(tile, reinterpret_cast<const uchar *>(pixels.constData()));
+        }
+    }
+
+    target->release();
+    m_renderTargetPool->release(target);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    doneCurrent();
+
+    return writer.close() && written;
+}
+
+void GLWidget::adaptPreviewScale(double frameTime)
+{
+    // The cost of the filters is proportional to the pixel count, that is to
+    // the square of the scale.
+    if (frameTime > m_previewTargetFrameTime * 1.1)
+        m_previewScale *= qMax(0.5, sqrt(m_previewTargetFrameTime / frameTime));
+    else if (frameTime < m_previewTargetFrameTime * 0.7)
+        m_previewScale *= 1.1;
+
+    // Quantized to keep the number of distinct preview target sizes low
+    m_previewScale = qBound(0.25, qRound(m_previewScale * 16.0) / 16.0, 1.0);
+}
+
+void GLWidget::setAntialiasingMode(AntialiasingMode mode)
+{
+    if (m_antialiasingMode == mode)
+        return;
+
+    m_antialiasingMode = mode;
+    update();
+}
+
+GLWidget::AntialiasingMode GLWidget::effectiveAntialiasingMode() const
+{
+    switch (m_antialiasingMode) {
+    case Msaa8x:
+        if (m_maxSamples >= 8)
+            return Msaa8x;
+        // Fall through
+    case Msaa4x:
+        if (m_maxSamples >= 4)
+            return Msaa4x;
+        // Fall through
+    case Msaa2x:
+        if (m_maxSamples >= 2)
+            return Msaa2x;
+        return NoAntialiasing;
+    case Fxaa:
+        return m_fxaaProgram ? Fxaa : NoAntialiasing;
+    case NoAntialiasing:
+    default:
+        return NoAntialiasing;
     }
 }
 
+QString GLWidget::antialiasingModeName(AntialiasingMode mode)
+{
+    switch (mode) {
+    case Msaa2x:
+    case Msaa4x:
+    case Msaa8x:
+        return QString("MSAA %0x").arg(antialiasingSamples(mode));
+    case Fxaa:
+        return QString("FXAA");
+    case NoAntialiasing:
+    default:
+        return QString("Off");
+    }
+}
+
+MemoryUsage GLWidget::antialiasingMemoryUsage() const
+{
+    const AntialiasingMode mode = effectiveAntialiasingMode();
+    if (mode == NoAntialiasing)
+        return MemoryUsage();
+
+    return MemoryUsage(0, RenderTargetPool::targetBytes(size() * devicePixelRatio(), GL_RGBA8,
+                                                        QOpenGLFramebufferObject::CombinedDepthStencil,
+                                                        antialiasingSamples(mode)));
+}
+
+int GLWidget::antialiasingSamples(AntialiasingMode mode)
+{
+    switch (mode) {
+    case Msaa2x:
+        return 2;
+    case Msaa4x:
+        return 4;
+    case Msaa8x:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+void GLWidget::drawFxaa(GLuint texture, const QSize &size)
+{
+    TRACE_ZONE("GLWidget::drawFxaa");
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // The taps along the edge fall between the texels
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    m_fxaaProgram->bind();
+    m_fxaaProgram->setUniformValue("texture", 0);
+    m_fxaaProgram->setUniformValue("textureSize", QVector2D(size.width(), size.height()));
+    m_filterPipeline->drawQuad(m_fxaaProgram);
+    m_fxaaProgram->release();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void GLWidget::selectLodLevel(int viewportHeight)
+{
+    if (m_lodChain.isEmpty()) {
+        m_lodLevel = 0;
+        return;
+    }
+
+    // Pixels per unit at the origin for the 60 degree vertical field of view
+    const double eyeDistance = QVector3D(m_xCameraPosition, m_yCameraPosition, m_distance).length();
+    const double pixelsPerUnit = viewportHeight / (2.0 * eyeDistance * tan(M_PI / 6.0));
+
+    m_lodLevel = MeshLod::selectLevel(m_lodChain, m_lodLevel, pixelsPerUnit);
+}
+
+void GLWidget::clearLodChain()
+{
+    m_lodChain.clear();
+    m_lodIndexOffsets.clear();
+    m_lodIndexCounts.clear();
+    m_lodBufferSize = 0;
+    m_lodLevel = 0;
+}
+
+void GLWidget::notifyInteraction()
+{
+    if (!m_adaptivePreviewEnabled)
+        return;
+
+    m_interacting = true;
+    m_previewRefineTimer->start(m_previewRefineDelay);
+}
+
+void GLWidget::setAdaptivePreviewEnabled(bool enabled)
+{
+    m_adaptivePreviewEnabled = enabled;
+    if (!enabled && m_interacting)
+        refinePreview();
+}
+
+void GLWidget::setPreviewTargetFrameTime(double msec)
+{
+    m_previewTargetFrameTime = msec;
+}
+
+void GLWidget::setPreviewRefineDelay(int msec)
+{
+    m_previewRefineDelay = msec;
+}
+
 void GLWidget::mousePressEvent(QMouseEvent *event)
 {
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("x", event->x());
+        arguments.insert("y", event->y());
+        arguments.insert("button", int(event->button()));
+        arguments.insert("buttons", int(event->buttons()));
+        SessionRecorder::record("mousePress", arguments);
+    }
+
+    QPointF pixel;
+    if (event->button() == Qt::RightButton && imagePosition(event->pos(), &pixel)) {
+        m_selectingRegion = true;
+        m_regionAnchor = pixel;
+    }
+
     m_lastMousePosition = event->pos();
     event->accept();
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("x", event->x());
+        arguments.insert("y", event->y());
+        arguments.insert("buttons", int(event->buttons()));
+        SessionRecorder::record("mouseMove", arguments);
+    }
+
     int deltaX = event->x() - m_lastMousePosition.x();
     int deltaY = event->y() - m_lastMousePosition.y();
 
     if (event->buttons() & Qt::LeftButton) {
+        notifyInteraction();
         // TODO(pvarga): The step of movement should depend on m_distance too.
         m_xCameraPosition -= (double)deltaX / 100.0;
         m_yCameraPosition += (double)deltaY / 100.0;
         update();
     }
 
+    QPointF pixel;
+    if (m_selectingRegion && (event->buttons() & Qt::RightButton) && imagePosition(event->pos(), &pixel)) {
+        const QRect image(QPoint(0, 0), m_objectDescriptor->getTextureImageSize());
+        setRegionOfInterest(QRectF(m_regionAnchor, pixel).normalized().toAlignedRect() & image);
+    }
+
     m_lastMousePosition = event->pos();
     event->accept();
 }
 
+void GLWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("x", event->x());
+        arguments.insert("y", event->y());
+        arguments.insert("button", int(event->button()));
+        arguments.insert("buttons", int(event->buttons()));
+        SessionRecorder::record("mouseRelease", arguments);
+    }
+
+    // A click without dragging clears the region
+    if (event->button() == Qt::RightButton && m_selectingRegion) {
+        m_selectingRegion = false;
+        if (m_regionOfInterest.width() < 2 || m_regionOfInterest.height() < 2)
+            setRegionOfInterest(QRect());
+    }
+
+    event->accept();
+}
+
+bool GLWidget::imagePosition(const QPoint &position, QPointF *pixel) const
+{
+    if (m_objectDescriptor.isNull() || !m_objectDescriptor->hasTextureImage()
+            || !m_comparisonPrograms.isEmpty() || m_galleryVisible || width() <= 0 || height() <= 0)
+        return false;
+
+    // The ray through the position meets the image plane at z = 0
+    bool invertible = false;
+    const QMatrix4x4 inverse = (m_projection * viewMatrix() * modelMatrix() * m_objectDescriptor->getModelMatrix()).inverted(&invertible);
+    if (!invertible)
+        return false;
+
+    const float x = 2.0f * position.x() / width() - 1.0f;
+    const float y = 1.0f - 2.0f * position.y() / height();
+    const QVector3D nearPoint = inverse.map(QVector3D(x, y, -1.0f));
+    const QVector3D farPoint = inverse.map(QVector3D(x, y, 1.0f));
+    if (qFuzzyCompare(nearPoint.z(), farPoint.z()))
+        return false;
+    const QVector3D point = nearPoint + (farPoint - nearPoint) * (nearPoint.z() / (nearPoint.z() - farPoint.z()));
+
+    // The image spans x from -1 to 1 and y by its aspect ratio, see
+    // GLObjectDescriptor::loadImage()
+    const QSize size = m_objectDescriptor->getTextureImageSize();
+    const double canvasHeight = double(size.height()) / size.width();
+    pixel->setX((point.x() + 1.0) / 2.0 * size.width());
+    pixel->setY((point.y() + canvasHeight) / (2.0 * canvasHeight) * size.height());
+    return true;
+}
+
+void GLWidget::setRegionOfInterest(const QRect &region)
+{
+    if (region == m_regionOfInterest)
+        return;
+
+    m_regionOfInterest = region;
+    if (m_filterPipeline)
+        m_filterPipeline->setRegionOfInterest(region);
+    update();
+}
+
 void GLWidget::wheelEvent(QWheelEvent *event)
 {
     int delta = event->delta();
 
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("x", event->x());
+        arguments.insert("y", event->y());
+        arguments.insert("delta", delta);
+        arguments.insert("buttons", int(event->buttons()));
+        arguments.insert("horizontal", event->orientation() == Qt::Horizontal);
+        SessionRecorder::record("wheel", arguments);
+    }
+
+    if (m_galleryVisible) {
+        // One notch of the wheel scrolls half a row
+        m_gallery->scroll(-delta / 240.0);
+        update();
+        event->accept();
+        return;
+    }
+
     if (event->orientation() == Qt::Vertical) {
+        notifyInteraction();
         if (delta < 0)
             m_distance *= 1.1;
         else if (delta > 0)
@@ -164,8 +916,38 @@ void GLWidget::wheelEvent(QWheelEvent *event)
     event->accept();
 }
 
+void GLWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("x", event->x());
+        arguments.insert("y", event->y());
+        arguments.insert("button", int(event->button()));
+        arguments.insert("buttons", int(event->buttons()));
+        SessionRecorder::record("mouseDoubleClick", arguments);
+    }
+
+    if (!m_galleryVisible) {
+        event->ignore();
+        return;
+    }
+
+    const int index = m_gallery->thumbnailAt(event->pos() * devicePixelRatio(), size() * devicePixelRatio());
+    if (index >= 0)
+        Q_EMIT(thumbnailActivated(m_gallery->imagePath(index)));
+
+    event->accept();
+}
+
 void GLWidget::rotate(int angle, Axis::Axis axis)
 {
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("angle", angle);
+        arguments.insert("axis", int(axis));
+        SessionRecorder::record("rotate", arguments);
+    }
+
     switch(axis){
     case Axis::Y:
         m_yRotateAngle += angle;
@@ -185,16 +967,44 @@ void GLWidget::rotate(int angle, Axis::Axis axis)
 }
 
 void GLWidget::updateObjectDescriptor(GLObjectDescriptor *objectDescriptor)
+{
+    updateObjectDescriptor(objectDescriptor, QVector<ShaderConfig>());
+}
+
+void GLWidget::updateObjectDescriptor(GLObjectDescriptor *objectDescriptor, const QVector<ShaderConfig> &comparisonConfigs)
 {
     m_objectDescriptor.reset(objectDescriptor);
-    if (!objectDescriptor) {
+    m_comparisonConfigs = comparisonConfigs;
+
+    // The region only stays while it fits into the image
+    if (!objectDescriptor || !QRect(QPoint(0, 0), objectDescriptor->getTextureImageSize()).contains(m_regionOfInterest))
+        setRegionOfInterest(QRect());
+
+    // A chain still being generated for the previous mesh is ignored
+    clearLodChain();
+    if (objectDescriptor && objectDescriptor->supportsLod())
+        m_lodWatcher->setFuture(objectDescriptor->generateLodChain());
+    else
+        m_lodWatcher->setFuture(QFuture<MeshLodChain>());
+
+    if (!objectDescriptor || !m_shaderCompiler) {
+        qDeleteAll(m_comparisonDescriptors);
+        m_comparisonDescriptors.clear();
+        m_comparisonPrograms.clear();
         update();
         return;
     }
 
+    makeCurrent();
     updateVertexBuffer();
     updateTexture();
     updateShaderProgram();
+    updateFilterPipeline();
+    doneCurrent();
+
+    // The LOD task holds its own references to the geometry
+    if (m_releaseCpuData)
+        objectDescriptor->releaseCpuData();
 
     update();
 }
@@ -204,14 +1014,118 @@ GLObjectDescriptor *GLWidget::getObjectDescriptor() const
     return m_objectDescriptor.data();
 }
 
+void GLWidget::setReleaseCpuData(bool enabled)
+{
+    m_releaseCpuData = enabled;
+    if (m_objectDescriptor.isNull())
+        return;
+
+    if (enabled && m_shaderCompiler)
+        m_objectDescriptor->releaseCpuData();
+    else if (!enabled)
+        m_objectDescriptor->reloadCpuData();
+}
+
+MemoryUsage GLWidget::objectMemoryUsage() const
+{
+    if (m_objectDescriptor.isNull())
+        return MemoryUsage();
+
+    return MemoryUsage(m_objectDescriptor->getCpuMemoryUsage(),
+                       m_vertexBufferSize + m_lodBufferSize + m_textureSize);
+}
+
+bool GLWidget::showGallery(const QStringList &imagePaths, const ShaderConfig &shaderConfig)
+{
+    if (!m_gallery)
+        return false;
+
+    m_galleryImagePaths = imagePaths;
+    m_galleryVisible = true;
+
+    makeCurrent();
+    m_gallery->setShaderConfig(shaderConfig);
+    m_gallery->setImages(imagePaths);
+    doneCurrent();
+
+    update();
+    return true;
+}
+
+void GLWidget::setGalleryShaderConfig(const ShaderConfig &shaderConfig)
+{
+    if (!m_gallery)
+        return;
+
+    m_gallery->setShaderConfig(shaderConfig);
+    if (m_galleryVisible)
+        update();
+}
+
+void GLWidget::hideGallery()
+{
+    if (!m_galleryVisible)
+        return;
+
+    // The thumbnails are released, a folder is opened again from scratch
+    m_galleryVisible = false;
+    m_galleryImagePaths.clear();
+    makeCurrent();
+    m_gallery->setImages(QStringList());
+    doneCurrent();
+
+    update();
+}
+
+void GLWidget::paintGallery()
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    m_gallery->paint(QSize(viewport[2], viewport[3]));
+
+    QStringList statistics;
+    statistics.append(m_gallery->statistics());
+    statistics.append(QString("Memory: %0").arg(totalMemoryUsage().toString()));
+    Q_EMIT(frameStatisticsChanged(statistics.join(", ")));
+}
+
+MemoryUsage GLWidget::totalMemoryUsage() const
+{
+    MemoryUsage usage = objectMemoryUsage();
+    if (m_renderTargetPool)
+        usage += MemoryUsage(0, m_renderTargetPool->residentBytes());
+    if (m_filterPipeline)
+        usage += MemoryUsage(0, m_filterPipeline->colorLutBytes());
+    if (m_gallery)
+        usage += MemoryUsage(0, m_gallery->memoryBytes());
+    return usage;
+}
+
 void GLWidget::resetShaderAnimTimer(int msec)
 {
     m_shaderAnimProgress = 0;
     m_shaderAnimTimer->start(msec);
 }
 
+void GLWidget::precompileShaderProgram(const QString &vertexCode, const QString &fragmentCode)
+{
+    if (!m_shaderCompiler)
+        return;
+
+    m_shaderCompiler->compileInBackground(vertexCode, fragmentCode);
+}
+
 void GLWidget::setShaderAnimProgress(int progress)
 {
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("progress", progress);
+        SessionRecorder::record("shaderAnimProgress", arguments);
+    }
+
     m_shaderAnimTimer->stop();
     m_shaderAnimProgress = progress;
     update();
@@ -219,57 +1133,328 @@ void GLWidget::setShaderAnimProgress(int progress)
 
 void GLWidget::updateVertexBuffer()
 {
+    TRACE_ZONE("GLWidget::updateVertexBuffer");
+    // The mapped cache file is handed to the driver without a copy, it is
+    // quantized already.
+    if (const MeshCache *meshCache = m_objectDescriptor->getMeshCache()) {
+        m_positionBoundsMin = meshCache->getBoundsMin();
+        m_positionBoundsMax = meshCache->getBoundsMax();
+        m_positionDecodeMatrix = VertexQuantizer::positionDecodeMatrix(m_positionBoundsMin, m_positionBoundsMax);
+
+        uploadBufferData(&m_vertexBuffer, meshCache->getVertexData(), meshCache->getVertexDataSize());
+        uploadBufferData(&m_indexBuffer, meshCache->getIndexData(), meshCache->getIndexDataSize());
+
+        m_vertexBufferSize = meshCache->getVertexDataSize() + meshCache->getIndexDataSize();
+        m_interleavedVertexStride = meshCache->getVertexStride();
+        m_interleavedColors = meshCache->hasColors();
+        return;
+    }
+
+    m_interleavedVertexStride = 0;
+    m_interleavedColors = false;
+
     int offset = 0;
     int vertexCount = m_objectDescriptor->getVertexCount();
+    const QVector<QVector3D> vertices = m_objectDescriptor->getVertices();
 
-    m_vertexBuffer.bind();
-    int elementCount = 3; // vertex
+    VertexQuantizer::computeBounds(vertices.constData(), vertexCount, &m_positionBoundsMin, &m_positionBoundsMax);
+    m_positionDecodeMatrix = VertexQuantizer::positionDecodeMatrix(m_positionBoundsMin, m_positionBoundsMax);
+
+    int vertexSize = VertexQuantizer::PositionStride;
     if (m_objectDescriptor->hasColors())
-        elementCount += 3;
+        vertexSize += VertexQuantizer::ColorStride;
     if (m_objectDescriptor->hasTexture())
-        elementCount += 2;
-    m_vertexBuffer.allocate(vertexCount * elementCount * sizeof(GLfloat));
+        vertexSize += VertexQuantizer::TextureCoordinateStride;
 
-    m_vertexBuffer.write(offset, m_objectDescriptor->getVertices().constData(), vertexCount * 3 * sizeof(GLfloat));
-    offset += vertexCount * 3 * sizeof(GLfloat);
+    // Every attribute is a block of its own, the blocks stay 4 byte aligned
+    QByteArray data(vertexCount * vertexSize, Qt::Uninitialized);
+
+    VertexQuantizer::encodePositions(vertices.constData(), vertexCount, m_positionBoundsMin, m_positionBoundsMax,
+                                     reinterpret_cast<GLshort *>(data.data() + offset));
+    offset += vertexCount * VertexQuantizer::PositionStride;
 
     if (m_objectDescriptor->hasColors()) {
-        m_vertexBuffer.write(offset, m_objectDescriptor->getColors().constData(), vertexCount * 3 * sizeof(GLfloat));
-        offset += vertexCount * 3 * sizeof(GLfloat);
+        VertexQuantizer::encodeColors(m_objectDescriptor->getColors().constData(), vertexCount,
+                                      reinterpret_cast<GLubyte *>(data.data() + offset));
+        offset += vertexCount * VertexQuantizer::ColorStride;
     }
 
     if (m_objectDescriptor->hasTexture()) {
-        m_vertexBuffer.write(offset, m_objectDescriptor->getTextureCoordinates().constData(), vertexCount * 2 * sizeof(GLfloat));
-        offset += vertexCount * 2 * sizeof(GLfloat);
+        VertexQuantizer::encodeTextureCoordinates(m_objectDescriptor->getTextureCoordinates().constData(), vertexCount,
+                                                  reinterpret_cast<GLushort *>(data.data() + offset));
+        offset += vertexCount * VertexQuantizer::TextureCoordinateStride;
     }
 
+    m_vertexBuffer.bind();
+    m_vertexBuffer.allocate(data.constData(), data.size());
     m_vertexBuffer.release();
+
+    m_indexBuffer.bind();
+    m_indexBuffer.allocate(m_objectDescriptor->getIndices().constData(), m_objectDescriptor->getIndexCount() * sizeof(GLuint));
+    m_indexBuffer.release();
+
+    m_vertexBufferSize = data.size() + m_objectDescriptor->getIndexCount() * sizeof(GLuint);
+}
+
+void GLWidget::uploadBufferData(QOpenGLBuffer *buffer, const void *data, qint64 size)
+{
+    buffer->bind();
+
+    // QOpenGLBuffer::allocate() takes an int, the blocks of a large mesh
+    // cache are allocated directly and filled in chunks
+    if (size <= INT_MAX) {
+        buffer->allocate(data, int(size));
+    } else {
+        const GLenum target = buffer->type();
+        const char *bytes = static_cast<const char *>(data);
+        glBufferData(target, GLsizeiptr(size), 0, buffer->usagePattern());
+        for (qint64 offset = 0; offset < size; offset += BufferUploadChunk)
+            glBufferSubData(target, GLintptr(offset), GLsizeiptr(qMin(qint64(BufferUploadChunk), size - offset)), bytes + offset);
+    }
+
+    if (glGetError() == GL_OUT_OF_MEMORY)
+        qWarning() << "Unable to allocate a buffer of" << size << "bytes";
+
+    buffer->release();
 }
 
 void GLWidget::updateTexture()
 {
+    TRACE_ZONE("GLWidget::updateTexture");
     m_texture.destroy();
+    m_textureSize = 0;
+
+    if (const RawImage *rawImage = m_objectDescriptor->getRawTextureImage()) {
+        uploadRawTexture(rawImage);
+        return;
+    }
 
-    if (!m_objectDescriptor->hasTextureImage())
+    if (!m_objectDescriptor->getTextureImage())
         return;
 
-    m_texture.setData(m_objectDescriptor->getTextureImage()->mirrored());
+    // RGBA8 with a full mipmap chain, which adds a third to the base level
+    const QImage *image = m_objectDescriptor->getTextureImage();
+    m_texture.setData(image->mirrored());
+    m_textureSize = qint64(image->width()) * image->height() * 4 * 4 / 3;
+}
+
+void GLWidget::uploadRawTexture(const RawImage *rawImage)
+{
+    TRACE_ZONE("GLWidget::uploadRawTexture");
+    const QSize size = rawImage->getSize();
+    const int bytesPerLine = rawImage->getBytesPerLine();
+
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (size.width() > maxTextureSize || size.height() > maxTextureSize) {
+        qWarning() << "Raw image of" << size << "exceeds the maximum texture size" << maxTextureSize;
+        return;
+    }
+
+    m_texture.setFormat(QOpenGLTexture::RGBA8_UNorm);
+    m_texture.setSize(size.width(), size.height());
+    m_texture.setMipLevels(m_texture.maximumMipLevels());
+    m_texture.allocateStorage();
+    m_texture.bind();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (rawImage->isBigEndian() && Q_BYTE_ORDER == Q_LITTLE_ENDIAN)
+        glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_TRUE);
+
+    // The rows are copied from the mapped file into the mapped buffer in
+    // reverse, the texture starts at the bottom row. Nothing is decoded and
+    // the driver transfers the buffer without another copy. Images over
+    // 2 GiB do not fit QOpenGLBuffer::allocate() and are uploaded by rows.
+    QOpenGLBuffer pixelBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+    pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    uchar *pixels = 0;
+    if (rawImage->getDataSize() <= INT_MAX && pixelBuffer.create()) {
+        pixelBuffer.bind();
+        pixelBuffer.allocate(int(rawImage->getDataSize()));
+        pixels = static_cast<uchar *>(pixelBuffer.map(QOpenGLBuffer::WriteOnly));
+    }
+
+    if (pixels) {
+        for (int y = 0; y < size.height(); ++y)
+            memcpy(pixels + qint64(size.height() - 1 - y) * bytesPerLine, rawImage->getScanLine(y), bytesPerLine);
+        pixelBuffer.unmap();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(),
+                        rawImage->getPixelFormat(), rawImage->getPixelType(), 0);
+        pixelBuffer.release();
+    } else {
+        // Without a mappable buffer every row is uploaded from the file
+        if (pixelBuffer.isCreated())
+            pixelBuffer.release();
+        for (int y = 0; y < size.height(); ++y) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, size.height() - 1 - y, size.width(), 1,
+                            rawImage->getPixelFormat(), rawImage->getPixelType(), rawImage->getScanLine(y));
+        }
+    }
+    pixelBuffer.destroy();
+
+    glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    m_texture.generateMipMaps();
+    m_texture.release();
+
+    // RGBA8 with a full mipmap chain, which adds a third to the base level
+    m_textureSize = qint64(size.width()) * size.height() * 4 * 4 / 3;
 }
 
 void GLWidget::updateShaderProgram()
 {
-    m_shaderProgram.removeAllShaders();
-    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, m_objectDescriptor->getVertexShaderCode());
-    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, m_objectDescriptor->getFragmentShaderCode());
-    m_shaderProgram.link();
+    TRACE_ZONE("GLWidget::updateShaderProgram");
+    const QString vertexCode = m_objectDescriptor->getVertexShaderCode();
+    const QString fragmentCode = m_objectDescriptor->getFragmentShaderCode();
+    const QByteArray key = ShaderCompiler::programKey(vertexCode, fragmentCode);
+
+    QOpenGLShaderProgram *program = m_shaderCompiler->cachedProgram(key);
+
+    // The vertex stage defines the attributes, so if it has not changed the
+    // previous program can keep drawing the new vertex buffer until the new
+    // program is linked in the background.
+    if (!program && m_backgroundCompilationEnabled && m_shaderCompiler->isThreaded() && m_shaderProgram && vertexCode == m_shaderProgramVertexCode) {
+        m_pendingShaderProgramKey = key;
+        m_shaderCompiler->compileInBackground(vertexCode, fragmentCode);
+        return;
+    }
+
+    if (!program)
+        program = m_shaderCompiler->program(vertexCode, fragmentCode);
+
+    m_pendingShaderProgramKey.clear();
+
+    // A program which failed to link keeps the previous one drawing, as
+    // long as it reads the same attributes
+    if (!program->isLinked() && m_shaderProgram && vertexCode == m_shaderProgramVertexCode)
+        return;
+
+    m_shaderProgram = program;
+    m_shaderProgramVertexCode = vertexCode;
+}
+
+void GLWidget::updateFilterPipeline()
+{
+    TRACE_ZONE("GLWidget::updateFilterPipeline");
+    qDeleteAll(m_comparisonDescriptors);
+    m_comparisonDescriptors.clear();
+    m_comparisonPrograms.clear();
+
+    // Only images are filtered, and a single view is drawn as usual
+    if (!m_objectDescriptor->hasTextureImage() || m_comparisonConfigs.count() < 2) {
+        m_filterPipeline->setPasses(m_objectDescriptor.data());
+        return;
+    }
+
+    QVector<const GLObjectDescriptor *> views;
+    for (int i = 0; i < m_comparisonConfigs.count(); ++i) {
+        GLObjectDescriptor *descriptor = new GLObjectDescriptor;
+        descriptor->buildShaderCode(m_objectDescriptor->getObjectId(), &m_comparisonConfigs[i]);
+        m_comparisonDescriptors.append(descriptor);
+        m_comparisonPrograms.append(m_shaderCompiler->program(descriptor->getVertexShaderCode(), descriptor->getFragmentShaderCode()));
+        views.append(descriptor);
+    }
+
+    m_filterPipeline->setViews(views);
 }
 
 void GLWidget::shaderAnimTimerTimeout()
 {
     m_shaderAnimProgress += 5;
+    if (SessionRecorder::isRecording()) {
+        QJsonObject arguments;
+        arguments.insert("progress", m_shaderAnimProgress);
+        SessionRecorder::record("shaderAnimProgress", arguments);
+    }
     Q_EMIT(timerChangedShaderAnimProgress(m_shaderAnimProgress));
     update();
 
     if (m_shaderAnimProgress >= 100)
         m_shaderAnimTimer->stop();
 }
+
+void GLWidget::refinePreview()
+{
+    m_previewRefineTimer->stop();
+    m_interacting = false;
+    update();
+}
+
+void GLWidget::onShaderProgramReady(const QByteArray &key)
+{
+    if (key != m_pendingShaderProgramKey)
+        return;
+
+    m_pendingShaderProgramKey.clear();
+    m_shaderProgram = m_shaderCompiler->cachedProgram(key);
+    update();
+}
+
+void GLWidget::onShaderProgramFailed(const QByteArray &key)
+{
+    if (key != m_pendingShaderProgramKey)
+        return;
+
+    // Linked again on the widget's context, which also caches a failed
+    // link so it is not queued over and over
+    makeCurrent();
+    m_pendingShaderProgramKey.clear();
+    QOpenGLShaderProgram *program = m_shaderCompiler->program(m_objectDescriptor->getVertexShaderCode(),
+                                                              m_objectDescriptor->getFragmentShaderCode());
+    if (program->isLinked())
+        m_shaderProgram = program;
+    doneCurrent();
+
+    update();
+}
+
+void GLWidget::onLodChainReady()
+{
+    if (!m_shaderCompiler)
+        return;
+
+    makeCurrent();
+    uploadLodChain();
+    doneCurrent();
+
+    update();
+}
+
+void GLWidget::uploadLodChain()
+{
+    TRACE_ZONE("GLWidget::uploadLodChain");
+    clearLodChain();
+    if (!m_lodWatcher->isFinished() || m_lodWatcher->isCanceled() || !m_lodWatcher->future().resultCount())
+        return;
+
+    m_lodChain = m_lodWatcher->result();
+
+    QVector<GLshort> vertices;
+    QVector<GLuint> indices;
+    for (int i = 0; i < m_lodChain.count(); ++i) {
+        // Indices of a level are rebased onto the shared vertex buffer
+        const MeshLodLevel &level = m_lodChain.at(i);
+        const GLuint baseVertex = vertices.count() / 4;
+        m_lodIndexOffsets.append(indices.count());
+        m_lodIndexCounts.append(level.indices.count());
+        vertices.resize(vertices.count() + 4 * level.vertices.count());
+        VertexQuantizer::encodePositions(level.vertices.constData(), level.vertices.count(),
+                                         m_positionBoundsMin, m_positionBoundsMax,
+                                         vertices.data() + 4 * baseVertex);
+        foreach (GLuint index, level.indices)
+            indices.append(baseVertex + index);
+
+        // Only the cell sizes are needed to select a level from now on
+        m_lodChain[i].vertices.clear();
+        m_lodChain[i].indices.clear();
+    }
+
+    m_lodVertexBuffer.bind();
+    m_lodVertexBuffer.allocate(vertices.constData(), vertices.count() * sizeof(GLshort));
+    m_lodVertexBuffer.release();
+    m_lodIndexBuffer.bind();
+    m_lodIndexBuffer.allocate(indices.constData(), indices.count() * sizeof(GLuint));
+    m_lodIndexBuffer.release();
+    m_lodBufferSize = vertices.count() * sizeof(GLshort) + indices.count() * sizeof(GLuint);
+}
@@ -1,6 +1,7 @@
 #ifndef GLWIDGET_H
 #define GLWIDGET_H
 
+#include <QElapsedTimer>
 #include <QMatrix4x4>
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
@@ -8,10 +9,22 @@
 #include <QOpenGLTexture>
 #include <QOpenGLWidget>
 #include <QScopedPointer>
+#include <QStringList>
+#include <QVector>
 
+#include "memoryusage.h"
+#include "meshlod.h"
+#include "shaderbuilder.h"
+
+class FilterPipeline;
 class GLObjectDescriptor;
+class RawImage;
+class RenderTargetPool;
+class ShaderCompiler;
+class ThumbnailGallery;
 class QMouseEvent;
 class QTimer;
+template <typename T> class QFutureWatcher;
 class QWheelEvent;
 
 namespace Axis {
@@ -27,19 +40,89 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
     Q_OBJECT
 
 public:
+    // Multisampling draws the scene into a multisampled target which is
+    // resolved into the widget, FXAA filters a single sampled one in one
+    // pass. The modes beyond the samples of the context fall back to fewer.
+    enum AntialiasingMode {
+        NoAntialiasing = 0,
+        Msaa2x,
+        Msaa4x,
+        Msaa8x,
+        Fxaa
+    };
+
     GLWidget(QWidget *parent = 0);
     ~GLWidget();
 
     void rotate(int angle, Axis::Axis axis);
     void updateObjectDescriptor(GLObjectDescriptor *objectDescriptor);
+
+    // Draws the image once per config side by side, the views share the
+    // source texture and the filter passes their plans have in common
+    void updateObjectDescriptor(GLObjectDescriptor *objectDescriptor, const QVector<ShaderConfig> &comparisonConfigs);
+    int comparisonViewCount() const { return m_comparisonPrograms.count(); }
     GLObjectDescriptor *getObjectDescriptor() const;
     void resetShaderAnimTimer(int msec);
+    void precompileShaderProgram(const QString &vertexCode, const QString &fragmentCode);
+    bool supportsReducedPrecision() const { return m_reducedPrecisionSupported; }
+
+    // The descriptor's CPU copies are freed once they are uploaded, and
+    // loaded again from the source if the context has to be recreated
+    void setReleaseCpuData(bool enabled);
+    bool isReleaseCpuDataEnabled() const { return m_releaseCpuData; }
+
+    // Object covers the descriptor and its buffers and texture, total also
+    // the intermediate render targets and the color lookup tables
+    MemoryUsage objectMemoryUsage() const;
+    MemoryUsage totalMemoryUsage() const;
+
+    // Shows the images as thumbnails instead of the object, false if the
+    // context has no texture arrays or instancing
+    bool showGallery(const QStringList &imagePaths, const ShaderConfig &shaderConfig);
+    void setGalleryShaderConfig(const ShaderConfig &shaderConfig);
+    bool isGalleryVisible() const { return m_galleryVisible; }
+
+    // Programs which are not cached yet are linked before the next frame
+    // instead of drawing with the previous program until they are ready
+    void setBackgroundCompilationEnabled(bool enabled) { m_backgroundCompilationEnabled = enabled; }
+
+    // Draws a frame and waits for it to finish, also if the widget is hidden.
+    // Returns the time it took in milliseconds.
+    double renderFrame();
+
+    // Renders the scene at any size in tiles through an offscreen target,
+    // every tile is written to the binary PPM file as soon as it is read
+    // back. The size is not limited by the widget or the viewport.
+    bool exportImage(const QString &path, const QSize &size, int tileSize = 2048);
+
+    void notifyInteraction();
+    void setPreviewTargetFrameTime(double msec);
+    void setPreviewRefineDelay(int msec);
+
+    // Filters only this part of the image, in pixels with the origin at the
+    // bottom left. It is dragged with the right mouse button, a right click
+    // clears it. An empty region filters the whole image.
+    void setRegionOfInterest(const QRect &region);
+    QRect regionOfInterest() const { return m_regionOfInterest; }
+
+    void setAntialiasingMode(AntialiasingMode mode);
+    AntialiasingMode antialiasingMode() const { return m_antialiasingMode; }
+    AntialiasingMode effectiveAntialiasingMode() const;
+    static QString antialiasingModeName(AntialiasingMode mode);
+
+    // The scene target of the effective mode at the size of the widget, the
+    // preview and the MSAA resolve draw into smaller or transient ones
+    MemoryUsage antialiasingMemoryUsage() const;
 
 public Q_SLOTS:
     void setShaderAnimProgress(int progress);
+    void setAdaptivePreviewEnabled(bool enabled);
+    void hideGallery();
 
 signals:
     void timerChangedShaderAnimProgress(int progress);
+    void frameStatisticsChanged(const QString &statistics);
+    void thumbnailActivated(const QString &imagePath);
 
 protected:
     void initializeGL();
@@ -48,19 +131,89 @@ protected:
 
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
+    void mouseDoubleClickEvent(QMouseEvent *event);
 
 private:
+    QMatrix4x4 modelMatrix() const;
+    QMatrix4x4 viewMatrix() const;
+    void drawObject(const QMatrix4x4 &mvpMatrix, QOpenGLShaderProgram *program, GLuint filterResultTexture, int view = 0);
+    void drawComparisonViews(const QSize &targetSize, const QRect &tile);
+    bool imagePosition(const QPoint &position, QPointF *pixel) const;
+    static QMatrix4x4 regionProjection(const QMatrix4x4 &projection, const QSize &size, const QRect &region);
+    void adaptPreviewScale(double frameTime);
+    static int antialiasingSamples(AntialiasingMode mode);
+    void drawFxaa(GLuint texture, const QSize &size);
+    void paintGallery();
+    void selectLodLevel(int viewportHeight);
+    void clearLodChain();
+    void uploadLodChain();
+
     void updateVertexBuffer();
+    void uploadBufferData(QOpenGLBuffer *buffer, const void *data, qint64 size);
     void updateTexture();
+    void uploadRawTexture(const RawImage *rawImage);
     void updateShaderProgram();
+    void updateFilterPipeline();
 
     QMatrix4x4 m_projection;
-    QOpenGLShaderProgram m_shaderProgram;
+
+    // Pixels drawn around every exported tile and cut off again, so clipped
+    // lines do not lose their end pixels at the seams
+    static const int ExportTileOverlap = 4;
+    // Buffers over 2 GiB are filled in blocks of this size
+    static const int BufferUploadChunk = 256 * 1024 * 1024;
+
+    QScopedPointer<ShaderCompiler> m_shaderCompiler;
+    QScopedPointer<RenderTargetPool> m_renderTargetPool;
+    QScopedPointer<FilterPipeline> m_filterPipeline;
+    bool m_reducedPrecisionSupported;
+    QOpenGLShaderProgram *m_shaderProgram;
+    QString m_shaderProgramVertexCode;
+    QByteArray m_pendingShaderProgramKey;
+    bool m_backgroundCompilationEnabled;
 
     QOpenGLBuffer m_vertexBuffer;
+    QOpenGLBuffer m_indexBuffer;
+    qint64 m_vertexBufferSize;
+
+    // Layout of the uploaded vertices, the mesh cache it came from may have
+    // been released. A stride of 0 means one block per attribute.
+    int m_interleavedVertexStride;
+    bool m_interleavedColors;
+
+    // Vertex positions are quantized relative to these bounds
+    QVector3D m_positionBoundsMin;
+    QVector3D m_positionBoundsMax;
+    QMatrix4x4 m_positionDecodeMatrix;
+
+    // Simplified levels of the mesh, all of them in one vertex and one index
+    // buffer. Level 0 is the descriptor's own geometry.
+    QFutureWatcher<MeshLodChain> *m_lodWatcher;
+    MeshLodChain m_lodChain;
+    QOpenGLBuffer m_lodVertexBuffer;
+    QOpenGLBuffer m_lodIndexBuffer;
+    QVector<int> m_lodIndexOffsets;
+    QVector<int> m_lodIndexCounts;
+    qint64 m_lodBufferSize;
+    int m_lodLevel;
+    int m_trianglesDrawn;
+
+    // Shader code and programs of the side by side views, the descriptors
+    // have no geometry of their own
+    QVector<ShaderConfig> m_comparisonConfigs;
+    QVector<GLObjectDescriptor *> m_comparisonDescriptors;
+    QVector<QOpenGLShaderProgram *> m_comparisonPrograms;
+
+    QScopedPointer<ThumbnailGallery> m_gallery;
+    QStringList m_galleryImagePaths;
+    bool m_galleryVisible;
+
     QOpenGLTexture m_texture;
+    qint64 m_textureSize;
     QScopedPointer<GLObjectDescriptor> m_objectDescriptor;
+    bool m_releaseCpuData;
 
     double m_distance;
     int m_yRotateAngle;
@@ -70,11 +223,37 @@ private:
 
     QPoint m_lastMousePosition;
 
+    QRect m_regionOfInterest;
+    QPointF m_regionAnchor;
+    bool m_selectingRegion;
+
     QTimer *m_shaderAnimTimer;
     int m_shaderAnimProgress;
 
+    // Drives the displacement of the vertex shader, the geometry itself is
+    // never touched again after the upload. Sampled once per frame or
+    // export, so every view and tile is displaced at the same time.
+    QElapsedTimer m_vertexShaderClock;
+    GLfloat m_vertexShaderTime;
+
+    QTimer *m_previewRefineTimer;
+    bool m_adaptivePreviewEnabled;
+    bool m_previewSupported;
+    bool m_interacting;
+    double m_previewScale;
+    double m_previewTargetFrameTime;
+    int m_previewRefineDelay;
+
+    AntialiasingMode m_antialiasingMode;
+    int m_maxSamples;
+    QOpenGLShaderProgram *m_fxaaProgram;
+
 private Q_SLOTS:
     void shaderAnimTimerTimeout();
+    void refinePreview();
+    void onShaderProgramReady(const QByteArray &key);
+    void onShaderProgramFailed(const QByteArray &key);
+    void onLodChainReady();
 };
 
 #endif // GLWIDGET_H
@@ -1,10 +1,84 @@
 #include "mainwindow.h"
+#include "filterbenchmark.h"
+#include "sessionrecorder.h"
+#include "tracer.h"
+
 #include <QApplication>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QTextStream>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption benchmarkFiltersOption("benchmark-filters", "Benchmark the image filters at 4K and exit.");
+    parser.addOption(benchmarkFiltersOption);
+    QCommandLineOption traceOption("trace", "Write a Chrome trace of the session to <file>, also enabled by QT_SHADER_DEMO_TRACE.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption recordOption("record", "Record the interactions of the session to <file>.", "file");
+    parser.addOption(recordOption);
+    QCommandLineOption replayOption("replay", "Replay a recorded session, print the frame timings and exit.", "file");
+    parser.addOption(replayOption);
+    QCommandLineOption timingsOption("timings", "Write the frame timings of the replay to <file> instead of stdout.", "file");
+    parser.addOption(timingsOption);
+    QCommandLineOption headlessOption("headless", "Replay without showing the window, use with -platform offscreen.");
+    parser.addOption(headlessOption);
+    QCommandLineOption antialiasingOption("antialiasing", "Anti-aliasing mode: off, msaa2, msaa4, msaa8 or fxaa.", "mode", "off");
+    parser.addOption(antialiasingOption);
+    parser.process(a);
+
+    const QStringList antialiasingModes = QStringList() << "off" << "msaa2" << "msaa4" << "msaa8" << "fxaa";
+    const int antialiasingMode = antialiasingModes.indexOf(parser.value(antialiasingOption).toLower());
+    if (antialiasingMode < 0) {
+        QTextStream(stderr) << "Unknown anti-aliasing mode: " << parser.value(antialiasingOption) << "\n";
+        return 1;
+    }
+
+    if (parser.isSet(traceOption))
+        Tracer::enable(parser.value(traceOption));
+    else if (qEnvironmentVariableIsSet("QT_SHADER_DEMO_TRACE"))
+        Tracer::enable(QString::fromLocal8Bit(qgetenv("QT_SHADER_DEMO_TRACE")));
+
+    if (parser.isSet(benchmarkFiltersOption)) {
+        FilterBenchmark benchmark;
+        return benchmark.run();
+    }
+
+    // A replay is not recorded again
+    if (parser.isSet(recordOption) && !parser.isSet(replayOption) && !SessionRecorder::start(parser.value(recordOption)))
+        return 1;
+
     MainWindow w;
+    w.setAntialiasingMode(static_cast<GLWidget::AntialiasingMode>(antialiasingMode));
+
+    if (parser.isSet(replayOption)) {
+        SessionReplayer replayer(&w);
+        if (!replayer.load(parser.value(replayOption)))
+            return 1;
+
+        if (!parser.isSet(headlessOption)) {
+            w.show();
+            a.processEvents();
+        }
+
+        replayer.run();
+        if (!replayer.writeTimings(parser.value(timingsOption)))
+            return 1;
+
+        // The mode is resolved against the samples of the context, which
+        // exists once the replay has drawn
+        const GLWidget *glWidget = w.glWidget();
+        QTextStream(stderr) << replayer.summary() << "\n"
+                            << QString("Anti-aliasing: %0, %1 MB")
+                               .arg(GLWidget::antialiasingModeName(glWidget->effectiveAntialiasingMode()))
+                               .arg(glWidget->antialiasingMemoryUsage().gpuBytes / (1024.0 * 1024.0), 0, 'f', 1)
+                            << "\n";
+        return 0;
+    }
+
     w.show();
 
     return a.exec();
@@ -3,11 +3,21 @@
 
 #include "glwidget.h"
 #include "globjectdescriptor.h"
+#include "sessionrecorder.h"
 #include "shadercodedialog.h"
+#include "tracer.h"
 
+#include <QApplication>
+#include <QDir>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QLabel>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QRegExp>
+#include <QShortcut>
+#include <QSignalBlocker>
+#include <QStatusBar>
 #include <QTextEdit>
 #include <QTimer>
 
@@ -17,16 +27,27 @@ MainWindow::MainWindow(QWidget *parent)
     , m_rotateSliderTimer(new QTimer(this))
     , m_rotateAnimTimer(new QTimer(this))
     , m_grabbedRotateSlider(0)
+    , m_frameStatisticsLabel(new QLabel(this))
     , m_textureImagePath(":/images/qt-logo.png")
 {
     m_ui->setupUi(this);
 
     m_ui->loadImageButton->setVisible(false);
+    m_ui->loadFolderButton->setVisible(false);
+    m_ui->loadMeshButton->setVisible(false);
     m_ui->triangleCountSB->setVisible(false);
+    m_ui->tessellationSB->setVisible(false);
+    m_ui->statusBar->addPermanentWidget(m_frameStatisticsLabel);
 
     initObjectListWidget();
     initShaderConfig();
     createConnections();
+
+    QShortcut *writeTraceShortcut = new QShortcut(QKeySequence("Ctrl+Shift+T"), this);
+    connect(writeTraceShortcut, SIGNAL(activated()), this, SLOT(writeTrace()));
+
+    QShortcut *exportImageShortcut = new QShortcut(QKeySequence("Ctrl+Shift+E"), this);
+    connect(exportImageShortcut, SIGNAL(activated()), this, SLOT(exportImage()));
 }
 
 MainWindow::~MainWindow()
@@ -34,6 +55,122 @@ MainWindow::~MainWindow()
     delete m_ui;
 }
 
+GLWidget *MainWindow::glWidget() const
+{
+    return m_ui->openGLWidget;
+}
+
+QJsonObject MainWindow::sessionState() const
+{
+    QJsonObject state;
+    QListWidgetItem *item = m_ui->objectListWidget->currentItem();
+    state.insert("object", item ? item->data(Qt::UserRole).toInt() : int(GLObjectDescriptor::None));
+    state.insert("imagePath", m_textureImagePath);
+    state.insert("meshPath", m_meshPath);
+    state.insert("triangleCount", m_ui->triangleCountSB->value());
+    state.insert("tessellation", m_ui->tessellationSB->value());
+    state.insert("cullFace", m_ui->cullFaceCB->isChecked());
+    state.insert("polygonLine", m_ui->polygonLineCB->isChecked());
+    state.insert("animation", m_ui->shaderAnimCB->isChecked());
+    state.insert("vertexShader", m_ui->vertexShaderComboBox->currentIndex());
+    state.insert("gray", m_ui->shaderGrayCB->isChecked());
+    state.insert("invert", m_ui->shaderInvertCB->isChecked());
+    state.insert("threshold", m_ui->shaderThresholdCB->isChecked());
+    state.insert("shader", int(getSelectedIPShader()));
+    state.insert("compareShaders", m_ui->compareShadersCB->isChecked());
+    state.insert("reducedPrecision", m_ui->shaderReducedPrecisionCB->isChecked());
+    state.insert("filterChain", m_ui->filterChainEdit->text());
+    return state;
+}
+
+void MainWindow::restoreSessionState(const QJsonObject &state)
+{
+    QListWidgetItem *item = 0;
+    for (int i = 0; i < m_ui->objectListWidget->count(); ++i) {
+        if (m_ui->objectListWidget->item(i)->data(Qt::UserRole).toInt() == state.value("object").toInt())
+            item = m_ui->objectListWidget->item(i);
+    }
+
+    if (!item)
+        return;
+
+    // The widgets are set without their signals, the descriptor is rebuilt once
+    const QSignalBlocker listBlocker(m_ui->objectListWidget);
+    const QSignalBlocker triangleCountBlocker(m_ui->triangleCountSB);
+    const QSignalBlocker tessellationBlocker(m_ui->tessellationSB);
+    const QSignalBlocker cullFaceBlocker(m_ui->cullFaceCB);
+    const QSignalBlocker polygonLineBlocker(m_ui->polygonLineCB);
+    const QSignalBlocker animationBlocker(m_ui->shaderAnimCB);
+    const QSignalBlocker vertexShaderBlocker(m_ui->vertexShaderComboBox);
+    const QSignalBlocker grayBlocker(m_ui->shaderGrayCB);
+    const QSignalBlocker invertBlocker(m_ui->shaderInvertCB);
+    const QSignalBlocker thresholdBlocker(m_ui->shaderThresholdCB);
+    const QSignalBlocker shaderBlocker(m_ui->shaderButtonGroup);
+    const QSignalBlocker compareBlocker(m_ui->compareShadersCB);
+    const QSignalBlocker reducedPrecisionBlocker(m_ui->shaderReducedPrecisionCB);
+    const QSignalBlocker filterChainBlocker(m_ui->filterChainEdit);
+
+    m_ui->objectListWidget->setCurrentItem(item);
+    m_textureImagePath = state.value("imagePath").toString();
+    m_meshPath = state.value("meshPath").toString();
+    m_ui->triangleCountSB->setValue(state.value("triangleCount").toInt());
+    m_ui->tessellationSB->setValue(state.value("tessellation").toInt());
+    m_ui->cullFaceCB->setChecked(state.value("cullFace").toBool());
+    m_ui->polygonLineCB->setChecked(state.value("polygonLine").toBool());
+    m_ui->shaderAnimCB->setChecked(state.value("animation").toBool());
+    m_ui->vertexShaderComboBox->setCurrentIndex(state.value("vertexShader").toInt());
+    m_ui->shaderGrayCB->setChecked(state.value("gray").toBool());
+    m_ui->shaderInvertCB->setChecked(state.value("invert").toBool());
+    m_ui->shaderThresholdCB->setChecked(state.value("threshold").toBool());
+    m_ui->compareShadersCB->setChecked(state.value("compareShaders").toBool());
+    m_ui->shaderReducedPrecisionCB->setChecked(state.value("reducedPrecision").toBool());
+    m_ui->filterChainEdit->setText(state.value("filterChain").toString());
+
+    switch (state.value("shader").toInt()) {
+    case ShaderConfig::Gauss:
+        m_ui->gaussBlurRB->setChecked(true);
+        break;
+    case ShaderConfig::Sobel:
+        m_ui->sobelRB->setChecked(true);
+        break;
+    case ShaderConfig::SobelGauss:
+        m_ui->sobelGaussRB->setChecked(true);
+        break;
+    case ShaderConfig::Canny:
+        m_ui->cannyRB->setChecked(true);
+        break;
+    case ShaderConfig::LargeBlur:
+        m_ui->largeBlurRB->setChecked(true);
+        break;
+    case ShaderConfig::AdaptiveThreshold:
+        m_ui->adaptiveThresholdRB->setChecked(true);
+        break;
+    case ShaderConfig::Median:
+        m_ui->medianRB->setChecked(true);
+        break;
+    case ShaderConfig::Bilateral:
+        m_ui->bilateralRB->setChecked(true);
+        break;
+    case ShaderConfig::None:
+    default:
+        m_ui->noneShaderRB->setChecked(true);
+        break;
+    }
+
+    m_shaderConfig.vertexShader = static_cast<ShaderConfig::VertexShader>(m_ui->vertexShaderComboBox->currentIndex());
+    m_shaderConfig.gray = m_ui->shaderGrayCB->isChecked();
+    m_shaderConfig.invert = m_ui->shaderInvertCB->isChecked();
+    m_shaderConfig.threshold = m_ui->shaderThresholdCB->isChecked();
+
+    updateObjectDescriptor(item);
+}
+
+void MainWindow::setAntialiasingMode(GLWidget::AntialiasingMode mode)
+{
+    m_ui->antialiasingComboBox->setCurrentIndex(mode);
+    m_ui->openGLWidget->setAntialiasingMode(mode);
+}
+
 void MainWindow::onRotateSliderReleased()
 {
     QSlider *slider = dynamic_cast<QSlider *>(sender());
@@ -54,6 +191,7 @@ void MainWindow::rotateObject()
 
     if (timerId == m_rotateSliderTimer->timerId()) {
         Axis::Axis axis = (m_grabbedRotateSlider->orientation() == Qt::Vertical) ? Axis::X : Axis::Y;
+        m_ui->openGLWidget->notifyInteraction();
         m_ui->openGLWidget->rotate(m_grabbedRotateSlider->sliderPosition(), axis);
         return;
     }
@@ -77,6 +215,7 @@ void MainWindow::setAnimationSpeed(int speed)
 
 void MainWindow::updateObjectDescriptor(QListWidgetItem *item)
 {
+    TRACE_ZONE("MainWindow::updateObjectDescriptor");
     GLObjectDescriptor *objectDescriptor;
 
     if (!item)
@@ -85,7 +224,10 @@ void MainWindow::updateObjectDescriptor(QListWidgetItem *item)
     switch(item->data(Qt::UserRole).toInt()) {
     case GLObjectDescriptor::ConeObject:
         m_ui->loadImageButton->setVisible(false);
+        m_ui->loadFolderButton->setVisible(false);
+        m_ui->loadMeshButton->setVisible(false);
         m_ui->triangleCountSB->setVisible(true);
+        m_ui->tessellationSB->setVisible(false);
         m_ui->shaderAnimCB->setEnabled(false);
         m_shaderConfig.animEnabled = false;
         m_ui->noneShaderRB->setEnabled(false);
@@ -93,12 +235,23 @@ void MainWindow::updateObjectDescriptor(QListWidgetItem *item)
         m_ui->sobelRB->setEnabled(false);
         m_ui->sobelGaussRB->setEnabled(false);
         m_ui->cannyRB->setEnabled(false);
+        m_ui->largeBlurRB->setEnabled(false);
+        m_ui->adaptiveThresholdRB->setEnabled(false);
+        m_ui->medianRB->setEnabled(false);
+        m_ui->bilateralRB->setEnabled(false);
+        m_ui->compareShadersCB->setEnabled(false);
+        m_ui->filterChainEdit->setEnabled(false);
+        m_ui->shaderReducedPrecisionCB->setEnabled(false);
         m_shaderConfig.imageProcessShader = ShaderConfig::None;
+        m_shaderConfig.filterGraph.clear();
         objectDescriptor = GLObjectDescriptor::createConeDescriptor(&m_shaderConfig, m_ui->triangleCountSB->value());
         break;
     case GLObjectDescriptor::CubeObject:
         m_ui->loadImageButton->setVisible(false);
+        m_ui->loadFolderButton->setVisible(false);
+        m_ui->loadMeshButton->setVisible(false);
         m_ui->triangleCountSB->setVisible(false);
+        m_ui->tessellationSB->setVisible(false);
         m_ui->shaderAnimCB->setEnabled(false);
         m_shaderConfig.animEnabled = false;
         m_ui->noneShaderRB->setEnabled(false);
@@ -106,23 +259,99 @@ void MainWindow::updateObjectDescriptor(QListWidgetItem *item)
         m_ui->sobelRB->setEnabled(false);
         m_ui->sobelGaussRB->setEnabled(false);
         m_ui->cannyRB->setEnabled(false);
+        m_ui->largeBlurRB->setEnabled(false);
+        m_ui->adaptiveThresholdRB->setEnabled(false);
+        m_ui->medianRB->setEnabled(false);
+        m_ui->bilateralRB->setEnabled(false);
+        m_ui->compareShadersCB->setEnabled(false);
+        m_ui->filterChainEdit->setEnabled(false);
+        m_ui->shaderReducedPrecisionCB->setEnabled(false);
         m_shaderConfig.imageProcessShader = ShaderConfig::None;
+        m_shaderConfig.filterGraph.clear();
         objectDescriptor = GLObjectDescriptor::createCubeDescriptor(&m_shaderConfig);
         break;
     case GLObjectDescriptor::ImageObject: {
         m_ui->loadImageButton->setVisible(true);
+        m_ui->loadFolderButton->setVisible(true);
+        m_ui->loadMeshButton->setVisible(false);
         m_ui->triangleCountSB->setVisible(false);
+        m_ui->tessellationSB->setVisible(false);
         m_ui->shaderAnimCB->setEnabled(true);
         m_ui->noneShaderRB->setEnabled(true);
         m_ui->gaussBlurRB->setEnabled(true);
         m_ui->sobelRB->setEnabled(true);
         m_ui->sobelGaussRB->setEnabled(true);
         m_ui->cannyRB->setEnabled(true);
+        m_ui->largeBlurRB->setEnabled(true);
+        m_ui->adaptiveThresholdRB->setEnabled(true);
+        m_ui->medianRB->setEnabled(true);
+        m_ui->bilateralRB->setEnabled(true);
+        m_ui->compareShadersCB->setEnabled(true);
+        m_ui->filterChainEdit->setEnabled(true);
+        m_ui->shaderReducedPrecisionCB->setEnabled(m_ui->openGLWidget->supportsReducedPrecision());
         m_shaderConfig.imageProcessShader = getSelectedIPShader();
+        m_shaderConfig.filterGraph = getFilterChain();
+        m_shaderConfig.reducedPrecision = m_ui->shaderReducedPrecisionCB->isEnabled() && m_ui->shaderReducedPrecisionCB->isChecked();
         m_shaderConfig.animEnabled = m_ui->shaderAnimCB->isChecked();
         objectDescriptor = GLObjectDescriptor::createImageDescriptor(&m_shaderConfig, m_textureImagePath);
         break;
     }
+    case GLObjectDescriptor::MeshObject:
+        m_ui->loadImageButton->setVisible(false);
+        m_ui->loadFolderButton->setVisible(false);
+        m_ui->loadMeshButton->setVisible(true);
+        m_ui->triangleCountSB->setVisible(false);
+        m_ui->tessellationSB->setVisible(false);
+        m_ui->shaderAnimCB->setEnabled(false);
+        m_shaderConfig.animEnabled = false;
+        m_ui->noneShaderRB->setEnabled(false);
+        m_ui->gaussBlurRB->setEnabled(false);
+        m_ui->sobelRB->setEnabled(false);
+        m_ui->sobelGaussRB->setEnabled(false);
+        m_ui->cannyRB->setEnabled(false);
+        m_ui->largeBlurRB->setEnabled(false);
+        m_ui->adaptiveThresholdRB->setEnabled(false);
+        m_ui->medianRB->setEnabled(false);
+        m_ui->bilateralRB->setEnabled(false);
+        m_ui->compareShadersCB->setEnabled(false);
+        m_ui->filterChainEdit->setEnabled(false);
+        m_ui->shaderReducedPrecisionCB->setEnabled(false);
+        m_shaderConfig.imageProcessShader = ShaderConfig::None;
+        m_shaderConfig.filterGraph.clear();
+        objectDescriptor = 0;
+        if (m_meshPath.isEmpty())
+            statusBar()->showMessage("Load a mesh to display");
+        else if (!(objectDescriptor = GLObjectDescriptor::createMeshDescriptor(&m_shaderConfig, m_meshPath)))
+            statusBar()->showMessage(QString("Unable to load mesh: %0").arg(m_meshPath));
+        break;
+    case GLObjectDescriptor::SphereObject:
+    case GLObjectDescriptor::TorusObject:
+    case GLObjectDescriptor::GridObject:
+        m_ui->loadImageButton->setVisible(false);
+        m_ui->loadFolderButton->setVisible(false);
+        m_ui->loadMeshButton->setVisible(false);
+        m_ui->triangleCountSB->setVisible(false);
+        m_ui->tessellationSB->setVisible(true);
+        m_ui->shaderAnimCB->setEnabled(false);
+        m_shaderConfig.animEnabled = false;
+        m_ui->noneShaderRB->setEnabled(false);
+        m_ui->gaussBlurRB->setEnabled(false);
+        m_ui->sobelRB->setEnabled(false);
+        m_ui->sobelGaussRB->setEnabled(false);
+        m_ui->cannyRB->setEnabled(false);
+        m_ui->largeBlurRB->setEnabled(false);
+        m_ui->adaptiveThresholdRB->setEnabled(false);
+        m_ui->medianRB->setEnabled(false);
+        m_ui->bilateralRB->setEnabled(false);
+        m_ui->compareShadersCB->setEnabled(false);
+        m_ui->filterChainEdit->setEnabled(false);
+        m_ui->shaderReducedPrecisionCB->setEnabled(false);
+        m_shaderConfig.imageProcessShader = ShaderConfig::None;
+        m_shaderConfig.filterGraph.clear();
+        objectDescriptor = GLObjectDescriptor::createProceduralDescriptor(&m_shaderConfig,
+                                                                          static_cast<GLObjectDescriptor::GLObjectId>(item->data(Qt::UserRole).toInt()),
+                                                                          m_ui->tessellationSB->value());
+        break;
     case GLObjectDescriptor::None:
     default:
         objectDescriptor = 0;
@@ -132,26 +361,119 @@ void MainWindow::updateObjectDescriptor(QListWidgetItem *item)
     if (objectDescriptor) {
         objectDescriptor->setCullFace(m_ui->cullFaceCB->isChecked());
         objectDescriptor->setPolygonLineMode(m_ui->polygonLineCB->isChecked());
+        if (objectDescriptor->hasTextureImage())
+            statusBar()->showMessage(objectDescriptor->getFilterPlan().summary());
+        else if (!objectDescriptor->getLoadStatistics().isEmpty())
+            statusBar()->showMessage(objectDescriptor->getLoadStatistics());
     }
 
-    m_ui->openGLWidget->updateObjectDescriptor(objectDescriptor);
+    QVector<ShaderConfig> comparisonConfigs;
+    if (objectDescriptor && objectDescriptor->getObjectId() == GLObjectDescriptor::ImageObject)
+        comparisonConfigs = getComparisonConfigs();
+
+    m_ui->openGLWidget->updateObjectDescriptor(objectDescriptor, comparisonConfigs);
+    m_ui->openGLWidget->setGalleryShaderConfig(m_shaderConfig);
 
     m_ui->shaderAnimationSlider->setEnabled(m_shaderConfig.animEnabled);
     if (m_shaderConfig.animEnabled)
         m_ui->openGLWidget->resetShaderAnimTimer(50);
+
+    if (objectDescriptor)
+        precompileShaderVariants(item->data(Qt::UserRole).toInt());
+
+    if (SessionRecorder::isRecording())
+        SessionRecorder::record("state", sessionState());
 }
 
 void MainWindow::showImageBrowser()
 {
     QFileDialog dialog(this);
     dialog.setFileMode(QFileDialog::ExistingFile);
-    dialog.setNameFilter("Images (*.bmp *.jpg *.png)");
+    dialog.setNameFilter("Images (*.bmp *.jpg *.png);;Raw images (*.pgm *.ppm *.pnm *.raw)");
     if (dialog.exec()) {
         m_textureImagePath = dialog.selectedFiles().first();
         updateObjectDescriptor();
     }
 }
 
+void MainWindow::showFolderBrowser()
+{
+    const QString folder = QFileDialog::getExistingDirectory(this, "Open Folder");
+    if (folder.isEmpty())
+        return;
+
+    QStringList imagePaths;
+    const QStringList nameFilters = QStringList() << "*.bmp" << "*.jpg" << "*.jpeg" << "*.png";
+    foreach (const QFileInfo &file, QDir(folder).entryInfoList(nameFilters, QDir::Files, QDir::Name))
+        imagePaths.append(file.absoluteFilePath());
+
+    if (imagePaths.isEmpty())
+        statusBar()->showMessage(QString("No images in %0").arg(folder));
+    else if (!m_ui->openGLWidget->showGallery(imagePaths, m_shaderConfig))
+        statusBar()->showMessage("The gallery needs OpenGL 3.3 with texture arrays");
+}
+
+void MainWindow::openImage(const QString &imagePath)
+{
+    m_ui->openGLWidget->hideGallery();
+    m_textureImagePath = imagePath;
+    updateObjectDescriptor();
+}
+
+void MainWindow::showMeshBrowser()
+{
+    QFileDialog dialog(this);
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    dialog.setNameFilter("Meshes (*.obj *.ply *.stl)");
+    if (dialog.exec()) {
+        m_meshPath = dialog.selectedFiles().first();
+        updateObjectDescriptor();
+    }
+}
+
+void MainWindow::writeTrace()
+{
+    if (!Tracer::isEnabled()) {
+        statusBar()->showMessage("Tracing is disabled, start with --trace <file>");
+        return;
+    }
+
+    if (Tracer::write())
+        statusBar()->showMessage(QString("Trace written to %0").arg(Tracer::outputPath()));
+    else
+        statusBar()->showMessage(QString("Unable to write trace to %0").arg(Tracer::outputPath()));
+}
+
+void MainWindow::exportImage()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Export Image", QString(), "Portable Pixmap (*.ppm)");
+    if (path.isEmpty())
+        return;
+
+    const QSize defaultSize = m_ui->openGLWidget->size() * 8;
+    bool ok;
+    const QString sizeText = QInputDialog::getText(this, "Export Image", "Size in pixels:", QLineEdit::Normal,
+                                                   QString("%0x%1").arg(defaultSize.width()).arg(defaultSize.height()), &ok);
+    if (!ok)
+        return;
+
+    QRegExp sizeRegExp("\\s*(\\d+)\\s*x\\s*(\\d+)\\s*");
+    if (!sizeRegExp.exactMatch(sizeText)) {
+        statusBar()->showMessage(QString("Invalid export size: %0").arg(sizeText));
+        return;
+    }
+
+    const QSize size(sizeRegExp.cap(1).toInt(), sizeRegExp.cap(2).toInt());
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool exported = m_ui->openGLWidget->exportImage(path, size);
+    QApplication::restoreOverrideCursor();
+
+    if (exported)
+        statusBar()->showMessage(QString("Exported %0x%1 to %2").arg(size.width()).arg(size.height()).arg(path));
+    else
+        statusBar()->showMessage(QString("Unable to export to %0").arg(path));
+}
+
 void MainWindow::showShaderCode()
 {
     GLObjectDescriptor *objectDescriptor = m_ui->openGLWidget->getObjectDescriptor();
@@ -165,8 +487,17 @@ void MainWindow::showShaderCode()
             code = objectDescriptor->getVertexShaderCode();
     } else {
         dialog.setWindowTitle("Fragment CODE");
-        if (objectDescriptor)
-            code = objectDescriptor->getFragmentShaderCode();
+        if (objectDescriptor) {
+            // Offscreen filter passes precede the object's own shader
+            for (int pass = 0; pass < objectDescriptor->getFilterPassCount(); ++pass) {
+                code.append(QString("// Filter pass %0\n").arg(pass + 1));
+                code.append(objectDescriptor->getFilterPassFragmentShaderCode(pass));
+                code.append("\n\n");
+            }
+            if (!code.isEmpty())
+                code.append("// Object\n");
+            code.append(objectDescriptor->getFragmentShaderCode());
+        }
     }
 
     dialog.setContent(code);
@@ -177,6 +508,8 @@ void MainWindow::updateShaderConfig()
 {
     if (sender() == m_ui->shaderAnimCB) {
         m_shaderConfig.animEnabled = m_ui->shaderAnimCB->isChecked();
+    } else if (sender() == m_ui->vertexShaderComboBox) {
+        m_shaderConfig.vertexShader = static_cast<ShaderConfig::VertexShader>(m_ui->vertexShaderComboBox->currentIndex());
     } else if (sender() == m_ui->shaderGrayCB) {
         m_shaderConfig.gray = m_ui->shaderGrayCB->isChecked();
     } else if (sender() == m_ui->shaderInvertCB) {
@@ -185,11 +518,20 @@ void MainWindow::updateShaderConfig()
         m_shaderConfig.threshold = m_ui->shaderThresholdCB->isChecked();
     } else if(sender() == m_ui->shaderButtonGroup) {
         m_shaderConfig.imageProcessShader = getSelectedIPShader();
+    } else if (sender() == m_ui->shaderReducedPrecisionCB) {
+        m_shaderConfig.reducedPrecision = m_ui->shaderReducedPrecisionCB->isChecked();
+    } else if (sender() == m_ui->filterChainEdit) {
+        m_shaderConfig.filterGraph = getFilterChain();
     }
 
     updateObjectDescriptor();
 }
 
+void MainWindow::updateAntialiasingMode(int index)
+{
+    m_ui->openGLWidget->setAntialiasingMode(static_cast<GLWidget::AntialiasingMode>(index));
+}
+
 void MainWindow::initObjectListWidget()
 {
     QListWidgetItem *coneItem = new QListWidgetItem("Cone", m_ui->objectListWidget);
@@ -201,6 +543,19 @@ void MainWindow::initObjectListWidget()
     QListWidgetItem *imageItem = new QListWidgetItem("Image", m_ui->objectListWidget);
     imageItem->setData(Qt::UserRole, GLObjectDescriptor::ImageObject);
 
+    QListWidgetItem *meshItem = new QListWidgetItem("Mesh", m_ui->objectListWidget);
+    meshItem->setData(Qt::UserRole, GLObjectDescriptor::MeshObject);
+
+    QListWidgetItem *sphereItem = new QListWidgetItem("Sphere", m_ui->objectListWidget);
+    sphereItem->setData(Qt::UserRole, GLObjectDescriptor::SphereObject);
+
+    QListWidgetItem *torusItem = new QListWidgetItem("Torus", m_ui->objectListWidget);
+    torusItem->setData(Qt::UserRole, GLObjectDescriptor::TorusObject);
+
+    QListWidgetItem *gridItem = new QListWidgetItem("Grid", m_ui->objectListWidget);
+    gridItem->setData(Qt::UserRole, GLObjectDescriptor::GridObject);
+
+    connect(m_ui->objectListWidget, SIGNAL(itemClicked(QListWidgetItem*)), m_ui->openGLWidget, SLOT(hideGallery()));
     connect(m_ui->objectListWidget, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(updateObjectDescriptor(QListWidgetItem*)));
 }
 
@@ -211,6 +566,11 @@ void MainWindow::initShaderConfig()
     m_ui->shaderAnimCB->setEnabled(false);
     connect(m_ui->shaderAnimCB, SIGNAL(toggled(bool)), this, SLOT(updateShaderConfig()));
 
+    m_shaderConfig.vertexShader = ShaderConfig::NoVertexShader;
+    m_ui->vertexShaderComboBox->setCurrentIndex(m_shaderConfig.vertexShader);
+    m_ui->vertexShaderComboBox->setEnabled(true);
+    connect(m_ui->vertexShaderComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateShaderConfig()));
+
     m_shaderConfig.gray = false;
     m_ui->shaderGrayCB->setChecked(m_shaderConfig.gray);
     m_ui->shaderGrayCB->setEnabled(true);
@@ -237,7 +597,30 @@ void MainWindow::initShaderConfig()
     m_ui->sobelGaussRB->setEnabled(false);
     m_ui->cannyRB->setChecked(false);
     m_ui->cannyRB->setEnabled(false);
+    m_ui->largeBlurRB->setChecked(false);
+    m_ui->largeBlurRB->setEnabled(false);
+    m_ui->adaptiveThresholdRB->setChecked(false);
+    m_ui->adaptiveThresholdRB->setEnabled(false);
+    m_ui->medianRB->setChecked(false);
+    m_ui->medianRB->setEnabled(false);
+    m_ui->bilateralRB->setChecked(false);
+    m_ui->bilateralRB->setEnabled(false);
     connect(m_ui->shaderButtonGroup, SIGNAL(buttonToggled(QAbstractButton*,bool)), this, SLOT(updateShaderConfig()));
+
+    m_ui->compareShadersCB->setChecked(false);
+    m_ui->compareShadersCB->setEnabled(false);
+    connect(m_ui->compareShadersCB, SIGNAL(toggled(bool)), this, SLOT(updateShaderConfig()));
+
+    m_shaderConfig.reducedPrecision = false;
+    m_ui->shaderReducedPrecisionCB->setChecked(m_shaderConfig.reducedPrecision);
+    m_ui->shaderReducedPrecisionCB->setEnabled(false);
+    connect(m_ui->shaderReducedPrecisionCB, SIGNAL(toggled(bool)), this, SLOT(updateShaderConfig()));
+
+    m_shaderConfig.comparisonView = false;
+
+    m_shaderConfig.filterGraph.clear();
+    m_ui->filterChainEdit->setEnabled(false);
+    connect(m_ui->filterChainEdit, SIGNAL(editingFinished()), this, SLOT(updateShaderConfig()));
 }
 
 void MainWindow::createConnections()
@@ -254,15 +637,67 @@ void MainWindow::createConnections()
     connect(m_ui->objectAnimationSlider, SIGNAL(valueChanged(int)), this, SLOT(setAnimationSpeed(int)));
 
     connect(m_ui->loadImageButton, SIGNAL(pressed()), this, SLOT(showImageBrowser()));
+    connect(m_ui->loadFolderButton, SIGNAL(pressed()), this, SLOT(showFolderBrowser()));
+    connect(m_ui->loadMeshButton, SIGNAL(pressed()), this, SLOT(showMeshBrowser()));
+    connect(m_ui->openGLWidget, SIGNAL(thumbnailActivated(QString)), this, SLOT(openImage(QString)));
     connect(m_ui->showVertexCodeButton, SIGNAL(pressed()), this, SLOT(showShaderCode()));
     connect(m_ui->showFragmentCodeButton, SIGNAL(pressed()), this, SLOT(showShaderCode()));
 
     connect(m_ui->openGLWidget, SIGNAL(timerChangedShaderAnimProgress(int)), m_ui->shaderAnimationSlider, SLOT(setValue(int)));
+    connect(m_ui->openGLWidget, SIGNAL(frameStatisticsChanged(QString)), m_frameStatisticsLabel, SLOT(setText(QString)));
     connect(m_ui->shaderAnimationSlider, SIGNAL(sliderMoved(int)), m_ui->openGLWidget, SLOT(setShaderAnimProgress(int)));
 
+    connect(m_ui->adaptivePreviewCB, SIGNAL(toggled(bool)), m_ui->openGLWidget, SLOT(setAdaptivePreviewEnabled(bool)));
+    connect(m_ui->antialiasingComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateAntialiasingMode(int)));
+
     connect(m_ui->cullFaceCB, SIGNAL(toggled(bool)), this, SLOT(updateObjectDescriptor()));
     connect(m_ui->polygonLineCB, SIGNAL(toggled(bool)), this, SLOT(updateObjectDescriptor()));
     connect(m_ui->triangleCountSB, SIGNAL(valueChanged(int)), this, SLOT(updateObjectDescriptor()));
+    connect(m_ui->tessellationSB, SIGNAL(valueChanged(int)), this, SLOT(updateObjectDescriptor()));
+}
+
+void MainWindow::precompileShaderVariants(int objectId)
+{
+    // Every shader config which is one click away from the current one
+    QList<ShaderConfig> variants;
+    ShaderConfig variant = m_shaderConfig;
+
+    variant.gray = !m_shaderConfig.gray;
+    variants.append(variant);
+    variant = m_shaderConfig;
+    variant.invert = !m_shaderConfig.invert;
+    variants.append(variant);
+    variant = m_shaderConfig;
+    variant.threshold = !m_shaderConfig.threshold;
+    variants.append(variant);
+
+    if (objectId == GLObjectDescriptor::ImageObject) {
+        variant = m_shaderConfig;
+        variant.animEnabled = !m_shaderConfig.animEnabled;
+        variants.append(variant);
+
+        if (m_ui->openGLWidget->supportsReducedPrecision()) {
+            variant = m_shaderConfig;
+            variant.reducedPrecision = !m_shaderConfig.reducedPrecision;
+            variants.append(variant);
+        }
+
+        for (int shader = ShaderConfig::None; shader <= ShaderConfig::Bilateral; ++shader) {
+            if (shader == m_shaderConfig.imageProcessShader)
+                continue;
+            variant = m_shaderConfig;
+            variant.imageProcessShader = static_cast<ShaderConfig::IPShader>(shader);
+            variants.append(variant);
+        }
+    }
+
+    for (int i = 0; i < variants.count(); ++i) {
+        GLObjectDescriptor descriptor;
+        descriptor.buildShaderCode(static_cast<GLObjectDescriptor::GLObjectId>(objectId), &variants[i]);
+        m_ui->openGLWidget->precompileShaderProgram(descriptor.getVertexShaderCode(), descriptor.getFragmentShaderCode());
+        for (int pass = 0; pass < descriptor.getFilterPassCount(); ++pass)
+            m_ui->openGLWidget->precompileShaderProgram(descriptor.getFilterPassVertexShaderCode(), descriptor.getFilterPassFragmentShaderCode(pass));
+    }
 }
 
 ShaderConfig::IPShader MainWindow::getSelectedIPShader() const
@@ -278,6 +713,68 @@ ShaderConfig::IPShader MainWindow::getSelectedIPShader() const
         return ShaderConfig::SobelGauss;
     if (selected == m_ui->cannyRB)
         return ShaderConfig::Canny;
+    if (selected == m_ui->largeBlurRB)
+        return ShaderConfig::LargeBlur;
+    if (selected == m_ui->adaptiveThresholdRB)
+        return ShaderConfig::AdaptiveThreshold;
+    if (selected == m_ui->medianRB)
+        return ShaderConfig::Median;
+    if (selected == m_ui->bilateralRB)
+        return ShaderConfig::Bilateral;
 
     return ShaderConfig::None;
 }
+
+FilterGraph MainWindow::getFilterChain() const
+{
+    // Only the first of several chains is drawn outside the comparison
+    const QString chain = m_ui->filterChainEdit->text().section('|', 0, 0);
+
+    bool ok;
+    FilterGraph graph = FilterGraph::fromString(chain, &ok);
+    if (!ok)
+        statusBar()->showMessage(QString("Invalid filter chain: %0").arg(chain));
+
+    return graph;
+}
+
+QVector<ShaderConfig> MainWindow::getComparisonConfigs() const
+{
+    QVector<ShaderConfig> configs;
+
+    // Chains separated by '|' are compared with each other, otherwise every
+    // shader is compared with the color filters of the current config
+    const QStringList chains = m_ui->filterChainEdit->text().split('|');
+    if (chains.count() > 1) {
+        foreach (const QString &chain, chains) {
+            ShaderConfig config = m_shaderConfig;
+            bool ok;
+            config.filterGraph = FilterGraph::fromString(chain, &ok);
+            config.comparisonView = true;
+            if (!ok)
+                statusBar()->showMessage(QString("Invalid filter chain: %0").arg(chain));
+            configs.append(config);
+        }
+    } else if (m_ui->compareShadersCB->isChecked()) {
+        const ShaderConfig::IPShader shaders[] = {
+            ShaderConfig::None,
+            ShaderConfig::Gauss,
+            ShaderConfig::Sobel,
+            ShaderConfig::SobelGauss,
+            ShaderConfig::Canny,
+            ShaderConfig::LargeBlur,
+            ShaderConfig::AdaptiveThreshold,
+            ShaderConfig::Median,
+            ShaderConfig::Bilateral
+        };
+        for (unsigned i = 0; i < sizeof(shaders) / sizeof(shaders[0]); ++i) {
+            ShaderConfig config = m_shaderConfig;
+            config.imageProcessShader = shaders[i];
+            config.filterGraph.clear();
+            config.comparisonView = true;
+            configs.append(config);
+        }
+    }
+
+    return configs;
+}
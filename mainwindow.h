@@ -1,9 +1,12 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QJsonObject>
 #include <QMainWindow>
+#include "glwidget.h"
 #include "shaderbuilder.h"
 
+class QLabel;
 class QListWidgetItem;
 class QSlider;
 class QTimer;
@@ -20,6 +23,17 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    GLWidget *glWidget() const;
+
+    // Selected object, its source and every shader setting, recorded by
+    // SessionRecorder whenever the object descriptor is rebuilt
+    QJsonObject sessionState() const;
+    void restoreSessionState(const QJsonObject &state);
+
+    // Anti-aliasing is a choice of the deployment, it is not part of the
+    // recorded state so a replay can compare the modes
+    void setAntialiasingMode(GLWidget::AntialiasingMode mode);
+
 private slots:
     void onRotateSliderReleased();
     void onRotateSliderMoved();
@@ -27,15 +41,24 @@ private slots:
     void setAnimationSpeed(int speed);
     void updateObjectDescriptor(QListWidgetItem *item = 0);
     void showImageBrowser();
+    void showFolderBrowser();
+    void openImage(const QString &imagePath);
+    void showMeshBrowser();
     void showShaderCode();
+    void writeTrace();
+    void exportImage();
     void updateShaderConfig();
+    void updateAntialiasingMode(int index);
 
 private:
     void initObjectListWidget();
     void initShaderConfig();
     void createConnections();
+    void precompileShaderVariants(int objectId);
 
     ShaderConfig::IPShader getSelectedIPShader() const;
+    FilterGraph getFilterChain() const;
+    QVector<ShaderConfig> getComparisonConfigs() const;
 
     Ui::MainWindow *m_ui;
 
@@ -43,8 +66,10 @@ private:
     QTimer *m_rotateAnimTimer;
 
     QSlider *m_grabbedRotateSlider;
+    QLabel *m_frameStatisticsLabel;
 
     QString m_textureImagePath;
+    QString m_meshPath;
     ShaderConfig m_shaderConfig;
 };
 
@@ -0,0 +1,33 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QString>
+
+// Bytes held in client memory and in GL objects. Mapped files count as CPU
+// memory even though they are backed by the page cache.
+struct MemoryUsage {
+    MemoryUsage(qint64 cpu = 0, qint64 gpu = 0)
+        : cpuBytes(cpu)
+        , gpuBytes(gpu)
+    {
+    }
+
+    MemoryUsage &operator+=(const MemoryUsage &other)
+    {
+        cpuBytes += other.cpuBytes;
+        gpuBytes += other.gpuBytes;
+        return *this;
+    }
+
+    QString toString() const
+    {
+        return QString("CPU %0 MB, GPU %1 MB")
+                .arg(cpuBytes / (1024.0 * 1024.0), 0, 'f', 1)
+                .arg(gpuBytes / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+
+    qint64 cpuBytes;
+    qint64 gpuBytes;
+};
+
+#endif // MEMORYUSAGE_H
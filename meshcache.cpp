@@ -0,0 +1,292 @@
+#include "meshcache.h"
+
+#include <limits.h>
+#include <string.h>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include "vertexquantizer.h"
+
+namespace {
+
+const char Magic[8] = { 'Q', 'S', 'D', 'M', 'E', 'S', 'H', '\0' };
+
+// Checksum blocks have a fixed size, so the result does not depend on the
+// number of threads which hash them.
+const qint64 ChecksumBlockSize = 16 * 1024 * 1024;
+
+// Vertices are interleaved into the file in batches of this size
+const int WriteBatchSize = 64 * 1024;
+
+inline quint64 mix(quint64 hash, quint64 value)
+{
+    hash = (hash ^ value) * Q_UINT64_C(0x100000001b3);
+    return hash ^ (hash >> 29);
+}
+
+quint64 hashBlock(const uchar *data, qint64 size)
+{
+    quint64 hash = mix(Q_UINT64_C(0xcbf29ce484222325), size);
+
+    const qint64 words = size / 8;
+    for (qint64 i = 0; i < words; ++i) {
+        quint64 word;
+        memcpy(&word, data + 8 * i, sizeof(word));
+        hash = mix(hash, word);
+    }
+
+    for (qint64 i = words * 8; i < size; ++i)
+        hash = mix(hash, data[i]);
+
+    return hash;
+}
+
+qint64 alignedOffset(qint64 offset, qint64 alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+QString MeshCache::cachePath(const QString &sourcePath)
+{
+    QFileInfo source(sourcePath);
+    QByteArray key = source.absoluteFilePath().toUtf8();
+    key.append(QByteArray::number(source.size()));
+    key.append(QByteArray::number(source.lastModified().toMSecsSinceEpoch()));
+
+    QDir directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return directory.filePath(QString("meshes/%0.mesh").arg(QString(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex())));
+}
+
+bool MeshCache::write(const QString &path,
+                      const QVector<QVector3D> &vertices,
+                      const QVector<QVector3D> &colors,
+                      const QVector<GLuint> &indices,
+                      const QVector3D &boundsMin,
+                      const QVector3D &boundsMax)
+{
+    const bool withColors = !colors.isEmpty();
+    Q_ASSERT(!withColors || colors.count() == vertices.count());
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.attributes = Position | (withColors ? Color : 0);
+    header.vertexStride = vertexStride(header.attributes);
+    header.indexSize = sizeof(GLuint);
+    header.vertexCount = vertices.count();
+    header.indexCount = indices.count();
+    header.vertexOffset = alignedOffset(sizeof(Header), 64);
+    header.indexOffset = alignedOffset(header.vertexOffset + header.vertexCount * header.vertexStride, 64);
+    for (int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+    }
+    const qint64 fileSize = header.indexOffset + header.indexCount * header.indexSize;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // Written under a temporary name, a partially written cache must never
+    // be found by open().
+    const QString temporaryPath = path + ".tmp";
+    QFile file(temporaryPath);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qWarning() << "Unable to write mesh cache: " << path;
+        return false;
+    }
+
+    bool written = file.resize(fileSize)
+            && file.seek(0)
+            && file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+            && file.seek(header.vertexOffset);
+
+    if (written) {
+        QByteArray batch;
+        QVector<GLshort> positions;
+        QVector<GLubyte> encodedColors;
+        for (int first = 0; first < vertices.count() && written; first += WriteBatchSize) {
+            const int count = qMin(WriteBatchSize, vertices.count() - first);
+            positions.resize(count * 4);
+            VertexQuantizer::encodePositions(vertices.constData() + first, count, boundsMin, boundsMax, positions.data());
+            if (withColors) {
+                encodedColors.resize(count * 4);
+                VertexQuantizer::encodeColors(colors.constData() + first, count, encodedColors.data());
+            }
+
+            // Positions and colors are interleaved in the file
+            batch.resize(count * header.vertexStride);
+            char *output = batch.data();
+            for (int i = 0; i < count; ++i, output += header.vertexStride) {
+                memcpy(output, positions.constData() + 4 * i, VertexQuantizer::PositionStride);
+                if (withColors)
+                    memcpy(output + VertexQuantizer::PositionStride, encodedColors.constData() + 4 * i, VertexQuantizer::ColorStride);
+            }
+            written = file.write(batch) == batch.size();
+        }
+    }
+
+    if (written) {
+        const qint64 size = header.indexCount * header.indexSize;
+        written = file.seek(header.indexOffset)
+                && file.write(reinterpret_cast<const char *>(indices.constData()), size) == size
+                && file.flush();
+    }
+
+    uchar *map = written ? file.map(0, fileSize) : 0;
+    if (map) {
+        header.checksum = checksum(header, map + sizeof(Header), fileSize - sizeof(Header));
+        memcpy(map, &header, sizeof(header));
+        file.unmap(map);
+    }
+    file.close();
+
+    if (!map) {
+        qWarning() << "Unable to write mesh cache: " << path;
+        QFile::remove(temporaryPath);
+        return false;
+    }
+
+    QFile::remove(path);
+    return QFile::rename(temporaryPath, path);
+}
+
+MeshCache *MeshCache::open(const QString &path)
+{
+    if (!QFileInfo(path).isFile())
+        return 0;
+
+    MeshCache *cache = new MeshCache(path);
+    QFile &file = cache->m_file;
+    const qint64 fileSize = file.size();
+
+    if (!file.open(QIODevice::ReadOnly) || fileSize < qint64(sizeof(Header))
+            || !(cache->m_map = file.map(0, fileSize))) {
+        delete cache;
+        return 0;
+    }
+
+    Header &header = cache->m_header;
+    memcpy(&header, cache->m_map, sizeof(header));
+
+    const bool valid = memcmp(header.magic, Magic, sizeof(Magic)) == 0
+            && header.version == Version
+            && (header.attributes & Position)
+            && header.vertexStride == quint32(vertexStride(header.attributes))
+            && header.indexSize == sizeof(GLuint)
+            && header.vertexCount <= quint64(INT_MAX)
+            && header.indexCount <= quint64(INT_MAX)
+            && header.vertexOffset >= sizeof(Header)
+            && header.vertexOffset + header.vertexCount * header.vertexStride <= quint64(fileSize)
+            && header.indexOffset + header.indexCount * header.indexSize <= quint64(fileSize);
+
+    if (!valid || checksum(header, cache->m_map + sizeof(Header), fileSize - sizeof(Header)) != header.checksum) {
+        qWarning() << "Discarding invalid mesh cache: " << path;
+        delete cache;
+        return 0;
+    }
+
+    return cache;
+}
+
+MeshCache::MeshCache(const QString &path)
+    : m_file(path)
+    , m_map(0)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+MeshCache::~MeshCache()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+int MeshCache::vertexStride(quint32 attributes)
+{
+    return VertexQuantizer::PositionStride + ((attributes & Color) ? VertexQuantizer::ColorStride : 0);
+}
+
+quint64 MeshCache::checksum(const Header &header, const uchar *data, qint64 size)
+{
+    Header unsummed = header;
+    unsummed.checksum = 0;
+
+    struct Block {
+        qint64 offset;
+        quint64 hash;
+    };
+
+    QVector<Block> blocks;
+    for (qint64 offset = 0; offset < size; offset += ChecksumBlockSize) {
+        Block block = { offset, 0 };
+        blocks.append(block);
+    }
+
+    // Hashing runs at memory bandwidth only if the blocks are hashed in parallel
+    QtConcurrent::blockingMap(blocks, [data, size](Block &block) {
+        block.hash = hashBlock(data + block.offset, qMin(ChecksumBlockSize, size - block.offset));
+    });
+
+    quint64 hash = hashBlock(reinterpret_cast<const uchar *>(&unsummed), sizeof(unsummed));
+    foreach (const Block &block, blocks)
+        hash = mix(hash, block.hash);
+
+    return hash;
+}
+
+int MeshCache::getVertexCount() const
+{
+    return m_header.vertexCount;
+}
+
+int MeshCache::getIndexCount() const
+{
+    return m_header.indexCount;
+}
+
+int MeshCache::getVertexStride() const
+{
+    return m_header.vertexStride;
+}
+
+bool MeshCache::hasColors() const
+{
+    return m_header.attributes & Color;
+}
+
+const uchar *MeshCache::getVertexData() const
+{
+    return m_map + m_header.vertexOffset;
+}
+
+qint64 MeshCache::getVertexDataSize() const
+{
+    return m_header.vertexCount * m_header.vertexStride;
+}
+
+const uchar *MeshCache::getIndexData() const
+{
+    return m_map + m_header.indexOffset;
+}
+
+qint64 MeshCache::getIndexDataSize() const
+{
+    return m_header.indexCount * m_header.indexSize;
+}
+
+QVector3D MeshCache::getBoundsMin() const
+{
+    return QVector3D(m_header.boundsMin[0], m_header.boundsMin[1], m_header.boundsMin[2]);
+}
+
+QVector3D MeshCache::getBoundsMax() const
+{
+    return QVector3D(m_header.boundsMax[0], m_header.boundsMax[1], m_header.boundsMax[2]);
+}
@@ -0,0 +1,86 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <QFile>
+#include <QOpenGLFunctions>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+// Binary geometry file which is memory mapped and handed to the buffer
+// upload as it is. The file is a header followed by an interleaved vertex
+// block and a GLuint index block. Vertices are a snorm16 position relative
+// to the bounds and optionally an unorm8 color, see VertexQuantizer:
+//
+//   offset 0                   header
+//   header.vertexOffset        vertexCount * vertexStride bytes
+//   header.indexOffset         indexCount * 4 bytes
+//
+// Files with a different version or a checksum mismatch are rejected and
+// rewritten by the caller.
+class MeshCache
+{
+public:
+    enum Attribute {
+        Position = 0x1,
+        Color = 0x2
+    };
+
+    static const quint32 Version = 2;
+
+    // Cache file of a source file, it changes with the size and the
+    // modification time of the source.
+    static QString cachePath(const QString &sourcePath);
+
+    static bool write(const QString &path,
+                      const QVector<QVector3D> &vertices,
+                      const QVector<QVector3D> &colors,
+                      const QVector<GLuint> &indices,
+                      const QVector3D &boundsMin,
+                      const QVector3D &boundsMax);
+
+    // Returns 0 if the file is missing, stale or corrupt
+    static MeshCache *open(const QString &path);
+
+    ~MeshCache();
+
+    int getVertexCount() const;
+    int getIndexCount() const;
+    int getVertexStride() const;
+    bool hasColors() const;
+
+    const uchar *getVertexData() const;
+    qint64 getVertexDataSize() const;
+    const uchar *getIndexData() const;
+    qint64 getIndexDataSize() const;
+
+    QVector3D getBoundsMin() const;
+    QVector3D getBoundsMax() const;
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 attributes;
+        quint32 vertexStride;
+        quint32 indexSize;
+        quint64 vertexCount;
+        quint64 indexCount;
+        quint64 vertexOffset;
+        quint64 indexOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        quint64 checksum;
+    };
+
+    MeshCache(const QString &path);
+
+    static int vertexStride(quint32 attributes);
+    static quint64 checksum(const Header &header, const uchar *data, qint64 size);
+
+    QFile m_file;
+    uchar *m_map;
+    Header m_header;
+};
+
+#endif // MESHCACHE_H
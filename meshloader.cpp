@@ -0,0 +1,920 @@
+#include "meshloader.h"
+
+#include <math.h>
+#include <string.h>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include "tracer.h"
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Below this size a chunk is not worth a task of its own
+const qint64 MinimumChunkSize = 1024 * 1024;
+const int MinimumChunkElements = 64 * 1024;
+
+struct Chunk {
+    Chunk()
+        : begin(0)
+        , end(0)
+        , firstLine(0)
+        , lineCount(0)
+        , vertexCount(0)
+        , indexCount(0)
+        , vertexOffset(0)
+        , indexOffset(0)
+        , valid(true)
+    {
+    }
+
+    const char *begin;
+    const char *end;
+    qint64 firstLine;
+    qint64 lineCount;
+
+    int vertexCount;
+    int indexCount;
+    int vertexOffset;
+    int indexOffset;
+    bool valid;
+
+    QVector3D boundsMin;
+    QVector3D boundsMax;
+};
+
+int maximumChunkCount()
+{
+    return QThread::idealThreadCount() * 4;
+}
+
+// Splits the text into chunks which end after a line break
+QVector<Chunk> splitLines(const char *begin, const char *end)
+{
+    const qint64 size = end - begin;
+    const int count = qBound(qint64(1), size / MinimumChunkSize, qint64(maximumChunkCount()));
+
+    QVector<Chunk> chunks;
+    const char *chunkBegin = begin;
+    for (int i = 1; i <= count && chunkBegin < end; ++i) {
+        const char *chunkEnd = (i == count) ? end : qMax(chunkBegin, begin + size * i / count);
+        const char *newline = static_cast<const char *>(memchr(chunkEnd, '\n', end - chunkEnd));
+        chunkEnd = newline ? newline + 1 : end;
+
+        Chunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.append(chunk);
+        chunkBegin = chunkEnd;
+    }
+
+    return chunks;
+}
+
+// Splits the [0, count) element range, the chunk's vertex offset and count
+// hold the range.
+QVector<Chunk> splitRange(qint64 count)
+{
+    const int chunkCount = qBound(qint64(1), count / MinimumChunkElements, qint64(maximumChunkCount()));
+
+    QVector<Chunk> chunks;
+    for (int i = 0; i < chunkCount; ++i) {
+        Chunk chunk;
+        chunk.vertexOffset = count * i / chunkCount;
+        chunk.vertexCount = count * (i + 1) / chunkCount - chunk.vertexOffset;
+        chunks.append(chunk);
+    }
+
+    return chunks;
+}
+
+bool allValid(const QVector<Chunk> &chunks)
+{
+    foreach (const Chunk &chunk, chunks) {
+        if (!chunk.valid)
+            return false;
+    }
+
+    return true;
+}
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+inline const char *skipToken(const char *p, const char *end)
+{
+    while (p < end && !isSpace(*p))
+        ++p;
+    return p;
+}
+
+inline const char *nextLine(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+int countTokens(const char *p, const char *end)
+{
+    int count = 0;
+    while ((p = skipSpaces(p, end)) < end) {
+        p = skipToken(p, end);
+        ++count;
+    }
+
+    return count;
+}
+
+inline bool startsWithWord(const char *p, const char *end, const char *word)
+{
+    const int length = strlen(word);
+    return end - p > length && memcmp(p, word, length) == 0 && isSpace(p[length]);
+}
+
+// The mapped file is not null terminated, so strtod() can not be used
+const char *parseFloat(const char *p, const char *end, float *value)
+{
+    p = skipSpaces(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10.0 + (*p - '0');
+        hasDigits = true;
+        ++p;
+    }
+
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10.0 + (*p - '0');
+            --exponent;
+            hasDigits = true;
+            ++p;
+        }
+    }
+
+    if (!hasDigits)
+        return 0;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            e = qMin(e * 10 + (*p - '0'), 1000);
+            ++p;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20
+    };
+
+    double result = mantissa;
+    if (exponent >= -20 && exponent < 0)
+        result /= powersOf10[-exponent];
+    else if (exponent >= 0 && exponent <= 20)
+        result *= powersOf10[exponent];
+    else
+        result *= pow(10.0, exponent);
+
+    *value = negative ? -result : result;
+    return p;
+}
+
+const char *parseInt(const char *p, const char *end, qint64 *value)
+{
+    p = skipSpaces(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    if (p >= end || *p < '0' || *p > '9')
+        return 0;
+
+    qint64 result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+
+    *value = negative ? -result : result;
+    return p;
+}
+
+inline float readFloat32(const uchar *p)
+{
+    quint32 bits = qFromLittleEndian<quint32>(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline double readFloat64(const uchar *p)
+{
+    quint64 bits = qFromLittleEndian<quint64>(p);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Assigns every chunk the offset of its vertices and indices in the output
+void computeOffsets(QVector<Chunk> &chunks, int *vertexCount, int *indexCount)
+{
+    qint64 vertices = 0;
+    qint64 indices = 0;
+    for (int i = 0; i < chunks.count(); ++i) {
+        chunks[i].vertexOffset = vertices;
+        chunks[i].indexOffset = indices;
+        vertices += chunks.at(i).vertexCount;
+        indices += chunks.at(i).indexCount;
+    }
+
+    *vertexCount = vertices;
+    *indexCount = indices;
+}
+
+bool loadObj(const char *begin, const char *end, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    QVector<Chunk> chunks = splitLines(begin, end);
+
+    // First pass counts the vertices and the triangulated face indices
+    QtConcurrent::blockingMap(chunks, [](Chunk &chunk) {
+        for (const char *line = chunk.begin; line < chunk.end; ) {
+            const char *next = nextLine(line, chunk.end);
+            const char *p = skipSpaces(line, next);
+            if (startsWithWord(p, next, "v")) {
+                ++chunk.vertexCount;
+            } else if (startsWithWord(p, next, "f")) {
+                const int corners = countTokens(p + 1, next);
+                if (corners >= 3)
+                    chunk.indexCount += 3 * (corners - 2);
+            }
+            line = next;
+        }
+    });
+
+    int vertexCount, indexCount;
+    computeOffsets(chunks, &vertexCount, &indexCount);
+    vertices->resize(vertexCount);
+    indices->resize(indexCount);
+
+    QVector3D *vertexData = vertices->data();
+    GLuint *indexData = indices->data();
+
+    // Second pass writes every chunk's elements to its own range
+    QtConcurrent::blockingMap(chunks, [vertexData, indexData, vertexCount](Chunk &chunk) {
+        QVector3D *vertex = vertexData + chunk.vertexOffset;
+        GLuint *index = indexData + chunk.indexOffset;
+        qint64 definedVertices = chunk.vertexOffset;
+
+        for (const char *line = chunk.begin; line < chunk.end && chunk.valid; ) {
+            const char *next = nextLine(line, chunk.end);
+            const char *p = skipSpaces(line, next);
+
+            if (startsWithWord(p, next, "v")) {
+                float x, y, z;
+                if ((p = parseFloat(p + 1, next, &x)) && (p = parseFloat(p, next, &y)) && (p = parseFloat(p, next, &z)))
+                    *vertex++ = QVector3D(x, y, z);
+                else
+                    chunk.valid = false;
+                ++definedVertices;
+            } else if (startsWithWord(p, next, "f")) {
+                // Polygons are triangulated as fans around their first corner
+                GLuint first = 0;
+                GLuint previous = 0;
+                int corner = 0;
+                p += 1;
+                while ((p = skipSpaces(p, next)) < next) {
+                    qint64 value;
+                    const char *tokenEnd = parseInt(p, next, &value);
+                    if (!tokenEnd) {
+                        chunk.valid = false;
+                        break;
+                    }
+
+                    // Texture coordinate and normal references are skipped
+                    p = skipToken(tokenEnd, next);
+
+                    const qint64 resolved = (value < 0) ? definedVertices + value : value - 1;
+                    if (resolved < 0 || resolved >= vertexCount) {
+                        chunk.valid = false;
+                        break;
+                    }
+
+                    if (corner == 0) {
+                        first = resolved;
+                    } else if (corner >= 2) {
+                        *index++ = first;
+                        *index++ = previous;
+                        *index++ = resolved;
+                    }
+                    previous = resolved;
+                    ++corner;
+                }
+            }
+
+            line = next;
+        }
+    });
+
+    return allValid(chunks);
+}
+
+bool loadStl(const char *begin, const char *end, QVector<QVector3D> *vertices)
+{
+    const qint64 size = end - begin;
+    const uchar *data = reinterpret_cast<const uchar *>(begin);
+
+    // Binary STL has an exact size, ASCII files start with "solid" but so do
+    // some binary ones.
+    if (size >= 84) {
+        const qint64 triangleCount = qFromLittleEndian<quint32>(data + 80);
+        if (84 + 50 * triangleCount == size) {
+            vertices->resize(triangleCount * 3);
+            QVector3D *vertexData = vertices->data();
+
+            QVector<Chunk> chunks = splitRange(triangleCount);
+            QtConcurrent::blockingMap(chunks, [data, vertexData](Chunk &chunk) {
+                for (int t = chunk.vertexOffset; t < chunk.vertexOffset + chunk.vertexCount; ++t) {
+                    // Normal is skipped, it is recomputed from the faces
+                    const uchar *record = data + 84 + 50 * qint64(t) + 12;
+                    for (int k = 0; k < 3; ++k, record += 12)
+                        vertexData[3 * t + k] = QVector3D(readFloat32(record), readFloat32(record + 4), readFloat32(record + 8));
+                }
+            });
+
+            return true;
+        }
+    }
+
+    if (!startsWithWord(skipSpaces(begin, end), end, "solid"))
+        return false;
+
+    QVector<Chunk> chunks = splitLines(begin, end);
+    QtConcurrent::blockingMap(chunks, [](Chunk &chunk) {
+        for (const char *line = chunk.begin; line < chunk.end; ) {
+            const char *next = nextLine(line, chunk.end);
+            if (startsWithWord(skipSpaces(line, next), next, "vertex"))
+                ++chunk.vertexCount;
+            line = next;
+        }
+    });
+
+    int vertexCount, indexCount;
+    computeOffsets(chunks, &vertexCount, &indexCount);
+    if (vertexCount % 3)
+        return false;
+
+    vertices->resize(vertexCount);
+    QVector3D *vertexData = vertices->data();
+
+    QtConcurrent::blockingMap(chunks, [vertexData](Chunk &chunk) {
+        QVector3D *vertex = vertexData + chunk.vertexOffset;
+        for (const char *line = chunk.begin; line < chunk.end && chunk.valid; ) {
+            const char *next = nextLine(line, chunk.end);
+            const char *p = skipSpaces(line, next);
+            if (startsWithWord(p, next, "vertex")) {
+                float x, y, z;
+                if ((p = parseFloat(p + 6, next, &x)) && (p = parseFloat(p, next, &y)) && (p = parseFloat(p, next, &z)))
+                    *vertex++ = QVector3D(x, y, z);
+                else
+                    chunk.valid = false;
+            }
+            line = next;
+        }
+    });
+
+    return allValid(chunks);
+}
+
+struct PlyProperty {
+    enum Type {
+        Invalid,
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+
+    static Type parseType(const QByteArray &name)
+    {
+        if (name == "char" || name == "int8")
+            return Int8;
+        if (name == "uchar" || name == "uint8")
+            return UInt8;
+        if (name == "short" || name == "int16")
+            return Int16;
+        if (name == "ushort" || name == "uint16")
+            return UInt16;
+        if (name == "int" || name == "int32")
+            return Int32;
+        if (name == "uint" || name == "uint32")
+            return UInt32;
+        if (name == "float" || name == "float32")
+            return Float32;
+        if (name == "double" || name == "float64")
+            return Float64;
+        return Invalid;
+    }
+
+    static int size(Type type)
+    {
+        switch (type) {
+        case Int8:
+        case UInt8:
+            return 1;
+        case Int16:
+        case UInt16:
+            return 2;
+        case Int32:
+        case UInt32:
+        case Float32:
+            return 4;
+        case Float64:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    static double read(const uchar *p, Type type)
+    {
+        switch (type) {
+        case Int8:
+            return *reinterpret_cast<const qint8 *>(p);
+        case UInt8:
+            return *p;
+        case Int16:
+            return qFromLittleEndian<qint16>(p);
+        case UInt16:
+            return qFromLittleEndian<quint16>(p);
+        case Int32:
+            return qFromLittleEndian<qint32>(p);
+        case UInt32:
+            return qFromLittleEndian<quint32>(p);
+        case Float32:
+            return readFloat32(p);
+        case Float64:
+            return readFloat64(p);
+        default:
+            return 0.0;
+        }
+    }
+
+    QByteArray name;
+    Type type;
+    bool isList;
+    Type countType;
+};
+
+struct PlyElement {
+    QByteArray name;
+    qint64 count;
+    QList<PlyProperty> properties;
+};
+
+bool loadPly(const char *begin, const char *end, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    enum { Ascii, BinaryLittleEndian } format = Ascii;
+    QList<PlyElement> elements;
+
+    // The header is short, it is parsed sequentially
+    const char *line = begin;
+    bool headerEnded = false;
+    while (line < end && !headerEnded) {
+        const char *next = nextLine(line, end);
+        QList<QByteArray> tokens = QByteArray(line, next - line).simplified().split(' ');
+        line = next;
+
+        if (tokens.first() == "format") {
+            if (tokens.value(1) == "ascii")
+                format = Ascii;
+            else if (tokens.value(1) == "binary_little_endian")
+                format = BinaryLittleEndian;
+            else
+                return false;
+        } else if (tokens.first() == "element" && tokens.count() == 3) {
+            PlyElement element;
+            element.name = tokens.at(1);
+            element.count = tokens.at(2).toLongLong();
+            elements.append(element);
+        } else if (tokens.first() == "property" && !elements.isEmpty()) {
+            PlyProperty property;
+            property.isList = (tokens.value(1) == "list");
+            if (property.isList && tokens.count() == 5) {
+                property.countType = PlyProperty::parseType(tokens.at(2));
+                property.type = PlyProperty::parseType(tokens.at(3));
+                property.name = tokens.at(4);
+            } else if (!property.isList && tokens.count() == 3) {
+                property.countType = PlyProperty::Invalid;
+                property.type = PlyProperty::parseType(tokens.at(1));
+                property.name = tokens.at(2);
+            } else {
+                return false;
+            }
+            elements.last().properties.append(property);
+        } else if (tokens.first() == "end_header") {
+            headerEnded = true;
+        }
+    }
+
+    // Only the common layout is supported: scalar vertex properties followed
+    // by faces with a single index list.
+    if (!headerEnded || elements.isEmpty() || elements.first().name != "vertex")
+        return false;
+
+    const PlyElement &vertexElement = elements.first();
+    const qint64 vertexCount = vertexElement.count;
+    int positionProperty[3] = { -1, -1, -1 };
+    int positionOffset[3] = { 0, 0, 0 };
+    int vertexStride = 0;
+    for (int i = 0; i < vertexElement.properties.count(); ++i) {
+        const PlyProperty &property = vertexElement.properties.at(i);
+        if (property.isList || property.type == PlyProperty::Invalid)
+            return false;
+
+        const int axis = (property.name == "x") ? 0 : (property.name == "y") ? 1 : (property.name == "z") ? 2 : -1;
+        if (axis >= 0) {
+            positionProperty[axis] = i;
+            positionOffset[axis] = vertexStride;
+        }
+        vertexStride += PlyProperty::size(property.type);
+    }
+
+    if (positionProperty[0] < 0 || positionProperty[1] < 0 || positionProperty[2] < 0)
+        return false;
+
+    qint64 faceCount = 0;
+    PlyProperty faceList;
+    if (elements.count() > 1 && elements.at(1).name == "face") {
+        if (elements.at(1).properties.count() != 1 || !elements.at(1).properties.first().isList)
+            return false;
+        faceCount = elements.at(1).count;
+        faceList = elements.at(1).properties.first();
+    }
+
+    if (format == BinaryLittleEndian) {
+        const uchar *vertexData = reinterpret_cast<const uchar *>(line);
+        if (vertexData + vertexCount * vertexStride > reinterpret_cast<const uchar *>(end))
+            return false;
+
+        vertices->resize(vertexCount);
+        QVector3D *output = vertices->data();
+        const PlyProperty::Type types[3] = {
+            vertexElement.properties.at(positionProperty[0]).type,
+            vertexElement.properties.at(positionProperty[1]).type,
+            vertexElement.properties.at(positionProperty[2]).type
+        };
+
+        QVector<Chunk> vertexChunks = splitRange(vertexCount);
+        QtConcurrent::blockingMap(vertexChunks, [&](Chunk &chunk) {
+            for (qint64 v = chunk.vertexOffset; v < chunk.vertexOffset + chunk.vertexCount; ++v) {
+                const uchar *record = vertexData + v * vertexStride;
+                output[v] = QVector3D(PlyProperty::read(record + positionOffset[0], types[0]),
+                                      PlyProperty::read(record + positionOffset[1], types[1]),
+                                      PlyProperty::read(record + positionOffset[2], types[2]));
+            }
+        });
+
+        if (!faceCount)
+            return true;
+
+        const uchar *faceData = vertexData + vertexCount * vertexStride;
+        const int countSize = PlyProperty::size(faceList.countType);
+        const int indexSize = PlyProperty::size(faceList.type);
+        const int triangleStride = countSize + 3 * indexSize;
+
+        // Scans are mostly triangulated, in that case the faces have a fixed
+        // size and can be read in parallel as well.
+        bool triangles = (faceData + faceCount * triangleStride <= reinterpret_cast<const uchar *>(end));
+        QVector<Chunk> faceChunks = splitRange(faceCount);
+        if (triangles) {
+            QtConcurrent::blockingMap(faceChunks, [&](Chunk &chunk) {
+                for (qint64 f = chunk.vertexOffset; f < chunk.vertexOffset + chunk.vertexCount && chunk.valid; ++f) {
+                    if (PlyProperty::read(faceData + f * triangleStride, faceList.countType) != 3)
+                        chunk.valid = false;
+                }
+            });
+            triangles = allValid(faceChunks);
+        }
+
+        if (triangles) {
+            indices->resize(faceCount * 3);
+            GLuint *indexData = indices->data();
+            QtConcurrent::blockingMap(faceChunks, [&](Chunk &chunk) {
+                for (qint64 f = chunk.vertexOffset; f < chunk.vertexOffset + chunk.vertexCount; ++f) {
+                    const uchar *record = faceData + f * triangleStride + countSize;
+                    for (int k = 0; k < 3; ++k) {
+                        const qint64 index = PlyProperty::read(record + k * indexSize, faceList.type);
+                        if (index < 0 || index >= vertexCount)
+                            chunk.valid = false;
+                        indexData[3 * f + k] = index;
+                    }
+                }
+            });
+
+            return allValid(faceChunks);
+        }
+
+        // Mixed polygons, the offset of a face depends on all previous ones
+        indices->clear();
+        const uchar *record = faceData;
+        for (qint64 f = 0; f < faceCount; ++f) {
+            if (record + countSize > reinterpret_cast<const uchar *>(end))
+                return false;
+            const int corners = PlyProperty::read(record, faceList.countType);
+            record += countSize;
+            if (record + corners * indexSize > reinterpret_cast<const uchar *>(end))
+                return false;
+
+            for (int k = 2; k < corners; ++k) {
+                const qint64 triangle[3] = {
+                    qint64(PlyProperty::read(record, faceList.type)),
+                    qint64(PlyProperty::read(record + (k - 1) * indexSize, faceList.type)),
+                    qint64(PlyProperty::read(record + k * indexSize, faceList.type))
+                };
+                for (int i = 0; i < 3; ++i) {
+                    if (triangle[i] < 0 || triangle[i] >= vertexCount)
+                        return false;
+                    indices->append(triangle[i]);
+                }
+            }
+            record += corners * indexSize;
+        }
+
+        return true;
+    }
+
+    // ASCII: one element per line, the first pass finds the line numbers
+    QVector<Chunk> chunks = splitLines(line, end);
+    QtConcurrent::blockingMap(chunks, [](Chunk &chunk) {
+        for (const char *p = chunk.begin; p < chunk.end; p = nextLine(p, chunk.end))
+            ++chunk.lineCount;
+    });
+
+    qint64 lineNumber = 0;
+    for (int i = 0; i < chunks.count(); ++i) {
+        chunks[i].firstLine = lineNumber;
+        lineNumber += chunks.at(i).lineCount;
+    }
+
+    QtConcurrent::blockingMap(chunks, [vertexCount, faceCount](Chunk &chunk) {
+        qint64 lineNumber = chunk.firstLine;
+        for (const char *p = chunk.begin; p < chunk.end; ++lineNumber) {
+            const char *next = nextLine(p, chunk.end);
+            if (lineNumber < vertexCount) {
+                ++chunk.vertexCount;
+            } else if (lineNumber < vertexCount + faceCount) {
+                qint64 corners;
+                if (parseInt(p, next, &corners) && corners >= 3)
+                    chunk.indexCount += 3 * (corners - 2);
+            }
+            p = next;
+        }
+    });
+
+    int parsedVertexCount, indexCount;
+    computeOffsets(chunks, &parsedVertexCount, &indexCount);
+    if (parsedVertexCount != vertexCount)
+        return false;
+
+    vertices->resize(vertexCount);
+    indices->resize(indexCount);
+    QVector3D *vertexData = vertices->data();
+    GLuint *indexData = indices->data();
+    const int propertyCount = vertexElement.properties.count();
+
+    QtConcurrent::blockingMap(chunks, [&](Chunk &chunk) {
+        QVector3D *vertex = vertexData + chunk.vertexOffset;
+        GLuint *index = indexData + chunk.indexOffset;
+        qint64 lineNumber = chunk.firstLine;
+
+        for (const char *p = chunk.begin; p < chunk.end && chunk.valid; ++lineNumber) {
+            const char *next = nextLine(p, chunk.end);
+
+            if (lineNumber < vertexCount) {
+                float values[3] = { 0.0, 0.0, 0.0 };
+                const char *token = p;
+                for (int i = 0; i < propertyCount && token; ++i) {
+                    float value;
+                    token = parseFloat(token, next, &value);
+                    for (int axis = 0; axis < 3; ++axis) {
+                        if (positionProperty[axis] == i)
+                            values[axis] = value;
+                    }
+                }
+                if (!token)
+                    chunk.valid = false;
+                *vertex++ = QVector3D(values[0], values[1], values[2]);
+            } else if (lineNumber < vertexCount + faceCount) {
+                qint64 corners;
+                const char *token = parseInt(p, next, &corners);
+                qint64 first = 0;
+                qint64 previous = 0;
+                for (qint64 k = 0; k < corners && token; ++k) {
+                    qint64 value;
+                    token = parseInt(token, next, &value);
+                    if (!token || value < 0 || value >= vertexCount) {
+                        chunk.valid = false;
+                        break;
+                    }
+
+                    if (k == 0) {
+                        first = value;
+                    } else if (k >= 2) {
+                        *index++ = first;
+                        *index++ = previous;
+                        *index++ = value;
+                    }
+                    previous = value;
+                }
+            }
+
+            p = next;
+        }
+    });
+
+    return allValid(chunks);
+}
+
+void computeBounds(const QVector<QVector3D> &vertices, QVector3D *boundsMin, QVector3D *boundsMax)
+{
+    if (vertices.isEmpty()) {
+        *boundsMin = QVector3D();
+        *boundsMax = QVector3D();
+        return;
+    }
+
+    const QVector3D *vertexData = vertices.constData();
+    QVector<Chunk> chunks = splitRange(vertices.count());
+    QtConcurrent::blockingMap(chunks, [vertexData](Chunk &chunk) {
+        QVector3D minimum = vertexData[chunk.vertexOffset];
+        QVector3D maximum = minimum;
+        for (int v = chunk.vertexOffset + 1; v < chunk.vertexOffset + chunk.vertexCount; ++v) {
+            const QVector3D &vertex = vertexData[v];
+            minimum = QVector3D(qMin(minimum.x(), vertex.x()), qMin(minimum.y(), vertex.y()), qMin(minimum.z(), vertex.z()));
+            maximum = QVector3D(qMax(maximum.x(), vertex.x()), qMax(maximum.y(), vertex.y()), qMax(maximum.z(), vertex.z()));
+        }
+        chunk.boundsMin = minimum;
+        chunk.boundsMax = maximum;
+    });
+
+    *boundsMin = chunks.first().boundsMin;
+    *boundsMax = chunks.first().boundsMax;
+    foreach (const Chunk &chunk, chunks) {
+        *boundsMin = QVector3D(qMin(boundsMin->x(), chunk.boundsMin.x()), qMin(boundsMin->y(), chunk.boundsMin.y()), qMin(boundsMin->z(), chunk.boundsMin.z()));
+        *boundsMax = QVector3D(qMax(boundsMax->x(), chunk.boundsMax.x()), qMax(boundsMax->y(), chunk.boundsMax.y()), qMax(boundsMax->z(), chunk.boundsMax.z()));
+    }
+}
+
+} // namespace
+
+MeshLoader::Statistics::Statistics()
+    : fileSize(0)
+    , parseTime(0)
+    , peakResidentSize(0)
+    , vertexCount(0)
+    , triangleCount(0)
+{
+}
+
+double MeshLoader::Statistics::throughput() const
+{
+    if (!parseTime)
+        return 0.0;
+
+    return (fileSize / (1024.0 * 1024.0)) / (parseTime / 1000.0);
+}
+
+QString MeshLoader::Statistics::summary() const
+{
+    return QString("%0 vertices, %1 triangles, parsed %2 MB in %3 ms (%4 MB/s), peak RSS %5 MB")
+            .arg(vertexCount)
+            .arg(triangleCount)
+            .arg(fileSize / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(parseTime)
+            .arg(throughput(), 0, 'f', 1)
+            .arg(peakResidentSize / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+bool MeshLoader::load(const QString &path,
+                      QVector<QVector3D> *vertices,
+                      QVector<GLuint> *indices,
+                      QVector3D *boundsMin,
+                      QVector3D *boundsMax,
+                      Statistics *statistics)
+{
+    TRACE_ZONE("MeshLoader::load");
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Unable to open mesh: " << path;
+        return false;
+    }
+
+    const qint64 size = file.size();
+    uchar *map = size ? file.map(0, size) : 0;
+    if (!map) {
+        qWarning() << "Unable to map mesh: " << path;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const char *begin = reinterpret_cast<const char *>(map);
+    const char *end = begin + size;
+    const QString suffix = path.section('.', -1).toLower();
+
+    vertices->clear();
+    indices->clear();
+
+    bool loaded = false;
+    if (suffix == "obj")
+        loaded = loadObj(begin, end, vertices, indices);
+    else if (suffix == "ply")
+        loaded = loadPly(begin, end, vertices, indices);
+    else if (suffix == "stl")
+        loaded = loadStl(begin, end, vertices);
+
+    if (loaded)
+        computeBounds(*vertices, boundsMin, boundsMax);
+
+    const qint64 parseTime = timer.elapsed();
+    file.unmap(map);
+
+    if (!loaded) {
+        qWarning() << "Unable to parse mesh: " << path;
+        vertices->clear();
+        indices->clear();
+        return false;
+    }
+
+    if (statistics) {
+        statistics->fileSize = size;
+        statistics->parseTime = parseTime;
+        statistics->peakResidentSize = peakResidentSize();
+        statistics->vertexCount = vertices->count();
+        statistics->triangleCount = (indices->isEmpty() ? vertices->count() : indices->count()) / 3;
+    }
+
+    return true;
+}
+
+qint64 MeshLoader::peakResidentSize()
+{
+#if defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(Q_OS_MAC)
+    return usage.ru_maxrss;
+#else
+    // Linux reports kilobytes
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <QOpenGLFunctions>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+// Loads OBJ, PLY (ASCII and binary little endian) and STL (ASCII and binary)
+// meshes. The file is memory mapped and parsed in parallel chunks directly
+// into pre-sized vertex and index arrays which can be uploaded as they are.
+class MeshLoader
+{
+public:
+    struct Statistics {
+        Statistics();
+
+        double throughput() const;
+        QString summary() const;
+
+        qint64 fileSize;
+        qint64 parseTime;           // msec
+        qint64 peakResidentSize;    // bytes
+        int vertexCount;
+        int triangleCount;
+    };
+
+    // Non-indexed meshes (STL) leave the indices empty
+    static bool load(const QString &path,
+                     QVector<QVector3D> *vertices,
+                     QVector<GLuint> *indices,
+                     QVector3D *boundsMin,
+                     QVector3D *boundsMax,
+                     Statistics *statistics = 0);
+
+    static qint64 peakResidentSize();
+};
+
+#endif // MESHLOADER_H
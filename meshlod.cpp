@@ -0,0 +1,129 @@
+#include "meshlod.h"
+
+#include <algorithm>
+#include <string.h>
+#include <QPair>
+
+namespace {
+
+const int MaximumResolution = 512;
+const int MinimumResolution = 8;
+
+// A level is only kept if it removes enough triangles to be worth a draw
+const double MinimumReduction = 0.7;
+
+// Below this the coarsest level is cheap enough
+const int MinimumLevelTriangleCount = 512;
+
+// Projected cell size in pixels at which the next finer level is needed
+const double PixelError = 1.0;
+const double CoarserMargin = 0.8;
+
+inline QVector3D readPosition(const uchar *positions, int stride, int index)
+{
+    float xyz[3];
+    memcpy(xyz, positions + qint64(index) * stride, sizeof(xyz));
+    return QVector3D(xyz[0], xyz[1], xyz[2]);
+}
+
+} // namespace
+
+MeshLodChain MeshLod::generate(const uchar *positions,
+                               int stride,
+                               int vertexCount,
+                               const GLuint *indices,
+                               int indexCount,
+                               const QVector3D &boundsMin,
+                               const QVector3D &boundsMax)
+{
+    MeshLodChain chain;
+
+    const QVector3D extent = boundsMax - boundsMin;
+    const float maxExtent = qMax(extent.x(), qMax(extent.y(), extent.z()));
+    int triangleCount = (indices ? indexCount : vertexCount) / 3;
+    if (maxExtent <= 0.0f || triangleCount < MinimumTriangleCount)
+        return chain;
+
+    for (int resolution = MaximumResolution; resolution >= MinimumResolution; resolution /= 2) {
+        MeshLodLevel level = cluster(positions, stride, vertexCount, indices, indexCount, boundsMin, maxExtent, resolution);
+        if (level.getTriangleCount() > triangleCount * MinimumReduction)
+            continue;
+
+        chain.append(level);
+        const MeshLodLevel &previous = chain.last();
+        positions = reinterpret_cast<const uchar *>(previous.vertices.constData());
+        stride = sizeof(QVector3D);
+        vertexCount = previous.vertices.count();
+        indices = previous.indices.constData();
+        indexCount = previous.indices.count();
+        triangleCount = previous.getTriangleCount();
+
+        if (triangleCount < MinimumLevelTriangleCount)
+            break;
+    }
+
+    return chain;
+}
+
+int MeshLod::selectLevel(const MeshLodChain &chain, int currentLevel, double pixelsPerUnit)
+{
+    // The mesh is normalized to a longest side of 2 units
+    int level = qBound(0, currentLevel, chain.count());
+
+    while (level < chain.count() && 2.0 * chain.at(level).cellSize * pixelsPerUnit < PixelError * CoarserMargin)
+        ++level;
+
+    while (level > 0 && 2.0 * chain.at(level - 1).cellSize * pixelsPerUnit > PixelError)
+        --level;
+
+    return level;
+}
+
+MeshLodLevel MeshLod::cluster(const uchar *positions,
+                              int stride,
+                              int vertexCount,
+                              const GLuint *indices,
+                              int indexCount,
+                              const QVector3D &boundsMin,
+                              float maxExtent,
+                              int resolution)
+{
+    MeshLodLevel level;
+    level.cellSize = 1.0f / resolution;
+
+    // Sorting the cell keys groups the vertices of a cell without a hash
+    const float scale = resolution / maxExtent;
+    QVector<QPair<quint64, GLuint> > cells(vertexCount);
+    for (int v = 0; v < vertexCount; ++v) {
+        const QVector3D position = (readPosition(positions, stride, v) - boundsMin) * scale;
+        const quint64 x = qBound(0, int(position.x()), resolution - 1);
+        const quint64 y = qBound(0, int(position.y()), resolution - 1);
+        const quint64 z = qBound(0, int(position.z()), resolution - 1);
+        cells[v] = qMakePair((x << 42) | (y << 21) | z, GLuint(v));
+    }
+    std::sort(cells.begin(), cells.end());
+
+    QVector<GLuint> remap(vertexCount);
+    for (int first = 0; first < vertexCount; ) {
+        QVector3D sum;
+        int last = first;
+        for (; last < vertexCount && cells.at(last).first == cells.at(first).first; ++last) {
+            sum += readPosition(positions, stride, cells.at(last).second);
+            remap[cells.at(last).second] = level.vertices.count();
+        }
+        level.vertices.append(sum / (last - first));
+        first = last;
+    }
+
+    const int cornerCount = indices ? indexCount : vertexCount;
+    for (int i = 0; i + 2 < cornerCount; i += 3) {
+        const GLuint a = remap.at(indices ? indices[i] : i);
+        const GLuint b = remap.at(indices ? indices[i + 1] : i + 1);
+        const GLuint c = remap.at(indices ? indices[i + 2] : i + 2);
+        if (a == b || b == c || a == c)
+            continue;
+        level.indices << a << b << c;
+    }
+
+    return level;
+}
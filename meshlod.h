@@ -0,0 +1,58 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <QOpenGLFunctions>
+#include <QVector3D>
+#include <QVector>
+
+struct MeshLodLevel {
+    QVector<QVector3D> vertices;
+    QVector<GLuint> indices;
+
+    // Edge of a clustering cell relative to the longest side of the bounds,
+    // this is the largest error of the level.
+    float cellSize;
+
+    int getTriangleCount() const { return indices.count() / 3; }
+};
+
+// Simplified levels from the finest to the coarsest, the full mesh itself is
+// not part of the chain.
+typedef QVector<MeshLodLevel> MeshLodChain;
+
+// Builds the levels by vertex clustering: the bounds are divided into a grid,
+// the vertices of a cell are merged into their average and the triangles
+// which collapse are dropped. Every level is clustered from the previous one
+// on a grid of half the resolution.
+class MeshLod
+{
+public:
+    static const int MinimumTriangleCount = 50000;
+
+    // Positions are three floats at the stride, indices may be null for
+    // non-indexed meshes.
+    static MeshLodChain generate(const uchar *positions,
+                                 int stride,
+                                 int vertexCount,
+                                 const GLuint *indices,
+                                 int indexCount,
+                                 const QVector3D &boundsMin,
+                                 const QVector3D &boundsMax);
+
+    // Picks the coarsest level whose cells project below the pixel error.
+    // Switching to a coarser level requires a margin, so the level does not
+    // flip back and forth around the threshold. Level 0 is the full mesh.
+    static int selectLevel(const MeshLodChain &chain, int currentLevel, double pixelsPerUnit);
+
+private:
+    static MeshLodLevel cluster(const uchar *positions,
+                                int stride,
+                                int vertexCount,
+                                const GLuint *indices,
+                                int indexCount,
+                                const QVector3D &boundsMin,
+                                float maxExtent,
+                                int resolution);
+};
+
+#endif // MESHLOD_H
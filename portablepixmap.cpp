@@ -0,0 +1,43 @@
+#include "portablepixmap.h"
+
+PortablePixmapWriter::PortablePixmapWriter()
+    : m_headerSize(0)
+{
+}
+
+bool PortablePixmapWriter::open(const QString &path, const QSize &size)
+{
+    m_file.setFileName(path);
+    if (size.isEmpty() || !m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const QByteArray header = QString("P6\n%0 %1\n255\n").arg(size.width()).arg(size.height()).toLatin1();
+    m_size = size;
+    m_headerSize = header.size();
+
+    // Growing the file up front leaves the tiles to overwrite it in place
+    return m_file.write(header) == m_headerSize
+            && m_file.resize(m_headerSize + qint64(size.width()) * size.height() * 3);
+}
+
+bool PortablePixmapWriter::close()
+{
+    const bool flushed = m_file.flush();
+    m_file.close();
+    return flushed;
+}
+
+bool PortablePixmapWriter::writeTile(const QRect &tile, const uchar *bottomUpRgb)
+{
+    if (!QRect(QPoint(0, 0), m_size).contains(tile))
+        return false;
+
+    const qint64 rowBytes = qint64(tile.width()) * 3;
+    for (int row = 0; row < tile.height(); ++row) {
+        const qint64 offset = m_headerSize + (qint64(tile.bottom() - row) * m_size.width() + tile.x()) * 3;
+        if (!m_file.seek(offset) || m_file.write(reinterpret_cast<const char *>(bottomUpRgb + row * rowBytes), rowBytes) != rowBytes)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef PORTABLEPIXMAP_H
+#define PORTABLEPIXMAP_H
+
+#include <QFile>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+// Writes a binary PPM (P6) image tile by tile. The header fixes the offset
+// of every row, so a tile is written in place as soon as it is rendered and
+// only one tile has to be held in memory, whatever the size of the image.
+class PortablePixmapWriter
+{
+public:
+    PortablePixmapWriter();
+
+    bool open(const QString &path, const QSize &size);
+    bool close();
+
+    // Rows of packed RGB, from the bottom row of the tile up as read back
+    // by glReadPixels()
+    bool writeTile(const QRect &tile, const uchar *bottomUpRgb);
+
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    QFile m_file;
+    QSize m_size;
+    qint64 m_headerSize;
+};
+
+#endif // PORTABLEPIXMAP_H
@@ -0,0 +1,115 @@
+#include "proceduralgeometry.h"
+
+#include <math.h>
+#include <QThread>
+#include <QtConcurrent>
+
+namespace {
+
+struct RowRange {
+    int first;
+    int last;
+};
+
+// Sine and cosine of the angle at every segment boundary, so the surfaces
+// evaluate no trigonometry per vertex.
+void computeAngles(int segments, double range, QVector<float> *sines, QVector<float> *cosines)
+{
+    sines->resize(segments + 1);
+    cosines->resize(segments + 1);
+    for (int i = 0; i <= segments; ++i) {
+        const double angle = range * i / segments;
+        (*sines)[i] = sin(angle);
+        (*cosines)[i] = cos(angle);
+    }
+}
+
+// Evaluates position(column, row) on the (segments + 1)^2 grid and
+// triangulates its quads.
+template<typename PositionFunction>
+void generateSurface(int segments, PositionFunction position, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    const int stride = segments + 1;
+    vertices->resize(stride * stride);
+    indices->resize(segments * segments * 6);
+    QVector3D *vertexData = vertices->data();
+    GLuint *indexData = indices->data();
+
+    QVector<RowRange> ranges;
+    const int taskCount = qMin(stride, QThread::idealThreadCount() * 4);
+    for (int i = 0; i < taskCount; ++i) {
+        RowRange range = { stride * i / taskCount, stride * (i + 1) / taskCount };
+        ranges.append(range);
+    }
+
+    QtConcurrent::blockingMap(ranges, [&](RowRange &range) {
+        for (int row = range.first; row < range.last; ++row) {
+            QVector3D *vertex = vertexData + row * stride;
+            for (int column = 0; column < stride; ++column)
+                *vertex++ = position(column, row);
+
+            if (row == segments)
+                continue;
+
+            GLuint *index = indexData + row * segments * 6;
+            for (int column = 0; column < segments; ++column) {
+                const GLuint topLeft = row * stride + column;
+                const GLuint bottomLeft = topLeft + stride;
+                *index++ = topLeft;
+                *index++ = bottomLeft;
+                *index++ = topLeft + 1;
+                *index++ = topLeft + 1;
+                *index++ = bottomLeft;
+                *index++ = bottomLeft + 1;
+            }
+        }
+    });
+}
+
+} // namespace
+
+void ProceduralGeometry::generateSphere(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    QVector<float> longitudeSines, longitudeCosines;
+    QVector<float> latitudeSines, latitudeCosines;
+    computeAngles(segments, 2.0 * M_PI, &longitudeSines, &longitudeCosines);
+    computeAngles(segments, M_PI, &latitudeSines, &latitudeCosines);
+
+    generateSurface(segments, [&](int column, int row) {
+        return QVector3D(latitudeSines.at(row) * longitudeSines.at(column),
+                         latitudeCosines.at(row),
+                         latitudeSines.at(row) * longitudeCosines.at(column));
+    }, vertices, indices);
+}
+
+void ProceduralGeometry::generateTorus(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    const float majorRadius = 0.7f;
+    const float minorRadius = 0.3f;
+
+    QVector<float> sines, cosines;
+    computeAngles(segments, 2.0 * M_PI, &sines, &cosines);
+
+    generateSurface(segments, [&](int column, int row) {
+        const float ringRadius = majorRadius + minorRadius * cosines.at(row);
+        return QVector3D(ringRadius * sines.at(column),
+                         minorRadius * sines.at(row),
+                         ringRadius * cosines.at(column));
+    }, vertices, indices);
+}
+
+void ProceduralGeometry::generateDisplacedGrid(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices)
+{
+    // Two octaves of waves, the second one is sheared so the surface does
+    // not repeat along the axes.
+    QVector<float> sines, cosines;
+    QVector<float> fineSines, fineCosines;
+    computeAngles(segments, 6.0 * M_PI, &sines, &cosines);
+    computeAngles(segments, 22.0 * M_PI, &fineSines, &fineCosines);
+
+    generateSurface(segments, [&](int column, int row) {
+        const float height = 0.15f * sines.at(column) * cosines.at(row)
+                + 0.04f * (fineSines.at(column) * fineCosines.at(row) + fineCosines.at(column) * fineSines.at(row));
+        return QVector3D(2.0f * column / segments - 1.0f, height, 2.0f * row / segments - 1.0f);
+    }, vertices, indices);
+}
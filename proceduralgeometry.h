@@ -0,0 +1,20 @@
+#ifndef PROCEDURALGEOMETRY_H
+#define PROCEDURALGEOMETRY_H
+
+#include <QOpenGLFunctions>
+#include <QVector3D>
+#include <QVector>
+
+// Tessellated parametric surfaces for load testing. A surface of n segments
+// has (n + 1)^2 vertices and 2 n^2 triangles; the rows are generated in
+// parallel, each task writing its own range of the pre-sized arrays. All
+// shapes fit the [-1, 1] cube.
+class ProceduralGeometry
+{
+public:
+    static void generateSphere(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices);
+    static void generateTorus(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices);
+    static void generateDisplacedGrid(int segments, QVector<QVector3D> *vertices, QVector<GLuint> *indices);
+};
+
+#endif // PROCEDURALGEOMETRY_H
@@ -6,7 +6,9 @@
 
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
+
+CONFIG += c++11
 
 TARGET = qt-shader-demo
 TEMPLATE = app
@@ -17,13 +19,46 @@ SOURCES += main.cpp\
     glwidget.cpp \
     globjectdescriptor.cpp \
     shaderbuilder.cpp \
-    shadercodedialog.cpp
+    shadercodedialog.cpp \
+    shadercompiler.cpp \
+    filtergraph.cpp \
+    filterpipeline.cpp \
+    rendertargetpool.cpp \
+    filterbenchmark.cpp \
+    meshloader.cpp \
+    meshcache.cpp \
+    meshlod.cpp \
+    vertexquantizer.cpp \
+    proceduralgeometry.cpp \
+    tracer.cpp \
+    colorlut.cpp \
+    thumbnailgallery.cpp \
+    sessionrecorder.cpp \
+    portablepixmap.cpp \
+    rawimage.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
     globjectdescriptor.h \
     shaderbuilder.h \
-    shadercodedialog.h
+    shadercodedialog.h \
+    shadercompiler.h \
+    filtergraph.h \
+    filterpipeline.h \
+    rendertargetpool.h \
+    filterbenchmark.h \
+    meshloader.h \
+    meshcache.h \
+    meshlod.h \
+    vertexquantizer.h \
+    proceduralgeometry.h \
+    tracer.h \
+    memoryusage.h \
+    colorlut.h \
+    thumbnailgallery.h \
+    sessionrecorder.h \
+    portablepixmap.h \
+    rawimage.h
 
 FORMS    += mainwindow.ui
 
@@ -0,0 +1,166 @@
+#include "rawimage.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+
+// Skips whitespace and comments, which may appear between the header fields
+const uchar *skipSeparators(const uchar *position, const uchar *end)
+{
+    while (position < end) {
+        if (*position == '#') {
+            while (position < end && *position != '\n')
+                ++position;
+        } else if (isspace(*position)) {
+            ++position;
+        } else {
+            break;
+        }
+    }
+
+    return position;
+}
+
+const uchar *readNumber(const uchar *position, const uchar *end, int *number)
+{
+    position = skipSeparators(position, end);
+    if (position == end || !isdigit(*position))
+        return 0;
+
+    qint64 value = 0;
+    while (position < end && isdigit(*position) && value <= INT_MAX)
+        value = value * 10 + (*position++ - '0');
+    if (value > INT_MAX)
+        return 0;
+
+    *number = int(value);
+    return position;
+}
+
+} // namespace
+
+bool RawImage::isRawImage(const QString &path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "pgm" || suffix == "ppm" || suffix == "pnm" || suffix == "raw";
+}
+
+RawImage *RawImage::open(const QString &path)
+{
+    if (!isRawImage(path) || !QFileInfo(path).isFile())
+        return 0;
+
+    RawImage *image = new RawImage(path);
+    QFile &file = image->m_file;
+    image->m_mapSize = file.size();
+
+    if (!file.open(QIODevice::ReadOnly) || image->m_mapSize == 0
+            || !(image->m_map = file.map(0, image->m_mapSize))) {
+        delete image;
+        return 0;
+    }
+
+    const bool valid = (QFileInfo(path).suffix().toLower() == "raw")
+            ? image->readSidecarHeader(path + ".json")
+            : image->readPortableHeader();
+
+    if (!valid || image->m_size.isEmpty() || image->m_offset + image->getDataSize() > image->m_mapSize) {
+        delete image;
+        return 0;
+    }
+
+    return image;
+}
+
+RawImage::RawImage(const QString &path)
+    : m_file(path)
+    , m_map(0)
+    , m_mapSize(0)
+    , m_offset(0)
+    , m_channels(0)
+    , m_bytesPerChannel(1)
+{
+}
+
+RawImage::~RawImage()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+GLenum RawImage::getPixelFormat() const
+{
+    switch (m_channels) {
+    case 1:
+        return GL_LUMINANCE;
+    case 3:
+        return GL_RGB;
+    case 4:
+    default:
+        return GL_RGBA;
+    }
+}
+
+GLenum RawImage::getPixelType() const
+{
+    return m_bytesPerChannel > 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+}
+
+bool RawImage::readPortableHeader()
+{
+    // The ASCII variants P2 and P3 are left to QImage
+    if (m_mapSize < 2 || m_map[0] != 'P' || (m_map[1] != '5' && m_map[1] != '6'))
+        return false;
+
+    const uchar *end = m_map + m_mapSize;
+    int width, height, maxValue;
+    const uchar *position = readNumber(m_map + 2, end, &width);
+    if (position)
+        position = readNumber(position, end, &height);
+    if (position)
+        position = readNumber(position, end, &maxValue);
+
+    // A single whitespace character separates the header from the pixels
+    if (!position || position == end || !isspace(*position) || maxValue <= 0 || maxValue > 65535)
+        return false;
+
+    // Samples below the full range would need to be scaled, which is a
+    // decode after all
+    if (maxValue != 255 && maxValue != 65535) {
+        qWarning() << "Unsupported maximum value of raw image: " << maxValue;
+        return false;
+    }
+
+    m_size = QSize(width, height);
+    m_channels = (m_map[1] == '5') ? 1 : 3;
+    m_bytesPerChannel = (maxValue > 255) ? 2 : 1;
+    m_offset = position + 1 - m_map;
+    return true;
+}
+
+bool RawImage::readSidecarHeader(const QString &sidecarPath)
+{
+    QFile sidecar(sidecarPath);
+    if (!sidecar.open(QIODevice::ReadOnly)) {
+        qWarning() << "Raw image without sidecar header: " << sidecarPath;
+        return false;
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(sidecar.readAll()).object();
+    const int channels = header.value("channels").toInt(4);
+    if (channels != 1 && channels != 3 && channels != 4) {
+        qWarning() << "Unsupported channel count of raw image: " << channels;
+        return false;
+    }
+
+    m_size = QSize(header.value("width").toInt(), header.value("height").toInt());
+    m_channels = channels;
+    m_bytesPerChannel = 1;
+    m_offset = qMax(qint64(header.value("offset").toDouble()), qint64(0));
+    return true;
+}
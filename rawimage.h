@@ -0,0 +1,58 @@
+#ifndef RAWIMAGE_H
+#define RAWIMAGE_H
+
+#include <QFile>
+#include <QOpenGLFunctions>
+#include <QSize>
+#include <QString>
+
+// Uncompressed image which is memory mapped and handed to the texture
+// upload without decoding. Binary PGM (P5) and PPM (P6) files have 8 or 16
+// bit samples, 16 bit ones are big endian. Raw files have 8 bit samples and
+// are described by a JSON sidecar file next to them:
+//
+//   image.raw         offset, then height rows of width * channels bytes
+//   image.raw.json    {"width": 1920, "height": 1080, "channels": 4, "offset": 0}
+//
+// The rows are stored from the top down, as in the file.
+class RawImage
+{
+public:
+    // Only decides by the suffix, open() checks the header
+    static bool isRawImage(const QString &path);
+
+    // Returns 0 if the file is missing, truncated or of another format
+    static RawImage *open(const QString &path);
+
+    ~RawImage();
+
+    QSize getSize() const { return m_size; }
+    int getChannels() const { return m_channels; }
+    int getBytesPerChannel() const { return m_bytesPerChannel; }
+    bool isBigEndian() const { return m_bytesPerChannel > 1; }
+
+    // Rows are tightly packed, without alignment
+    int getBytesPerLine() const { return m_size.width() * m_channels * m_bytesPerChannel; }
+    const uchar *getScanLine(int y) const { return m_map + m_offset + qint64(y) * getBytesPerLine(); }
+    qint64 getDataSize() const { return qint64(getBytesPerLine()) * m_size.height(); }
+
+    // Format and type of the pixels for glTexSubImage2D()
+    GLenum getPixelFormat() const;
+    GLenum getPixelType() const;
+
+private:
+    RawImage(const QString &path);
+
+    bool readPortableHeader();
+    bool readSidecarHeader(const QString &sidecarPath);
+
+    QFile m_file;
+    uchar *m_map;
+    qint64 m_mapSize;
+    qint64 m_offset;
+    QSize m_size;
+    int m_channels;
+    int m_bytesPerChannel;
+};
+
+#endif // RAWIMAGE_H
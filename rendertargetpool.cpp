@@ -0,0 +1,147 @@
+#include "rendertargetpool.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+RenderTargetPool::RenderTargetPool(qint64 budgetBytes)
+    : m_budgetBytes(budgetBytes)
+    , m_residentBytes(0)
+    , m_frame(0)
+    , m_frameAllocations(0)
+    , m_lastFrameAllocations(0)
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    foreach (const FreeTarget &freeTarget, m_freeTargets)
+        delete freeTarget.target;
+    qDeleteAll(m_usedTargets);
+}
+
+QOpenGLFramebufferObject *RenderTargetPool::acquire(const QSize &size, GLenum internalFormat,
+                                                    QOpenGLFramebufferObject::Attachment attachment,
+                                                    int samples)
+{
+    for (int i = 0; i < m_freeTargets.count(); ++i) {
+        QOpenGLFramebufferObject *target = m_freeTargets.at(i).target;
+        if (target->size() == size && target->format().internalTextureFormat() == internalFormat
+                && target->attachment() == attachment && target->format().samples() == samples) {
+            m_freeTargets.removeAt(i);
+            m_usedTargets.insert(target);
+            return target;
+        }
+    }
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(attachment);
+    format.setInternalTextureFormat(internalFormat);
+    format.setSamples(samples);
+    QOpenGLFramebufferObject *target = new QOpenGLFramebufferObject(size, format);
+
+    // Single channel luma is sampled as gray by the following passes
+    if (internalFormat == GL_R8 || internalFormat == GL_R16F) {
+        static const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        QOpenGLFunctions *functions = QOpenGLContext::currentContext()->functions();
+        functions->glBindTexture(GL_TEXTURE_2D, target->texture());
+        functions->glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        functions->glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    m_usedTargets.insert(target);
+    m_residentBytes += targetBytes(size, internalFormat, attachment, target->format().samples());
+    ++m_frameAllocations;
+
+    return target;
+}
+
+void RenderTargetPool::release(QOpenGLFramebufferObject *target)
+{
+    if (!target || !m_usedTargets.remove(target))
+        return;
+
+    FreeTarget freeTarget;
+    freeTarget.target = target;
+    freeTarget.lastUsedFrame = m_frame;
+    m_freeTargets.append(freeTarget);
+}
+
+void RenderTargetPool::beginFrame()
+{
+    m_lastFrameAllocations = m_frameAllocations;
+    m_frameAllocations = 0;
+    ++m_frame;
+
+    trim();
+}
+
+void RenderTargetPool::trim()
+{
+    while (m_residentBytes > m_budgetBytes && !m_freeTargets.isEmpty()) {
+        int oldest = 0;
+        for (int i = 1; i < m_freeTargets.count(); ++i) {
+            if (m_freeTargets.at(i).lastUsedFrame < m_freeTargets.at(oldest).lastUsedFrame)
+                oldest = i;
+        }
+
+        QOpenGLFramebufferObject *target = m_freeTargets.takeAt(oldest).target;
+        m_residentBytes -= targetBytes(target->size(), target->format().internalTextureFormat(), target->attachment(),
+                                       target->format().samples());
+        delete target;
+    }
+}
+
+void RenderTargetPool::setBudget(qint64 budgetBytes)
+{
+    m_budgetBytes = budgetBytes;
+    trim();
+}
+
+QString RenderTargetPool::statistics() const
+{
+    return QString("Render targets: %0 allocations/frame, %1 MB resident")
+            .arg(m_lastFrameAllocations)
+            .arg(m_residentBytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+qint64 RenderTargetPool::targetBytes(const QSize &size, GLenum internalFormat,
+                                     QOpenGLFramebufferObject::Attachment attachment, int samples)
+{
+    int bytesPerTexel;
+    switch (internalFormat) {
+    case GL_R8:
+        bytesPerTexel = 1;
+        break;
+    case GL_R16F:
+        bytesPerTexel = 2;
+        break;
+    case GL_RGBA32F:
+        bytesPerTexel = 16;
+        break;
+    case GL_RG16F:
+    case GL_RGBA8:
+    default:
+        bytesPerTexel = 4;
+        break;
+    }
+
+    // Packed 24 bit depth and 8 bit stencil
+    if (attachment != QOpenGLFramebufferObject::NoAttachment)
+        bytesPerTexel += 4;
+
+    // Every sample keeps its own color, depth and stencil
+    return qint64(size.width()) * size.height() * bytesPerTexel * qMax(samples, 1);
+}
+
+bool RenderTargetPool::supportsReducedFormats(QOpenGLContext *context)
+{
+    if (!context || context->isOpenGLES())
+        return false;
+
+    if (context->format().version() >= qMakePair(3, 3))
+        return true;
+
+    return context->hasExtension(QByteArrayLiteral("GL_ARB_texture_rg"))
+            && context->hasExtension(QByteArrayLiteral("GL_ARB_texture_float"))
+            && context->hasExtension(QByteArrayLiteral("GL_ARB_texture_swizzle"));
+}
@@ -0,0 +1,58 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <QList>
+#include <QOpenGLFramebufferObject>
+#include <QSet>
+#include <QSize>
+#include <QString>
+
+class QOpenGLContext;
+
+// Hands out intermediate render targets keyed by size and internal format.
+// Released targets are kept for reuse across passes and frames, and the
+// least recently used ones are deleted when the pool exceeds its budget.
+// Multisampled targets have no texture, they are resolved by a blit.
+class RenderTargetPool
+{
+public:
+    explicit RenderTargetPool(qint64 budgetBytes = 256 * 1024 * 1024);
+    ~RenderTargetPool();
+
+    QOpenGLFramebufferObject *acquire(const QSize &size, GLenum internalFormat = GL_RGBA8,
+                                      QOpenGLFramebufferObject::Attachment attachment = QOpenGLFramebufferObject::NoAttachment,
+                                      int samples = 0);
+    void release(QOpenGLFramebufferObject *target);
+
+    void beginFrame();
+    void trim();
+
+    void setBudget(qint64 budgetBytes);
+    qint64 budget() const { return m_budgetBytes; }
+
+    int allocationsPerFrame() const { return m_lastFrameAllocations; }
+    qint64 residentBytes() const { return m_residentBytes; }
+    QString statistics() const;
+
+    static qint64 targetBytes(const QSize &size, GLenum internalFormat,
+                              QOpenGLFramebufferObject::Attachment attachment = QOpenGLFramebufferObject::NoAttachment,
+                              int samples = 0);
+    static bool supportsReducedFormats(QOpenGLContext *context);
+
+private:
+    struct FreeTarget {
+        QOpenGLFramebufferObject *target;
+        int lastUsedFrame;
+    };
+
+    QList<FreeTarget> m_freeTargets;
+    QSet<QOpenGLFramebufferObject *> m_usedTargets;
+
+    qint64 m_budgetBytes;
+    qint64 m_residentBytes;
+    int m_frame;
+    int m_frameAllocations;
+    int m_lastFrameAllocations;
+};
+
+#endif // RENDERTARGETPOOL_H
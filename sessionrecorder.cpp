@@ -0,0 +1,219 @@
+#include "sessionrecorder.h"
+
+#include <algorithm>
+#include <QApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMouseEvent>
+#include <QTextStream>
+#include <QWheelEvent>
+
+#include "glwidget.h"
+#include "mainwindow.h"
+
+namespace {
+
+QFile *sessionFile = 0;
+QElapsedTimer sessionClock;
+
+void stopOnExit()
+{
+    SessionRecorder::stop();
+}
+
+double percentile(QVector<double> values, double fraction)
+{
+    if (values.isEmpty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    return values.at(qMin(int(fraction * values.count()), values.count() - 1));
+}
+
+} // namespace
+
+bool SessionRecorder::s_recording = false;
+
+bool SessionRecorder::start(const QString &outputPath)
+{
+    stop();
+
+    sessionFile = new QFile(outputPath);
+    if (!sessionFile->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Unable to record session: " << outputPath;
+        delete sessionFile;
+        sessionFile = 0;
+        return false;
+    }
+
+    static bool postRoutineAdded = false;
+    if (!postRoutineAdded) {
+        qAddPostRoutine(stopOnExit);
+        postRoutineAdded = true;
+    }
+
+    sessionClock.start();
+    s_recording = true;
+    return true;
+}
+
+void SessionRecorder::stop()
+{
+    s_recording = false;
+    delete sessionFile;
+    sessionFile = 0;
+}
+
+void SessionRecorder::record(const QString &action, QJsonObject arguments)
+{
+    if (!s_recording)
+        return;
+
+    arguments.insert("t", qRound(sessionClock.nsecsElapsed() / 100000.0) / 10.0);
+    arguments.insert("action", action);
+    sessionFile->write(QJsonDocument(arguments).toJson(QJsonDocument::Compact));
+    sessionFile->write("\n");
+    sessionFile->flush();
+}
+
+SessionReplayer::SessionReplayer(MainWindow *mainWindow)
+    : m_mainWindow(mainWindow)
+{
+}
+
+bool SessionReplayer::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Unable to open session: " << path;
+        return false;
+    }
+
+    m_actions.clear();
+    m_size = QSize();
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty())
+            continue;
+
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (!document.isObject()) {
+            qWarning() << "Invalid session action at line" << lineNumber << ":" << error.errorString();
+            return false;
+        }
+
+        const QJsonObject action = document.object();
+        if (m_size.isEmpty() && action.value("action").toString() == "resize")
+            m_size = QSize(action.value("width").toInt(), action.value("height").toInt());
+        m_actions.append(action);
+    }
+
+    return true;
+}
+
+int SessionReplayer::run()
+{
+    GLWidget *glWidget = m_mainWindow->glWidget();
+    glWidget->setAdaptivePreviewEnabled(false);
+    glWidget->setBackgroundCompilationEnabled(false);
+
+    // A hidden widget is drawn at the size of the recording, a later resize
+    // would need a new framebuffer object and is not replayed
+    if (!glWidget->isVisible() && !m_size.isEmpty())
+        glWidget->resize(m_size);
+
+    m_frames.clear();
+    foreach (const QJsonObject &action, m_actions) {
+        if (action.value("action").toString() == "frame") {
+            Frame frame;
+            frame.recordedTime = action.value("t").toDouble();
+            frame.frameTime = glWidget->renderFrame();
+            m_frames.append(frame);
+        } else {
+            apply(action);
+        }
+    }
+
+    glWidget->setBackgroundCompilationEnabled(true);
+    return m_frames.count();
+}
+
+void SessionReplayer::apply(const QJsonObject &action)
+{
+    GLWidget *glWidget = m_mainWindow->glWidget();
+    const QString type = action.value("action").toString();
+    const QPoint position(action.value("x").toInt(), action.value("y").toInt());
+    const Qt::MouseButtons buttons(QFlag(action.value("buttons").toInt()));
+
+    if (type == "state") {
+        m_mainWindow->restoreSessionState(action);
+    } else if (type == "rotate") {
+        glWidget->rotate(action.value("angle").toInt(), static_cast<Axis::Axis>(action.value("axis").toInt()));
+    } else if (type == "shaderAnimProgress") {
+        glWidget->setShaderAnimProgress(action.value("progress").toInt());
+    } else if (type == "mousePress") {
+        QMouseEvent event(QEvent::MouseButtonPress, position, Qt::MouseButton(action.value("button").toInt()), buttons, Qt::NoModifier);
+        QApplication::sendEvent(glWidget, &event);
+    } else if (type == "mouseMove") {
+        QMouseEvent event(QEvent::MouseMove, position, Qt::NoButton, buttons, Qt::NoModifier);
+        QApplication::sendEvent(glWidget, &event);
+    } else if (type == "mouseRelease") {
+        QMouseEvent event(QEvent::MouseButtonRelease, position, Qt::MouseButton(action.value("button").toInt()), buttons, Qt::NoModifier);
+        QApplication::sendEvent(glWidget, &event);
+    } else if (type == "mouseDoubleClick") {
+        QMouseEvent event(QEvent::MouseButtonDblClick, position, Qt::MouseButton(action.value("button").toInt()), buttons, Qt::NoModifier);
+        QApplication::sendEvent(glWidget, &event);
+    } else if (type == "wheel") {
+        const Qt::Orientation orientation = action.value("horizontal").toBool() ? Qt::Horizontal : Qt::Vertical;
+        QWheelEvent event(position, action.value("delta").toInt(), buttons, Qt::NoModifier, orientation);
+        QApplication::sendEvent(glWidget, &event);
+    }
+}
+
+bool SessionReplayer::writeTimings(const QString &path) const
+{
+    QFile file;
+    if (path.isEmpty()) {
+        file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    } else {
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            qWarning() << "Unable to write frame timings: " << path;
+            return false;
+        }
+    }
+
+    QTextStream out(&file);
+    out << "frame,recorded_ms,frame_ms\n";
+    for (int i = 0; i < m_frames.count(); ++i) {
+        out << QString("%0,%1,%2\n")
+               .arg(i)
+               .arg(m_frames.at(i).recordedTime, 0, 'f', 1)
+               .arg(m_frames.at(i).frameTime, 0, 'f', 3);
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+QString SessionReplayer::summary() const
+{
+    QVector<double> frameTimes;
+    double total = 0.0;
+    foreach (const Frame &frame, m_frames) {
+        frameTimes.append(frame.frameTime);
+        total += frame.frameTime;
+    }
+
+    return QString("Frames: %0, mean %1 ms, median %2 ms, 95th percentile %3 ms, max %4 ms")
+            .arg(m_frames.count())
+            .arg(m_frames.isEmpty() ? 0.0 : total / m_frames.count(), 0, 'f', 3)
+            .arg(percentile(frameTimes, 0.5), 0, 'f', 3)
+            .arg(percentile(frameTimes, 0.95), 0, 'f', 3)
+            .arg(percentile(frameTimes, 1.0), 0, 'f', 3);
+}
@@ -0,0 +1,68 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+class MainWindow;
+
+// Records the interactions of a session as JSON lines, one action per line
+// with the milliseconds since the recording started:
+//
+//   {"t":1520.3,"action":"mouseMove","x":310,"y":244,"buttons":1}
+//
+// Actions are recorded where they take effect, so rotation driven by the
+// slider timers and the shader animation timer are recorded as the steps
+// they made. Every painted frame is recorded too, the replay draws its
+// frames at the same points of the session.
+class SessionRecorder
+{
+public:
+    static bool isRecording() { return s_recording; }
+
+    // Every action is flushed as it is recorded, the file stays usable if
+    // the session crashes
+    static bool start(const QString &outputPath);
+    static void stop();
+
+    static void record(const QString &action, QJsonObject arguments = QJsonObject());
+
+private:
+    static bool s_recording;
+};
+
+// Replays a recorded session against the main window and times the frames.
+// Background shader compilation and the adaptive preview are turned off
+// and the timers of the session do not run, so every replay draws the same
+// frames. Without a visible window the frames are drawn into the widget's
+// framebuffer object on its offscreen surface.
+class SessionReplayer
+{
+public:
+    explicit SessionReplayer(MainWindow *mainWindow);
+
+    bool load(const QString &path);
+    int run();
+
+    // CSV with one line per frame, written to stdout if the path is empty
+    bool writeTimings(const QString &path) const;
+    QString summary() const;
+
+private:
+    struct Frame {
+        double recordedTime;
+        double frameTime;
+    };
+
+    void apply(const QJsonObject &action);
+
+    MainWindow *m_mainWindow;
+    QList<QJsonObject> m_actions;
+    QSize m_size;
+    QVector<Frame> m_frames;
+};
+
+#endif // SESSIONRECORDER_H
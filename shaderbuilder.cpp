@@ -4,12 +4,63 @@
 #include <QDebug>
 #include <QFile>
 
+#include "colorlut.h"
+#include "tracer.h"
+
 QStringList ShaderBuilder::m_vertexShaderFunctionsCode;
 QStringList ShaderBuilder::m_fragmentShaderFunctionsCode;
 
 int ShaderBuilder::m_kernelRadius = 4;
 QVector<float> ShaderBuilder::m_gaussianKernel;
 
+FilterGraph ShaderConfig::toFilterGraph() const
+{
+    if (!filterGraph.isEmpty())
+        return filterGraph;
+
+    FilterGraph graph;
+    switch(imageProcessShader) {
+    case ShaderConfig::Gauss:
+        graph.append(FilterNode::GaussBlur);
+        break;
+    case ShaderConfig::Sobel:
+        graph.append(FilterNode::Sobel);
+        break;
+    case ShaderConfig::SobelGauss:
+        graph.append(FilterNode::SobelGauss);
+        break;
+    case ShaderConfig::Canny:
+        graph.append(FilterNode::Canny);
+        break;
+    case ShaderConfig::LargeBlur:
+        graph.append(FilterNode::LargeBlur);
+        break;
+    case ShaderConfig::AdaptiveThreshold:
+        graph.append(FilterNode::AdaptiveThreshold);
+        break;
+    case ShaderConfig::Median:
+        graph.append(FilterNode::Median);
+        break;
+    case ShaderConfig::Bilateral:
+        graph.append(FilterNode::Bilateral);
+        break;
+    case ShaderConfig::None:
+    default:
+        break;
+    }
+
+    if (gray)
+        graph.append(FilterNode::Gray);
+
+    if (invert)
+        graph.append(FilterNode::Invert);
+
+    if (threshold)
+        graph.append(FilterNode::Threshold, 0.5);
+
+    return graph;
+}
+
 QVector<float> ShaderBuilder::computeGaussianKernel(int kernelRadius, float sigma)
 {
     const int kernelSize = kernelRadius * 2 + 1;
@@ -45,12 +96,12 @@ QVector<float> ShaderBuilder::computeGaussianKernel(int kernelRadius, float sigm
 ShaderBuilder::ShaderBuilder(const QString &version, QObject *parent)
     : QObject(parent)
     , m_version(version)
+    , m_shaderConfig(0)
+    , m_textureArray(false)
+    , m_regionOfInterest(false)
 {
-#if 0
-    // TODO(pvarga): There has been no function implemented for the vertex shader yet
     if (m_vertexShaderFunctionsCode.isEmpty())
         m_vertexShaderFunctionsCode.append(readShaderFile(":/shaders/functions-120.vert"));
-#endif
 
     if (m_fragmentShaderFunctionsCode.isEmpty())
         m_fragmentShaderFunctionsCode.append(readShaderFile(":/shaders/functions-120.frag"));
@@ -94,6 +145,124 @@ void ShaderBuilder::setShaderConfig(ShaderConfig *shaderConfig)
 }
 
 QStringList ShaderBuilder::getShaderCode(QOpenGLShader::ShaderType type) const
+{
+    TRACE_ZONE("ShaderBuilder::getShaderCode");
+    // Only the last pass is drawn by the object, the previous ones are
+    // rendered into the texture which is bound to inputTexture.
+    const FilterPlan plan = (type == QOpenGLShader::Fragment) ? getFilterPlan() : FilterPlan();
+
+    const bool vertexShader = (type == QOpenGLShader::Vertex && m_shaderConfig
+                               && m_shaderConfig->vertexShader != ShaderConfig::NoVertexShader);
+
+    QStringList variables = getVariables(type);
+    if (!plan.isEmpty() && plan.passes.last().colorLut)
+        variables.append("uniform sampler3D colorLut;");
+    const bool regionOfInterest = (m_regionOfInterest && !plan.isEmpty());
+    if (regionOfInterest)
+        variables.append("uniform vec4 regionOfInterest;");
+    if (vertexShader) {
+        variables.append("uniform float time;");
+        variables.append("uniform mat4 objectMatrix;");
+        variables.append("uniform mat4 objectMatrixInverse;");
+    }
+
+    QStringList shaderCode = generateHeader(type, variables);
+    if (shaderCode.isEmpty())
+        return QStringList();
+
+    QString indent("\t");
+    shaderCode.append("void main(void)");
+    shaderCode.append("{");
+    const QStringList mainBody = vertexShader ? toVertexShaderCode(getMainBody(type)) : getMainBody(type);
+    foreach (QString mainBodyLine, mainBody) {
+        shaderCode.append(QString("%0%1").arg(indent, mainBodyLine));
+    }
+
+    if (type == QOpenGLShader::Fragment && m_shaderConfig) {
+        if (m_shaderConfig->animEnabled) {
+            shaderCode.append(QString("%0float progress = clamp(animProgress / 100.0, 0.0, 1.0);").arg(indent));
+            shaderCode.append(QString("%0if (varyingTextureCoordinate.y > (1.0 - progress)) {").arg(indent));
+            indent += "\t";
+        }
+
+        if (regionOfInterest) {
+            shaderCode.append(QString("%0if (insideRegion(varyingTextureCoordinate, regionOfInterest)) {").arg(indent));
+            shaderCode.append(generateFilterPassCode(plan.passes.last(), indent + "\t"));
+            shaderCode.append(QString("%0}").arg(indent));
+        } else if (!plan.isEmpty()) {
+            shaderCode.append(generateFilterPassCode(plan.passes.last(), indent));
+        }
+    }
+    if (type == QOpenGLShader::Fragment && m_shaderConfig && m_shaderConfig->animEnabled)
+        shaderCode.append(QString("%0}").arg(indent));
+
+    shaderCode.append("}"); // close main
+
+    if (type == QOpenGLShader::Fragment && m_textureArray)
+        return toTextureArrayCode(shaderCode);
+
+    return shaderCode;
+}
+
+FilterPlan ShaderBuilder::getFilterPlan() const
+{
+    if (!m_shaderConfig)
+        return FilterPlan();
+
+    return FilterPlanner::plan(m_shaderConfig->toFilterGraph(), m_shaderConfig->reducedPrecision, m_shaderConfig->comparisonView);
+}
+
+QStringList ShaderBuilder::getFilterPassShaderCode(QOpenGLShader::ShaderType type, int pass) const
+{
+    FilterPlan plan = getFilterPlan();
+    if (pass < 0 || pass >= plan.offscreenPassCount())
+        return QStringList();
+
+    // Offscreen passes draw a screen aligned quad into the intermediate texture
+    QStringList variables;
+    QStringList mainBody;
+    if (type == QOpenGLShader::Vertex) {
+        variables.append("attribute vec4 vertex;");
+        variables.append("attribute vec2 textureCoordinate;");
+        variables.append("varying vec2 varyingTextureCoordinate;");
+
+        mainBody.append("varyingTextureCoordinate = textureCoordinate;");
+        mainBody.append("gl_Position = vertex;");
+
+        if (m_textureArray) {
+            variables.append("uniform float layer;");
+            variables.append("varying float varyingLayer;");
+            mainBody.append("varyingLayer = layer;");
+        }
+    } else {
+        variables.append("uniform sampler2D inputTexture;");
+        variables.append("uniform vec2 textureSize;");
+        variables.append("varying vec2 varyingTextureCoordinate;");
+        if (plan.passes.at(pass).colorLut)
+            variables.append("uniform sampler3D colorLut;");
+
+        mainBody.append("gl_FragColor = texture2D(inputTexture, varyingTextureCoordinate);");
+        mainBody.append(generateFilterPassCode(plan.passes.at(pass), QString()));
+    }
+
+    QStringList shaderCode = generateHeader(type, variables);
+    if (shaderCode.isEmpty())
+        return QStringList();
+
+    shaderCode.append("void main(void)");
+    shaderCode.append("{");
+    foreach (QString mainBodyLine, mainBody) {
+        shaderCode.append(QString("\t%0").arg(mainBodyLine));
+    }
+    shaderCode.append("}"); // close main
+
+    if (type == QOpenGLShader::Fragment && m_textureArray)
+        return toTextureArrayCode(shaderCode);
+
+    return shaderCode;
+}
+
+QStringList ShaderBuilder::generateHeader(QOpenGLShader::ShaderType type, const QStringList &variables) const
 {
     QStringList functionsCode;
 
@@ -113,60 +282,161 @@ QStringList ShaderBuilder::getShaderCode(QOpenGLShader::ShaderType type) const
     if (!m_version.isEmpty())
         shaderCode.append(QString("#version %0").arg(m_version));
 
+    const bool textureArray = (m_textureArray && type == QOpenGLShader::Fragment);
+    if (textureArray)
+        shaderCode.append("#extension GL_EXT_texture_array : require");
+
     shaderCode.append(generateConstants(type));
+
+    if (textureArray) {
+        shaderCode.append("varying float varyingLayer;");
+        shaderCode.append("vec4 fetchLayer(sampler2DArray tex, vec2 coords)");
+        shaderCode.append("{");
+        shaderCode.append("\treturn texture2DArray(tex, vec3(coords, varyingLayer));");
+        shaderCode.append("}");
+    }
+
     shaderCode.append(functionsCode);
     shaderCode.append("\n");
-    shaderCode.append(getVariables(type));
+    shaderCode.append(variables);
     shaderCode.append("\n");
 
-    QString indent("\t");
-    shaderCode.append("void main(void)");
-    shaderCode.append("{");
-    foreach (QString mainBodyLine, getMainBody(type)) {
-        shaderCode.append(QString("%0%1").arg(indent, mainBodyLine));
-    }
+    return shaderCode;
+}
 
-    if (type == QOpenGLShader::Fragment && m_shaderConfig) {
-        if (m_shaderConfig->animEnabled) {
-            shaderCode.append(QString("%0float progress = clamp(animProgress / 100.0, 0.0, 1.0);").arg(indent));
-            shaderCode.append(QString("%0if (varyingTextureCoordinate.y > (1.0 - progress)) {").arg(indent));
-            indent += "\t";
-        }
+QStringList ShaderBuilder::generateFilterPassCode(const FilterPass &pass, const QString &indent) const
+{
+    QStringList code;
+
+    foreach (const FilterNode &node, pass.nodes) {
+        // The point-wise nodes are applied together after the loop
+        if (pass.colorLut && node.isPointWise())
+            continue;
 
-        switch(m_shaderConfig->imageProcessShader) {
-        case ShaderConfig::Gauss:
-            shaderCode.append(QString("%0gl_FragColor = gaussBlur(texture, textureSize, varyingTextureCoordinate);").arg(indent));
+        switch (node.operation) {
+        case FilterNode::GaussBlur:
+            code.append(QString("%0gl_FragColor = gaussBlur(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
             break;
-        case ShaderConfig::Sobel:
-            shaderCode.append(QString("%0gl_FragColor = sobel(texture, textureSize, varyingTextureCoordinate, false);").arg(indent));
+        case FilterNode::Sobel:
+            code.append(QString("%0gl_FragColor = sobel(inputTexture, textureSize, varyingTextureCoordinate, false);").arg(indent));
             break;
-        case ShaderConfig::SobelGauss:
-            shaderCode.append(QString("%0gl_FragColor = sobel(texture, textureSize, varyingTextureCoordinate, true);").arg(indent));
+        case FilterNode::SobelGauss:
+            code.append(QString("%0gl_FragColor = sobel(inputTexture, textureSize, varyingTextureCoordinate, true);").arg(indent));
             break;
-        case ShaderConfig::Canny:
-            shaderCode.append(QString("%0gl_FragColor = canny(texture, textureSize, varyingTextureCoordinate);").arg(indent));
+        case FilterNode::Canny:
+            code.append(QString("%0gl_FragColor = canny(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
             break;
-        case ShaderConfig::None:
-        default:
+        case FilterNode::Gradient:
+            code.append(QString("%0gl_FragColor = lumaGradient(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
+            break;
+        case FilterNode::EdgeSuppression:
+            code.append(QString("%0gl_FragColor = suppressNonMaxEdges(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
+            break;
+        case FilterNode::Downsample:
+            code.append(QString("%0gl_FragColor = dualDownsample(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
+            break;
+        case FilterNode::Upsample:
+            code.append(QString("%0gl_FragColor = dualUpsample(inputTexture, textureSize, varyingTextureCoordinate);").arg(indent));
+            break;
+        case FilterNode::LargeBlur:
+            // Split into downsample and upsample passes by the planner
+            break;
+        case FilterNode::IntegralImage:
+            code.append(QString("%0gl_FragColor = prefixSum(inputTexture, textureSize, varyingTextureCoordinate, %1, %2, %3, %4);")
+                        .arg(indent)
+                        .arg(node.parameter(0) == 0.0 ? "vec2(1.0, 0.0)" : "vec2(0.0, 1.0)")
+                        .arg(QString::number(node.parameter(1), 'f', 1))
+                        .arg(node.parameter(2) != 0.0 ? "true" : "false")
+                        .arg(node.parameter(3) != 0.0 ? "true" : "false"));
+            break;
+        case FilterNode::BoxBlur:
+            code.append(QString("%0gl_FragColor = boxFilter(inputTexture, textureSize, varyingTextureCoordinate, %1);")
+                        .arg(indent, QString::number(qMax(node.parameter(0, 4.0), 0.0f), 'f', 1)));
+            break;
+        case FilterNode::AdaptiveThreshold:
+            code.append(QString("%0gl_FragColor = adaptiveThreshold(inputTexture, textureSize, varyingTextureCoordinate, %1, %2);")
+                        .arg(indent, QString::number(qMax(node.parameter(0, 16.0), 0.0f), 'f', 1), QString::number(node.parameter(1, 0.2), 'f', 4)));
+            break;
+        case FilterNode::Median:
+            code.append(QString("%0gl_FragColor = %1(inputTexture, textureSize, varyingTextureCoordinate);")
+                        .arg(indent, node.parameter(0, 3.0) >= 5.0 ? "median5x5" : "median3x3"));
+            break;
+        case FilterNode::Bilateral:
+            // Split into a pass along the rows and one along the columns
+            break;
+        case FilterNode::BilateralPass:
+            code.append(QString("%0gl_FragColor = bilateralPass(inputTexture, textureSize, varyingTextureCoordinate, %1, %2, %3);")
+                        .arg(indent)
+                        .arg(node.parameter(0) == 0.0 ? "vec2(1.0, 0.0)" : "vec2(0.0, 1.0)")
+                        .arg(QString::number(node.parameter(1), 'f', 1))
+                        .arg(QString::number(node.parameter(2), 'f', 4)));
+            break;
+        case FilterNode::Gray:
+            code.append(QString("%0gl_FragColor = gray(gl_FragColor);").arg(indent));
+            break;
+        case FilterNode::Invert:
+            code.append(QString("%0gl_FragColor = invert(gl_FragColor);").arg(indent));
+            break;
+        case FilterNode::Threshold:
+            code.append(QString("%0gl_FragColor = threshold(gl_FragColor, %1);").arg(indent, QString::number(node.parameter(0, 0.5), 'f', 4)));
+            break;
+        case FilterNode::Levels:
+        case FilterNode::Curves:
+        case FilterNode::Saturation:
+        case FilterNode::Grade:
+            // Only available through the lookup table
             break;
         }
+    }
 
-        if (m_shaderConfig->gray)
-            shaderCode.append(QString("%0gl_FragColor = gray(gl_FragColor);").arg(indent));
+    if (pass.colorLut)
+        code.append(QString("%0gl_FragColor = applyColorLut(colorLut, gl_FragColor);").arg(indent));
 
-        if (m_shaderConfig->invert)
-            shaderCode.append(QString("%0gl_FragColor = invert(gl_FragColor);").arg(indent));
+    return code;
+}
+
+QStringList ShaderBuilder::toTextureArrayCode(const QStringList &code) const
+{
+    // Every fetch of the functions and the generated passes has the form
+    // texture2D(sampler, coords), so the arguments can stay as they are
+    QStringList arrayCode;
+    foreach (QString line, code) {
+        line.replace(QRegExp("\\bsampler2D\\b"), "sampler2DArray");
+        line.replace(QRegExp("\\btexture2D\\("), "fetchLayer(");
+        arrayCode.append(line);
+    }
 
-        if (m_shaderConfig->threshold)
-            shaderCode.append(QString("%0gl_FragColor = threshold(gl_FragColor, 0.5);").arg(indent));
+    return arrayCode;
+}
 
+QStringList ShaderBuilder::toVertexShaderCode(const QStringList &mainBody) const
+{
+    QString function;
+    switch (m_shaderConfig->vertexShader) {
+    case ShaderConfig::Waves:
+        function = "waves";
+        break;
+    case ShaderConfig::Twist:
+        function = "twist";
+        break;
+    case ShaderConfig::Explode:
+        function = "explode";
+        break;
+    case ShaderConfig::NoVertexShader:
+    default:
+        return mainBody;
     }
-    if (type == QOpenGLShader::Fragment && m_shaderConfig && m_shaderConfig->animEnabled)
-        shaderCode.append(QString("%0}").arg(indent));
 
-    shaderCode.append("}"); // close main
+    // The displaced vertex is moved back into the space of the attribute,
+    // the rest of the main body uses it in place of the attribute
+    QStringList code;
+    code.append(QString("vec4 displacedVertex = objectMatrixInverse * vec4(%0((objectMatrix * vertex).xyz, time), 1.0);").arg(function));
+    foreach (QString line, mainBody) {
+        line.replace(QRegExp("\\bvertex\\b"), "displacedVertex");
+        code.append(line);
+    }
 
-    return shaderCode;
+    return code;
 }
 
 QStringList ShaderBuilder::readShaderFile(const QString &path)
@@ -206,6 +476,7 @@ QStringList ShaderBuilder::generateConstants(QOpenGLShader::ShaderType type) con
     constants.append(QString("\t%0);").arg(elements.join(", ")));
 
     constants.append(QString("const float pi = %0;").arg(QString::number(M_PI)));
+    constants.append(QString("const float ColorLutSize = %0.0;").arg(ColorLut::Size));
 
     return constants;
 }
@@ -7,22 +7,48 @@
 #include <QStringList>
 #include <QVector>
 
+#include "filtergraph.h"
+
 struct ShaderConfig {
     enum IPShader {
         None = 0,
         Gauss,
         Sobel,
         SobelGauss,
-        Canny
+        Canny,
+        LargeBlur,
+        AdaptiveThreshold,
+        Median,
+        Bilateral
+    };
+
+    // Deforms the geometry in the vertex shader, see functions-120.vert
+    enum VertexShader {
+        NoVertexShader = 0,
+        Waves,
+        Twist,
+        Explode
     };
 
     bool animEnabled;
+    VertexShader vertexShader;
 
     bool gray;
     bool invert;
     bool threshold;
 
     IPShader imageProcessShader;
+
+    // Luma and gradient intermediates in single and two channel textures
+    bool reducedPrecision;
+
+    // One of several views compared side by side, see FilterPlanner::plan()
+    bool comparisonView;
+
+    // Overrides imageProcessShader and the color filters if not empty
+    FilterGraph filterGraph;
+
+    FilterGraph toFilterGraph() const;
 };
 
 class ShaderBuilder : public QObject
@@ -36,21 +62,44 @@ public:
     void setMainBody(QOpenGLShader::ShaderType type, QStringList code);
     void setShaderConfig(ShaderConfig *shaderConfig);
 
+    // Fragment shaders sample layer varyingLayer of sampler2DArray inputs,
+    // the filter functions are rewritten to fetch from the layer
+    void setTextureArray(bool enabled) { m_textureArray = enabled; }
+
+    // The last pass only filters inside the regionOfInterest uniform, the
+    // rest of the image is shown unfiltered. A zero region covers it all.
+    void setRegionOfInterestEnabled(bool enabled) { m_regionOfInterest = enabled; }
+
     QStringList getShaderCode(QOpenGLShader::ShaderType type) const;
 
+    FilterPlan getFilterPlan() const;
+    QStringList getFilterPassShaderCode(QOpenGLShader::ShaderType type, int pass) const;
+
+    static int gaussianKernelRadius() { return m_kernelRadius; }
+
+    // Normalized 2D kernel of (2 * kernelRadius + 1)^2 coefficients, row by row
+    static QVector<float> computeGaussianKernel(int kernelRadius, float sigma);
+
 private:
+    // Measures the private setup paths, see benchmarks/
+    friend class SetupBenchmark;
+
     QStringList readShaderFile(const QString &path);
+    QStringList generateHeader(QOpenGLShader::ShaderType type, const QStringList &variables) const;
     QStringList generateConstants(QOpenGLShader::ShaderType type) const;
+    QStringList generateFilterPassCode(const FilterPass &pass, const QString &indent) const;
     QStringList getVariables(QOpenGLShader::ShaderType type) const;
     QStringList getMainBody(QOpenGLShader::ShaderType type) const;
-
-    static QVector<float> computeGaussianKernel(int kernelRadius, float sigma);
+    QStringList toTextureArrayCode(const QStringList &code) const;
+    QStringList toVertexShaderCode(const QStringList &mainBody) const;
 
     QString m_version;
     QMap<QOpenGLShader::ShaderType, QStringList> m_variables;
     QMap<QOpenGLShader::ShaderType, QStringList> m_mainBody;
 
     ShaderConfig *m_shaderConfig;
+    bool m_textureArray;
+    bool m_regionOfInterest;
 
     static QStringList m_vertexShaderFunctionsCode;
     static QStringList m_fragmentShaderFunctionsCode;
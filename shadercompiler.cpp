@@ -0,0 +1,177 @@
+#include "shadercompiler.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QThread>
+
+#include "tracer.h"
+
+static bool linkProgram(QOpenGLShaderProgram *program, const QString &vertexCode, const QString &fragmentCode)
+{
+    TRACE_ZONE("ShaderCompiler::linkProgram");
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexCode);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentCode);
+    if (program->link())
+        return true;
+
+    qWarning() << "Unable to link shader program: " << program->log();
+    return false;
+}
+
+ShaderCompilerWorker::ShaderCompilerWorker(QOpenGLContext *context, QOffscreenSurface *surface, QThread *resultThread)
+    : QObject()
+    , m_context(context)
+    , m_surface(surface)
+    , m_resultThread(resultThread)
+{
+    m_context->setParent(this);
+}
+
+ShaderCompilerWorker::~ShaderCompilerWorker()
+{
+    m_context->doneCurrent();
+}
+
+void ShaderCompilerWorker::compile(const QByteArray &key, const QString &vertexCode, const QString &fragmentCode)
+{
+    if (!m_context->makeCurrent(m_surface)) {
+        qWarning() << "Unable to make the shader compiler context current";
+        Q_EMIT(compiled(key, 0));
+        return;
+    }
+
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram;
+    linkProgram(program, vertexCode, fragmentCode);
+
+    // The program is used by the other context of the share group, the link
+    // has to be finished before it is handed over.
+    m_context->functions()->glFinish();
+
+    program->moveToThread(m_resultThread);
+    Q_EMIT(compiled(key, program));
+}
+
+ShaderCompiler::ShaderCompiler(QOpenGLContext *shareContext, QObject *parent)
+    : QObject(parent)
+    , m_thread(0)
+    , m_worker(0)
+    , m_surface(0)
+    , m_workerFailed(false)
+{
+    if (!shareContext || !QOpenGLContext::supportsThreadedOpenGL())
+        return;
+
+    qRegisterMetaType<QOpenGLShaderProgram *>();
+
+    // The surface has to be created on the GUI thread, the context is moved
+    // to the compiler thread together with the worker.
+    m_surface = new QOffscreenSurface;
+    m_surface->setFormat(shareContext->format());
+    m_surface->create();
+
+    QOpenGLContext *context = new QOpenGLContext;
+    context->setFormat(shareContext->format());
+    context->setShareContext(shareContext);
+    if (!context->create()) {
+        qWarning() << "Unable to create shared context, shaders are compiled on the GUI thread";
+        delete context;
+        delete m_surface;
+        m_surface = 0;
+        return;
+    }
+
+    m_thread = new QThread(this);
+    m_worker = new ShaderCompilerWorker(context, m_surface, thread());
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(finished()), m_worker, SLOT(deleteLater()));
+    connect(m_worker, SIGNAL(compiled(QByteArray,QOpenGLShaderProgram*)), this, SLOT(onCompiled(QByteArray,QOpenGLShaderProgram*)));
+
+    m_thread->start();
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+    if (m_thread) {
+        m_thread->quit();
+        m_thread->wait();
+    }
+
+    delete m_surface;
+    qDeleteAll(m_programs);
+}
+
+QByteArray ShaderCompiler::programKey(const QString &vertexCode, const QString &fragmentCode)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertexCode.toUtf8());
+    hash.addData(fragmentCode.toUtf8());
+    return hash.result();
+}
+
+QOpenGLShaderProgram *ShaderCompiler::program(const QString &vertexCode, const QString &fragmentCode)
+{
+    const QByteArray key = programKey(vertexCode, fragmentCode);
+    if (m_programs.contains(key))
+        return m_programs.value(key);
+
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram;
+    linkProgram(program, vertexCode, fragmentCode);
+    m_programs.insert(key, program);
+
+    return program;
+}
+
+QOpenGLShaderProgram *ShaderCompiler::cachedProgram(const QByteArray &key) const
+{
+    return m_programs.value(key, 0);
+}
+
+void ShaderCompiler::compileInBackground(const QString &vertexCode, const QString &fragmentCode)
+{
+    if (!isThreaded())
+        return;
+
+    const QByteArray key = programKey(vertexCode, fragmentCode);
+    if (m_programs.contains(key) || m_pendingKeys.contains(key))
+        return;
+
+    m_pendingKeys.insert(key);
+    QMetaObject::invokeMethod(m_worker, "compile", Qt::QueuedConnection,
+                              Q_ARG(QByteArray, key),
+                              Q_ARG(QString, vertexCode),
+                              Q_ARG(QString, fragmentCode));
+}
+
+void ShaderCompiler::onCompiled(const QByteArray &key, QOpenGLShaderProgram *program)
+{
+    m_pendingKeys.remove(key);
+
+    // Without a current context the worker cannot link anything, later
+    // programs are linked on the GUI thread
+    if (!program) {
+        m_workerFailed = true;
+        Q_EMIT(programFailed(key));
+        return;
+    }
+
+    // The same program may have been linked synchronously in the meantime
+    if (m_programs.contains(key)) {
+        delete program;
+        return;
+    }
+
+    // A failed link must not replace a working program in the cache
+    if (!program->isLinked()) {
+        delete program;
+        Q_EMIT(programFailed(key));
+        return;
+    }
+
+    m_programs.insert(key, program);
+    Q_EMIT(programReady(key));
+}
@@ -0,0 +1,75 @@
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLShaderProgram;
+class QThread;
+
+// Lives on the compiler thread and links programs on a context which is
+// shared with the widget's context, so the linked programs can be used there.
+class ShaderCompilerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ShaderCompilerWorker(QOpenGLContext *context, QOffscreenSurface *surface, QThread *resultThread);
+    ~ShaderCompilerWorker();
+
+public Q_SLOTS:
+    void compile(const QByteArray &key, const QString &vertexCode, const QString &fragmentCode);
+
+signals:
+    void compiled(const QByteArray &key, QOpenGLShaderProgram *program);
+
+private:
+    QOpenGLContext *m_context;
+    QOffscreenSurface *m_surface;
+    QThread *m_resultThread;
+};
+
+// Caches linked shader programs by their source code. Programs can be linked
+// synchronously on the current context or in the background on a worker
+// thread if the platform supports threaded OpenGL.
+class ShaderCompiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ShaderCompiler(QOpenGLContext *shareContext, QObject *parent = 0);
+    ~ShaderCompiler();
+
+    static QByteArray programKey(const QString &vertexCode, const QString &fragmentCode);
+
+    bool isThreaded() const { return m_thread != 0 && !m_workerFailed; }
+
+    QOpenGLShaderProgram *program(const QString &vertexCode, const QString &fragmentCode);
+    QOpenGLShaderProgram *cachedProgram(const QByteArray &key) const;
+    void compileInBackground(const QString &vertexCode, const QString &fragmentCode);
+
+signals:
+    void programReady(const QByteArray &key);
+    // The background link failed or the worker could not use its context,
+    // the program has to be linked synchronously
+    void programFailed(const QByteArray &key);
+
+private Q_SLOTS:
+    void onCompiled(const QByteArray &key, QOpenGLShaderProgram *program);
+
+private:
+    QHash<QByteArray, QOpenGLShaderProgram *> m_programs;
+    QSet<QByteArray> m_pendingKeys;
+
+    QThread *m_thread;
+    ShaderCompilerWorker *m_worker;
+    QOffscreenSurface *m_surface;
+    bool m_workerFailed;
+};
+
+#endif // SHADERCOMPILER_H
@@ -1,6 +1,7 @@
 const int GaussianKernelRadius = -1 // WILL BE GENERATED
 const vec4 GaussianKernel[1] = (vec4(-1.0)) // WILL BE GENERATED
 const float pi = -1.0; // WILL BE GENERATED
+const float ColorLutSize = -1.0; // WILL BE GENERATED
 
 const mat3 SobelMaskX = mat3(-1.0, 0.0, 1.0,
                              -2.0, 0.0, 2.0,
@@ -35,6 +36,25 @@ vec4 invert(vec4 color)
     return vec4(vec3(1.0) - color.rgb, color.a);
 }
 
+// Region of interest in texture coordinates, left, bottom, right and top.
+// An empty region covers the whole image.
+bool insideRegion(vec2 coords, vec4 region)
+{
+    if (region.z <= region.x)
+        return true;
+
+    return all(greaterThanEqual(coords, region.xy)) && all(lessThan(coords, region.zw));
+}
+
+// Point-wise operations baked by ColorLut, the coordinates are moved onto the
+// texel centres so the ends of the range are not interpolated with the
+// border.
+vec4 applyColorLut(sampler3D lut, vec4 color)
+{
+    vec3 coords = (clamp(color.rgb, 0.0, 1.0) * (ColorLutSize - 1.0) + 0.5) / ColorLutSize;
+    return vec4(texture3D(lut, coords).rgb, color.a);
+}
+
 vec4 gaussBlur(sampler2D tex,
                vec2 textureSize,
                vec2 coords)
@@ -116,10 +136,8 @@ float gradientStrength(vec4 gradient[2])
    return length(vec2(dx, dy));
 }
 
-vec2 gradientDirection(vec4 gradient[2]) {
-    float dx = lightness(gradient[0]);
-    float dy = lightness(gradient[1]);
-
+vec2 edgeDirection(float dx, float dy)
+{
     float x = abs(atan(dy, dx));
     if (x > pi)
         x -= pi;
@@ -142,6 +160,10 @@ vec2 gradientDirection(vec4 gradient[2]) {
     return vec2(1.0, 0.0);
 }
 
+vec2 gradientDirection(vec4 gradient[2]) {
+    return edgeDirection(lightness(gradient[0]), lightness(gradient[1]));
+}
+
 vec4 canny(sampler2D tex,
            vec2 textureSize,
            vec2 coords)
@@ -171,3 +193,366 @@ vec4 canny(sampler2D tex,
 
     return vec4(1.0);
 }
+
+// Sobel gradient of the lightness, the result is signed so it has to be
+// rendered into a floating point target.
+vec4 lumaGradient(sampler2D tex,
+                  vec2 textureSize,
+                  vec2 coords)
+{
+    float dxtex = 1.0 / textureSize[0];
+    float dytex = 1.0 / textureSize[1];
+
+    vec2 gradient = vec2(0.0);
+
+    for (int i = -1; i <= 1; ++i) {
+        for (int j = -1; j <= 1; ++j) {
+            float l = lightness(texture2D(tex, coords + vec2(float(i) * dxtex, float(j) * dytex)));
+            gradient += l * vec2(SobelMaskX[i+1][j+1], SobelMaskY[i+1][j+1]);
+        }
+    }
+
+    return vec4(gradient, 0.0, 1.0);
+}
+
+// Canny's non-max suppression reading a gradient field rendered by
+// lumaGradient() instead of recomputing the blurred gradients.
+vec4 suppressNonMaxEdges(sampler2D gradientTex,
+                         vec2 textureSize,
+                         vec2 coords)
+{
+    vec2 gradient = texture2D(gradientTex, coords).rg;
+    float strength = length(gradient);
+    const float threshold = 0.2;
+
+    if (strength < threshold)
+        return vec4(0.0, 0.0, 0.0, 1.0);
+
+    vec2 offset = edgeDirection(gradient.x, gradient.y) / textureSize;
+
+    float forwardStrength = length(texture2D(gradientTex, coords + offset).rg);
+    float backwardStrength = length(texture2D(gradientTex, coords - offset).rg);
+
+    // Non-max suppression
+    if (forwardStrength > strength || backwardStrength > strength)
+        return vec4(0.0, 0.0, 0.0, 1.0);
+
+    return vec4(1.0);
+}
+
+// Dual filter blur, a pyramid of half resolution passes. textureSize is the
+// size of the target: on the way down the diagonal taps fall on the corners
+// between the input texels, so every fetch averages four of them.
+vec4 dualDownsample(sampler2D tex,
+                    vec2 textureSize,
+                    vec2 coords)
+{
+    vec2 halfTexel = 0.5 / textureSize;
+
+    vec4 color = texture2D(tex, coords) * 4.0;
+    color += texture2D(tex, coords - halfTexel);
+    color += texture2D(tex, coords + halfTexel);
+    color += texture2D(tex, coords + vec2(halfTexel.x, -halfTexel.y));
+    color += texture2D(tex, coords - vec2(halfTexel.x, -halfTexel.y));
+
+    return color / 8.0;
+}
+
+// On the way up a ring of eight taps around the pixel, the diagonal ones
+// weighted twice, interpolates the smaller level without blocks.
+vec4 dualUpsample(sampler2D tex,
+                  vec2 textureSize,
+                  vec2 coords)
+{
+    vec2 halfTexel = 0.5 / textureSize;
+
+    vec4 color = texture2D(tex, coords + vec2(-2.0 * halfTexel.x, 0.0));
+    color += texture2D(tex, coords + vec2(2.0 * halfTexel.x, 0.0));
+    color += texture2D(tex, coords + vec2(0.0, -2.0 * halfTexel.y));
+    color += texture2D(tex, coords + vec2(0.0, 2.0 * halfTexel.y));
+    color += texture2D(tex, coords + vec2(-halfTexel.x, halfTexel.y)) * 2.0;
+    color += texture2D(tex, coords + vec2(halfTexel.x, halfTexel.y)) * 2.0;
+    color += texture2D(tex, coords + vec2(halfTexel.x, -halfTexel.y)) * 2.0;
+    color += texture2D(tex, coords + vec2(-halfTexel.x, -halfTexel.y)) * 2.0;
+
+    return color / 12.0;
+}
+
+// Values summed into a summed area table are centred around zero, which
+// keeps the sums of a large image within the precision of a float. With
+// moments the table holds the luma and its square, and the luma of the
+// pixel itself is kept unsummed in the blue channel.
+vec4 integralInput(vec4 color, bool moments)
+{
+    if (!moments)
+        return color - vec4(0.5);
+
+    float l = lightness(color) - 0.5;
+    return vec4(l, l * l, l + 0.5, 0.0);
+}
+
+// One pass of the summed area table: a parallel prefix sum of radix 4 along
+// direction, every texel adds the texels stride, 2 * stride and 3 * stride
+// before it. The first pass converts its input with integralInput().
+vec4 prefixSum(sampler2D tex,
+               vec2 textureSize,
+               vec2 coords,
+               vec2 direction,
+               float stride,
+               bool first,
+               bool moments)
+{
+    vec4 mask = moments ? vec4(1.0, 1.0, 0.0, 0.0) : vec4(1.0);
+    float position = dot(floor(coords * textureSize), direction);
+
+    vec4 sum = texture2D(tex, coords);
+    if (first)
+        sum = integralInput(sum, moments);
+
+    for (int i = 1; i < 4; ++i) {
+        float offset = float(i) * stride;
+        if (position >= offset) {
+            vec4 texel = texture2D(tex, coords - direction * offset / textureSize);
+            if (first)
+                texel = integralInput(texel, moments);
+            sum += mask * texel;
+        }
+    }
+
+    return sum;
+}
+
+// Entry of a summed area table, the sum of the texels up to and including
+// texel. Rows and columns before the image sum to zero.
+vec4 tableEntry(sampler2D table, vec2 textureSize, vec2 texel)
+{
+    if (texel.x < 0.0 || texel.y < 0.0)
+        return vec4(0.0);
+
+    return texture2D(table, (texel + 0.5) / textureSize);
+}
+
+// Sum of the square window of the given radius around the pixel from the
+// four corners of a summed area table, clipped to the image.
+vec4 windowSum(sampler2D table,
+               vec2 textureSize,
+               vec2 coords,
+               float radius,
+               out float area)
+{
+    vec2 pixel = floor(coords * textureSize);
+    vec2 lower = max(pixel - vec2(radius + 1.0), vec2(-1.0));
+    vec2 upper = min(pixel + vec2(radius), textureSize - 1.0);
+    area = (upper.x - lower.x) * (upper.y - lower.y);
+
+    return tableEntry(table, textureSize, upper)
+            - tableEntry(table, textureSize, vec2(lower.x, upper.y))
+            - tableEntry(table, textureSize, vec2(upper.x, lower.y))
+            + tableEntry(table, textureSize, lower);
+}
+
+vec4 boxFilter(sampler2D table,
+               vec2 textureSize,
+               vec2 coords,
+               float radius)
+{
+    float area;
+    vec4 sum = windowSum(table, textureSize, coords, radius, area);
+
+    return vec4(sum.rgb / area + 0.5, 1.0);
+}
+
+// Sauvola's threshold, the mean of the window lowered where its deviation
+// is small, so uneven illumination does not turn whole regions black.
+// With k = 0 it is Bradley's threshold at the local mean, without margin.
+vec4 adaptiveThreshold(sampler2D table,
+                       vec2 textureSize,
+                       vec2 coords,
+                       float radius,
+                       float k)
+{
+    float area;
+    vec4 sum = windowSum(table, textureSize, coords, radius, area);
+
+    float mean = sum.r / area;
+    float deviation = sqrt(max(sum.g / area - mean * mean, 0.0));
+    float t = (mean + 0.5) * (1.0 + k * (deviation / 0.5 - 1.0));
+
+    float l = texture2D(table, coords).b;
+    float i = l < t ? 0.0 : 1.0;
+    return vec4(i, i, i, 1.0);
+}
+
+// Branchless compare and exchange, the building block of the median
+// networks below: afterwards a holds the smaller and b the larger value of
+// every channel.
+void minMax(inout vec4 a, inout vec4 b)
+{
+    vec4 smaller = min(a, b);
+    b = max(a, b);
+    a = smaller;
+}
+
+// Median of the 3x3 neighbourhood of every channel by forgetful selection
+// (Paeth, McGuire): the minimum and the maximum of any 6 of the 9 texels
+// cannot be their median. Every round moves the minimum and the maximum of
+// the candidates to their ends with min/max exchanges, drops both and takes
+// in the next texel, until one is left. 9 fetches and 20 exchanges, the
+// same for every pixel.
+vec4 median3x3(sampler2D tex,
+               vec2 textureSize,
+               vec2 coords)
+{
+    vec2 texel = 1.0 / textureSize;
+
+    vec4 v[9];
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 3; ++i)
+            v[i + 3 * j] = texture2D(tex, coords + vec2(float(i - 1), float(j - 1)) * texel);
+    }
+
+    minMax(v[0], v[3]); minMax(v[1], v[4]); minMax(v[2], v[5]); minMax(v[0], v[1]);
+    minMax(v[0], v[2]); minMax(v[3], v[5]); minMax(v[4], v[5]);
+    minMax(v[1], v[4]); minMax(v[2], v[6]); minMax(v[1], v[2]); minMax(v[1], v[3]);
+    minMax(v[4], v[6]); minMax(v[3], v[6]);
+    minMax(v[2], v[4]); minMax(v[3], v[7]); minMax(v[2], v[3]); minMax(v[4], v[7]);
+    minMax(v[3], v[8]); minMax(v[3], v[4]); minMax(v[4], v[8]);
+    return vec4(v[4].rgb, 1.0);
+}
+
+// The same selection over the 5x5 neighbourhood, starting with 14
+// candidates: 25 fetches and 132 exchanges instead of sorting 25 values.
+vec4 median5x5(sampler2D tex,
+               vec2 textureSize,
+               vec2 coords)
+{
+    vec2 texel = 1.0 / textureSize;
+
+    vec4 v[25];
+    for (int j = 0; j < 5; ++j) {
+        for (int i = 0; i < 5; ++i)
+            v[i + 5 * j] = texture2D(tex, coords + vec2(float(i - 2), float(j - 2)) * texel);
+    }
+
+    minMax(v[0], v[7]); minMax(v[1], v[8]); minMax(v[2], v[9]); minMax(v[3], v[10]);
+    minMax(v[4], v[11]); minMax(v[5], v[12]); minMax(v[6], v[13]); minMax(v[0], v[1]);
+    minMax(v[0], v[2]); minMax(v[0], v[3]); minMax(v[0], v[4]); minMax(v[0], v[5]);
+    minMax(v[0], v[6]); minMax(v[7], v[13]); minMax(v[8], v[13]); minMax(v[9], v[13]);
+    minMax(v[10], v[13]); minMax(v[11], v[13]); minMax(v[12], v[13]);
+    minMax(v[1], v[8]); minMax(v[2], v[9]); minMax(v[3], v[10]); minMax(v[4], v[11]);
+    minMax(v[5], v[12]); minMax(v[6], v[14]); minMax(v[1], v[2]); minMax(v[1], v[3]);
+    minMax(v[1], v[4]); minMax(v[1], v[5]); minMax(v[1], v[6]); minMax(v[1], v[7]);
+    minMax(v[8], v[14]); minMax(v[9], v[14]); minMax(v[10], v[14]); minMax(v[11], v[14]);
+    minMax(v[12], v[14]); minMax(v[7], v[14]);
+    minMax(v[2], v[8]); minMax(v[3], v[9]); minMax(v[4], v[10]); minMax(v[5], v[11]);
+    minMax(v[6], v[12]); minMax(v[7], v[15]); minMax(v[2], v[3]); minMax(v[2], v[4]);
+    minMax(v[2], v[5]); minMax(v[2], v[6]); minMax(v[2], v[7]); minMax(v[8], v[15]);
+    minMax(v[9], v[15]); minMax(v[10], v[15]); minMax(v[11], v[15]); minMax(v[12], v[15]);
+    minMax(v[3], v[9]); minMax(v[4], v[10]); minMax(v[5], v[11]); minMax(v[6], v[12]);
+    minMax(v[7], v[16]); minMax(v[3], v[4]); minMax(v[3], v[5]); minMax(v[3], v[6]);
+    minMax(v[3], v[7]); minMax(v[3], v[8]); minMax(v[9], v[16]); minMax(v[10], v[16]);
+    minMax(v[11], v[16]); minMax(v[12], v[16]); minMax(v[8], v[16]);
+    minMax(v[4], v[9]); minMax(v[5], v[10]); minMax(v[6], v[11]); minMax(v[7], v[12]);
+    minMax(v[8], v[17]); minMax(v[4], v[5]); minMax(v[4], v[6]); minMax(v[4], v[7]);
+    minMax(v[4], v[8]); minMax(v[9], v[17]); minMax(v[10], v[17]); minMax(v[11], v[17]);
+    minMax(v[12], v[17]);
+    minMax(v[5], v[10]); minMax(v[6], v[11]); minMax(v[7], v[12]); minMax(v[8], v[18]);
+    minMax(v[5], v[6]); minMax(v[5], v[7]); minMax(v[5], v[8]); minMax(v[5], v[9]);
+    minMax(v[10], v[18]); minMax(v[11], v[18]); minMax(v[12], v[18]); minMax(v[9], v[18]);
+    minMax(v[6], v[10]); minMax(v[7], v[11]); minMax(v[8], v[12]); minMax(v[9], v[19]);
+    minMax(v[6], v[7]); minMax(v[6], v[8]); minMax(v[6], v[9]); minMax(v[10], v[19]);
+    minMax(v[11], v[19]); minMax(v[12], v[19]);
+    minMax(v[7], v[11]); minMax(v[8], v[12]); minMax(v[9], v[20]); minMax(v[7], v[8]);
+    minMax(v[7], v[9]); minMax(v[7], v[10]); minMax(v[11], v[20]); minMax(v[12], v[20]);
+    minMax(v[10], v[20]);
+    minMax(v[8], v[11]); minMax(v[9], v[12]); minMax(v[10], v[21]); minMax(v[8], v[9]);
+    minMax(v[8], v[10]); minMax(v[11], v[21]); minMax(v[12], v[21]);
+    minMax(v[9], v[12]); minMax(v[10], v[22]); minMax(v[9], v[10]); minMax(v[9], v[11]);
+    minMax(v[12], v[22]); minMax(v[11], v[22]);
+    minMax(v[10], v[12]); minMax(v[11], v[23]); minMax(v[10], v[11]); minMax(v[12], v[23]);
+    minMax(v[11], v[24]); minMax(v[11], v[12]); minMax(v[12], v[24]);
+    return vec4(v[12].rgb, 1.0);
+}
+
+// One axis of the separable approximation of a bilateral filter (Pham and
+// van Vliet): a Gaussian of the distance along direction with a sigma of
+// half the radius, weighted by a Gaussian of the color difference to the
+// pixel, so edges well above sigmaRange are not blurred across. A pass
+// takes 2 * radius + 1 fetches, the rows and then the columns 4 * radius + 2
+// instead of the (2 * radius + 1)^2 of the full window.
+vec4 bilateralPass(sampler2D tex,
+                   vec2 textureSize,
+                   vec2 coords,
+                   vec2 direction,
+                   float radius,
+                   float sigmaRange)
+{
+    vec2 texel = direction / textureSize;
+    float spatialScale = -2.0 / (radius * radius);
+    float rangeScale = -0.5 / (sigmaRange * sigmaRange);
+
+    vec3 center = texture2D(tex, coords).rgb;
+    vec3 sum = center;
+    float weightSum = 1.0;
+
+    for (float offset = 1.0; offset <= radius; offset += 1.0) {
+        float spatial = exp(offset * offset * spatialScale);
+
+        vec3 before = texture2D(tex, coords - offset * texel).rgb;
+        vec3 difference = before - center;
+        float weight = spatial * exp(dot(difference, difference) * rangeScale);
+        sum += before * weight;
+        weightSum += weight;
+
+        vec3 after = texture2D(tex, coords + offset * texel).rgb;
+        difference = after - center;
+        weight = spatial * exp(dot(difference, difference) * rangeScale);
+        sum += after * weight;
+        weightSum += weight;
+    }
+
+    return vec4(sum / weightSum, 1.0);
+}
+
+// Fast approximate anti-aliasing of the final image, after Timothy Lottes'
+// FXAA: the luma contrast of the diagonal neighbours finds the edges, which
+// are blurred along their direction by up to 8 texels. Flat regions return
+// after 5 fetches, edges take 9.
+vec4 fxaa(sampler2D tex,
+          vec2 textureSize,
+          vec2 coords)
+{
+    vec2 texel = 1.0 / textureSize;
+    vec3 lumaWeights = vec3(0.299, 0.587, 0.114);
+
+    vec4 color = texture2D(tex, coords);
+    float luma = dot(color.rgb, lumaWeights);
+    float lumaNW = dot(texture2D(tex, coords + vec2(-1.0, -1.0) * texel).rgb, lumaWeights);
+    float lumaNE = dot(texture2D(tex, coords + vec2(1.0, -1.0) * texel).rgb, lumaWeights);
+    float lumaSW = dot(texture2D(tex, coords + vec2(-1.0, 1.0) * texel).rgb, lumaWeights);
+    float lumaSE = dot(texture2D(tex, coords + vec2(1.0, 1.0) * texel).rgb, lumaWeights);
+
+    float lumaMin = min(luma, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(luma, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(0.0312, lumaMax * 0.125))
+        return color;
+
+    // Perpendicular to the gradient, the shorter component is stretched so
+    // nearly horizontal and vertical edges are followed further
+    vec2 direction = vec2((lumaSW + lumaSE) - (lumaNW + lumaNE), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * 0.125, 1.0 / 128.0);
+    float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * scale, -8.0, 8.0) * texel;
+
+    vec3 inner = 0.5 * (texture2D(tex, coords - direction / 6.0).rgb
+                        + texture2D(tex, coords + direction / 6.0).rgb);
+    vec3 outer = 0.5 * inner + 0.25 * (texture2D(tex, coords - direction / 2.0).rgb
+                                       + texture2D(tex, coords + direction / 2.0).rgb);
+
+    // The wider blur is dropped where it reaches past the edge
+    float lumaOuter = dot(outer, lumaWeights);
+    if (lumaOuter < lumaMin || lumaOuter > lumaMax)
+        return vec4(inner, color.a);
+
+    return vec4(outer, color.a);
+}
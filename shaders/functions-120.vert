@@ -0,0 +1,34 @@
+// Procedural displacements of a vertex, driven by the time in seconds. The
+// position is in the space of the object fitted into the cube from -1 to 1,
+// so the amplitudes do not depend on the size of the loaded mesh.
+
+// Two sine waves travelling across the xz plane lift the vertices.
+vec3 waves(vec3 position, float time)
+{
+    float height = 0.08 * sin(6.0 * (position.x + position.z) - 3.0 * time)
+            + 0.04 * sin(9.0 * (position.x - 0.5 * position.z) + 2.3 * time);
+    return position + vec3(0.0, height, 0.0);
+}
+
+// Rotation around the y axis which grows with the height, swinging back
+// and forth.
+vec3 twist(vec3 position, float time)
+{
+    float angle = 1.5 * sin(time) * position.y;
+    float c = cos(angle);
+    float s = sin(angle);
+    return vec3(c * position.x - s * position.z, position.y, s * position.x + c * position.z);
+}
+
+// Pushes the vertices out and back again. The meshes have no normals, the
+// direction from the centre stands in for them, which is exact on the
+// sphere.
+vec3 explode(vec3 position, float time)
+{
+    float distance = length(position);
+    if (distance < 0.0001)
+        return position;
+
+    float offset = 0.25 - 0.25 * cos(time);
+    return position + position / distance * offset;
+}
@@ -0,0 +1,585 @@
+#include "thumbnailgallery.h"
+
+#include <math.h>
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QPainter>
+#include <QVector2D>
+#include <QtConcurrent>
+
+#include "colorlut.h"
+#include "shadercompiler.h"
+#include "tracer.h"
+
+namespace {
+
+// x, y for the offscreen passes, s, t for both the passes and the grid
+const GLfloat quadVertices[] = {
+    -1.0, -1.0, 0.0, 0.0,
+     1.0, -1.0, 1.0, 0.0,
+    -1.0,  1.0, 0.0, 1.0,
+     1.0,  1.0, 1.0, 1.0,
+};
+
+// Enough to fill a screen of thumbnails in a few frames without stalling
+// the frame which uploads them
+const int MaximumUploadsPerFrame = 16;
+const int MaximumFilteredLayersPerFrame = 16;
+
+const int ColorLutUnit = 2;
+
+} // namespace
+
+ThumbnailGallery::ThumbnailGallery(QObject *parent)
+    : QObject(parent)
+    , m_shaderCompiler(0)
+    , m_programsDirty(true)
+    , m_decoderWatcher(new QFutureWatcher<void>(this))
+    , m_loadedCount(0)
+    , m_instancesDirty(false)
+    , m_thumbnails(0)
+    , m_framebuffer(0)
+    , m_program(0)
+    , m_scrollRow(0.0)
+    , m_firstVisible(0)
+    , m_visibleCount(0)
+{
+    m_intermediates[0] = 0;
+    m_intermediates[1] = 0;
+
+    m_shaderConfig.animEnabled = false;
+    m_shaderConfig.vertexShader = ShaderConfig::NoVertexShader;
+    m_shaderConfig.gray = false;
+    m_shaderConfig.invert = false;
+    m_shaderConfig.threshold = false;
+    m_shaderConfig.imageProcessShader = ShaderConfig::None;
+    m_shaderConfig.reducedPrecision = false;
+    m_shaderConfig.comparisonView = false;
+
+    connect(m_decoderWatcher, SIGNAL(progressValueChanged(int)), this, SLOT(onDecoderProgress()));
+    connect(m_decoderWatcher, SIGNAL(finished()), this, SLOT(onDecoderProgress()));
+}
+
+ThumbnailGallery::~ThumbnailGallery()
+{
+    clear();
+    qDeleteAll(m_colorLuts);
+    if (m_framebuffer)
+        glDeleteFramebuffers(1, &m_framebuffer);
+    m_quadBuffer.destroy();
+    m_instanceBuffer.destroy();
+}
+
+bool ThumbnailGallery::isSupported(QOpenGLContext *context)
+{
+    // Texture arrays and instanced arrays, both core since OpenGL 3.3
+    const QSurfaceFormat format = context->format();
+    return !context->isOpenGLES()
+            && format.version() >= qMakePair(3, 3)
+            && context->hasExtension("GL_EXT_texture_array");
+}
+
+void ThumbnailGallery::initialize(ShaderCompiler *shaderCompiler)
+{
+    initializeOpenGLFunctions();
+    m_shaderCompiler = shaderCompiler;
+
+    m_quadBuffer.create();
+    m_quadBuffer.bind();
+    m_quadBuffer.allocate(quadVertices, sizeof(quadVertices));
+    m_quadBuffer.release();
+
+    m_instanceBuffer.create();
+    m_instanceBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+
+    glGenFramebuffers(1, &m_framebuffer);
+}
+
+void ThumbnailGallery::setImages(const QStringList &paths)
+{
+    clear();
+
+    GLint maximumLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maximumLayers);
+    m_paths = paths.mid(0, maximumLayers);
+    if (m_paths.count() < paths.count())
+        qWarning() << "Gallery limited to" << maximumLayers << "of" << paths.count() << "images";
+
+    if (m_paths.isEmpty())
+        return;
+
+    m_thumbnails = new QOpenGLTexture(QOpenGLTexture::Target2DArray);
+    m_thumbnails->setLayers(m_paths.count());
+    m_thumbnails->setSize(ThumbnailSize, ThumbnailSize);
+    m_thumbnails->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    m_thumbnails->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    m_thumbnails->setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_thumbnails->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+
+    m_instances.resize(m_paths.count() * 2);
+    m_loadedLayers.fill(false, m_paths.count());
+    for (int layer = 0; layer < m_paths.count(); ++layer) {
+        m_instances[2 * layer] = layer;
+        m_instances[2 * layer + 1] = 0.0;
+    }
+    m_instancesDirty = true;
+    m_programsDirty = true;
+
+    // The tasks are decoded in folder order, so the first screen comes first
+    for (int layer = 0; layer < m_paths.count(); ++layer) {
+        DecodeTask task = { layer, m_paths.at(layer) };
+        m_decodeTasks.append(task);
+    }
+
+    m_decoderWatcher->setFuture(QtConcurrent::map(m_decodeTasks, [this](DecodeTask &task) {
+        const QImage thumbnail = decodeThumbnail(task.path);
+        QMutexLocker locker(&m_decodedMutex);
+        m_decodedThumbnails.append(qMakePair(task.layer, thumbnail));
+    }));
+}
+
+void ThumbnailGallery::setShaderConfig(const ShaderConfig &shaderConfig)
+{
+    // The passes are only rebuilt when the chain itself has changed
+    if (shaderConfig.toFilterGraph().toString() == m_shaderConfig.toFilterGraph().toString())
+        return;
+
+    m_shaderConfig = shaderConfig;
+    m_programsDirty = true;
+}
+
+void ThumbnailGallery::scroll(double rows)
+{
+    m_scrollRow = qMax(0.0, m_scrollRow + rows);
+}
+
+int ThumbnailGallery::thumbnailAt(const QPoint &position, const QSize &viewportSize) const
+{
+    const int columns = columnCount(viewportSize);
+    const int column = position.x() / CellSize;
+    const int row = floor((position.y() + m_scrollRow * CellSize) / CellSize);
+    if (position.x() < 0 || column >= columns || row < 0)
+        return -1;
+
+    const int index = row * columns + column;
+    return index < m_paths.count() ? index : -1;
+}
+
+void ThumbnailGallery::paint(const QSize &viewportSize)
+{
+    TRACE_ZONE("ThumbnailGallery::paint");
+    if (!m_thumbnails)
+        return;
+
+    const int columns = columnCount(viewportSize);
+    const int rowCount = (m_paths.count() + columns - 1) / columns;
+    const double maximumScrollRow = qMax(0.0, rowCount - double(viewportSize.height()) / CellSize);
+    m_scrollRow = qMin(m_scrollRow, maximumScrollRow);
+
+    const int firstRow = floor(m_scrollRow);
+    const int visibleRows = viewportSize.height() / CellSize + 2;
+    m_firstVisible = firstRow * columns;
+    m_visibleCount = qBound(0, m_paths.count() - m_firstVisible, visibleRows * columns);
+
+    if (m_programsDirty)
+        updatePrograms();
+    uploadPendingThumbnails();
+    filterPendingLayers();
+    drawThumbnails(viewportSize);
+}
+
+qint64 ThumbnailGallery::memoryBytes() const
+{
+    const qint64 layerBytes = qint64(ThumbnailSize) * ThumbnailSize * 4;
+    int arrays = m_thumbnails ? 1 : 0;
+    for (int i = 0; i < 2; ++i) {
+        if (m_intermediates[i])
+            arrays += (m_intermediates[i]->format() == QOpenGLTexture::RGBA32F) ? 4 : 1;
+    }
+
+    qint64 lutBytes = 0;
+    foreach (QOpenGLTexture *colorLut, m_colorLuts) {
+        if (colorLut)
+            lutBytes += ColorLut::Size * ColorLut::Size * ColorLut::Size * 4;
+    }
+
+    return arrays * layerBytes * m_paths.count() + lutBytes;
+}
+
+QString ThumbnailGallery::statistics() const
+{
+    return QString("Gallery: %0/%1 thumbnails, %2 visible in 1 draw, %3 filter passes")
+            .arg(m_loadedCount)
+            .arg(m_paths.count())
+            .arg(m_visibleCount)
+            .arg(m_passPrograms.count() + 1);
+}
+
+void ThumbnailGallery::onDecoderProgress()
+{
+    emit thumbnailReady();
+}
+
+QImage ThumbnailGallery::decodeThumbnail(const QString &path)
+{
+    TRACE_ZONE("ThumbnailGallery::decodeThumbnail");
+    QImageReader reader(path);
+
+    // Readers which support it (JPEG) decode at the reduced size directly
+    const QSize imageSize = reader.size();
+    if (imageSize.isValid() && (imageSize.width() > ThumbnailSize || imageSize.height() > ThumbnailSize))
+        reader.setScaledSize(imageSize.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio));
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Unable to load image: " << path;
+        return QImage();
+    }
+
+    if (image.width() > ThumbnailSize || image.height() > ThumbnailSize)
+        image = image.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    // Every layer has the same size, the image is centred on black
+    QImage thumbnail(ThumbnailSize, ThumbnailSize, QImage::Format_RGBA8888);
+    thumbnail.fill(Qt::black);
+    QPainter painter(&thumbnail);
+    painter.drawImage((ThumbnailSize - image.width()) / 2, (ThumbnailSize - image.height()) / 2, image);
+
+    return thumbnail;
+}
+
+void ThumbnailGallery::clear()
+{
+    m_decoderWatcher->cancel();
+    m_decoderWatcher->waitForFinished();
+    m_decodeTasks.clear();
+    m_decodedThumbnails.clear();
+
+    delete m_thumbnails;
+    delete m_intermediates[0];
+    delete m_intermediates[1];
+    m_thumbnails = 0;
+    m_intermediates[0] = 0;
+    m_intermediates[1] = 0;
+
+    m_paths.clear();
+    m_instances.clear();
+    m_loadedLayers.clear();
+    m_unfilteredLayers.clear();
+    m_loadedCount = 0;
+    m_scrollRow = 0.0;
+    m_firstVisible = 0;
+    m_visibleCount = 0;
+}
+
+void ThumbnailGallery::updatePrograms()
+{
+    TRACE_ZONE("ThumbnailGallery::updatePrograms");
+    m_programsDirty = false;
+
+    // The reduced formats are not array renderable everywhere, so they are
+    // skipped: intermediates are RGBA8 arrays, except the summed area
+    // tables of integral image chains, which are RGBA32F arrays
+    ShaderConfig shaderConfig = m_shaderConfig;
+    shaderConfig.animEnabled = false;
+    shaderConfig.vertexShader = ShaderConfig::NoVertexShader;
+    shaderConfig.reducedPrecision = false;
+    shaderConfig.comparisonView = false;
+
+    ShaderBuilder shaderBuilder("120");
+    shaderBuilder.setTextureArray(true);
+    shaderBuilder.setShaderConfig(&shaderConfig);
+
+    // Every instance is one thumbnail, its cell follows from its layer
+    QStringList vertexVariables;
+    vertexVariables.append("uniform vec2 viewportSize;");
+    vertexVariables.append("uniform float columns;");
+    vertexVariables.append("uniform float scrollRow;");
+    vertexVariables.append("uniform float cellSize;");
+    vertexVariables.append("uniform float thumbnailSize;");
+    vertexVariables.append("attribute vec2 textureCoordinate;");
+    vertexVariables.append("attribute vec2 instance;");
+    vertexVariables.append("varying vec2 varyingTextureCoordinate;");
+    vertexVariables.append("varying float varyingLayer;");
+
+    QStringList vertexMain;
+    vertexMain.append("float row = floor((instance.x + 0.5) / columns);");
+    vertexMain.append("vec2 cell = vec2(instance.x - row * columns, row - scrollRow);");
+    vertexMain.append("vec2 position = cell * cellSize + vec2(0.5 * (cellSize - thumbnailSize)) + textureCoordinate * thumbnailSize;");
+    vertexMain.append("varyingTextureCoordinate = textureCoordinate;");
+    vertexMain.append("varyingLayer = instance.x;");
+    // Thumbnails which are not ready collapse to a point outside the clip volume
+    vertexMain.append("gl_Position = instance.y * vec4(2.0 * position.x / viewportSize.x - 1.0, 1.0 - 2.0 * position.y / viewportSize.y, 0.0, 1.0);");
+
+    QStringList fragmentVariables;
+    fragmentVariables.append("uniform sampler2D inputTexture;");
+    fragmentVariables.append("uniform vec2 textureSize;");
+    fragmentVariables.append("varying vec2 varyingTextureCoordinate;");
+
+    QStringList fragmentMain;
+    fragmentMain.append("gl_FragColor = texture2D(inputTexture, varyingTextureCoordinate);");
+
+    shaderBuilder.setVariables(QOpenGLShader::Vertex, vertexVariables);
+    shaderBuilder.setMainBody(QOpenGLShader::Vertex, vertexMain);
+    shaderBuilder.setVariables(QOpenGLShader::Fragment, fragmentVariables);
+    shaderBuilder.setMainBody(QOpenGLShader::Fragment, fragmentMain);
+
+    m_program = m_shaderCompiler->program(shaderBuilder.getShaderCode(QOpenGLShader::Vertex).join("\n"),
+                                          shaderBuilder.getShaderCode(QOpenGLShader::Fragment).join("\n"));
+
+    const FilterPlan plan = shaderBuilder.getFilterPlan();
+    m_passPrograms.clear();
+    m_passLevels.clear();
+    for (int pass = 0; pass < plan.offscreenPassCount(); ++pass) {
+        m_passLevels.append(plan.passes.at(pass).level);
+        m_passPrograms.append(m_shaderCompiler->program(shaderBuilder.getFilterPassShaderCode(QOpenGLShader::Vertex, pass).join("\n"),
+                                                        shaderBuilder.getFilterPassShaderCode(QOpenGLShader::Fragment, pass).join("\n")));
+    }
+
+    qDeleteAll(m_colorLuts);
+    m_colorLuts.clear();
+    foreach (const FilterPass &pass, plan.passes)
+        m_colorLuts.append(pass.colorLut ? ColorLut::createTexture(pass.pointWiseNodes()) : 0);
+
+    // A summed area table needs float arrays, read texel by texel
+    bool floatIntermediates = false;
+    for (int pass = 0; pass < plan.offscreenPassCount(); ++pass)
+        floatIntermediates = floatIntermediates || plan.passes.at(pass).targetFormat == FilterPass::RGBA32F;
+    const QOpenGLTexture::TextureFormat intermediateFormat = floatIntermediates ? QOpenGLTexture::RGBA32F : QOpenGLTexture::RGBA8_UNorm;
+
+    // Two arrays are enough, every pass of a layer only reads the previous one
+    const int intermediateCount = qMin(m_passPrograms.count(), 2);
+    for (int i = 0; i < 2; ++i) {
+        if (i >= intermediateCount || !m_thumbnails || (m_intermediates[i] && m_intermediates[i]->format() != intermediateFormat)) {
+            delete m_intermediates[i];
+            m_intermediates[i] = 0;
+        }
+
+        if (i < intermediateCount && m_thumbnails && !m_intermediates[i]) {
+            m_intermediates[i] = new QOpenGLTexture(QOpenGLTexture::Target2DArray);
+            m_intermediates[i]->setLayers(m_paths.count());
+            m_intermediates[i]->setSize(ThumbnailSize, ThumbnailSize);
+            m_intermediates[i]->setFormat(intermediateFormat);
+            if (floatIntermediates)
+                m_intermediates[i]->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+            else
+                m_intermediates[i]->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+            m_intermediates[i]->setWrapMode(QOpenGLTexture::ClampToEdge);
+            if (floatIntermediates)
+                m_intermediates[i]->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::Float32);
+            else
+                m_intermediates[i]->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+        }
+    }
+
+    // Every loaded thumbnail has to go through the new passes
+    m_unfilteredLayers.clear();
+    for (int layer = 0; layer < m_loadedLayers.count(); ++layer) {
+        if (!m_loadedLayers.at(layer))
+            continue;
+
+        if (m_passPrograms.isEmpty()) {
+            setLayerVisible(layer, true);
+        } else {
+            setLayerVisible(layer, false);
+            m_unfilteredLayers.append(layer);
+        }
+    }
+}
+
+void ThumbnailGallery::uploadPendingThumbnails()
+{
+    QList<QPair<int, QImage> > thumbnails;
+    {
+        QMutexLocker locker(&m_decodedMutex);
+        const int count = qMin(m_decodedThumbnails.count(), MaximumUploadsPerFrame);
+        thumbnails = m_decodedThumbnails.mid(0, count);
+        m_decodedThumbnails.erase(m_decodedThumbnails.begin(), m_decodedThumbnails.begin() + count);
+    }
+
+    if (thumbnails.isEmpty())
+        return;
+
+    TRACE_ZONE("ThumbnailGallery::uploadPendingThumbnails");
+    for (int i = 0; i < thumbnails.count(); ++i) {
+        const int layer = thumbnails.at(i).first;
+        const QImage &thumbnail = thumbnails.at(i).second;
+        ++m_loadedCount;
+        if (thumbnail.isNull())
+            continue;
+
+        m_thumbnails->setData(0, layer, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, thumbnail.constBits());
+        m_loadedLayers[layer] = true;
+
+        if (m_passPrograms.isEmpty())
+            setLayerVisible(layer, true);
+        else
+            m_unfilteredLayers.append(layer);
+    }
+
+    // More decoded thumbnails are waiting for the next frame
+    QMutexLocker locker(&m_decodedMutex);
+    if (!m_decodedThumbnails.isEmpty())
+        emit thumbnailReady();
+}
+
+void ThumbnailGallery::filterPendingLayers()
+{
+    if (m_unfilteredLayers.isEmpty() || m_passPrograms.contains(0))
+        return;
+
+    TRACE_ZONE("ThumbnailGallery::filterPendingLayers");
+
+    // Visible thumbnails are filtered first
+    QVector<int> layers;
+    for (int i = 0; i < m_unfilteredLayers.count() && layers.count() < MaximumFilteredLayersPerFrame; ++i) {
+        const int layer = m_unfilteredLayers.at(i);
+        if (layer >= m_firstVisible && layer < m_firstVisible + m_visibleCount)
+            layers.append(layer);
+    }
+    for (int i = 0; i < m_unfilteredLayers.count() && layers.count() < MaximumFilteredLayersPerFrame; ++i) {
+        if (!layers.contains(m_unfilteredLayers.at(i)))
+            layers.append(m_unfilteredLayers.at(i));
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, ThumbnailSize, ThumbnailSize);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    m_quadBuffer.bind();
+    foreach (int layer, layers) {
+        for (int pass = 0; pass < m_passPrograms.count(); ++pass) {
+            QOpenGLTexture *input = (pass == 0) ? m_thumbnails : m_intermediates[(pass - 1) % 2];
+            QOpenGLTexture *output = m_intermediates[pass % 2];
+            QOpenGLShaderProgram *program = m_passPrograms.at(pass);
+
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, output->textureId(), 0, layer);
+
+            program->bind();
+            glActiveTexture(GL_TEXTURE0);
+            input->bind();
+            program->setUniformValue("inputTexture", 0);
+            // The layers have no pyramid, the passes of a large blur render
+            // at thumbnail size and only spread their taps as at their level
+            const GLfloat levelSize = qMax(ThumbnailSize >> m_passLevels.at(pass), 1);
+            program->setUniformValue("textureSize", QVector2D(levelSize, levelSize));
+            program->setUniformValue("layer", GLfloat(layer));
+            bindColorLut(pass, program);
+
+            program->setAttributeBuffer("vertex", GL_FLOAT, 0, 2, 4 * sizeof(GLfloat));
+            program->enableAttributeArray("vertex");
+            program->setAttributeBuffer("textureCoordinate", GL_FLOAT, 2 * sizeof(GLfloat), 2, 4 * sizeof(GLfloat));
+            program->enableAttributeArray("textureCoordinate");
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            program->disableAttributeArray("vertex");
+            program->disableAttributeArray("textureCoordinate");
+
+            input->release();
+            program->release();
+        }
+
+        m_unfilteredLayers.remove(m_unfilteredLayers.indexOf(layer));
+        setLayerVisible(layer, true);
+    }
+    m_quadBuffer.release();
+
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glEnable(GL_DEPTH_TEST);
+
+    if (!m_unfilteredLayers.isEmpty())
+        emit thumbnailReady();
+}
+
+void ThumbnailGallery::drawThumbnails(const QSize &viewportSize)
+{
+    if (!m_program || m_visibleCount == 0)
+        return;
+
+    if (m_instancesDirty) {
+        m_instanceBuffer.bind();
+        m_instanceBuffer.allocate(m_instances.constData(), m_instances.count() * sizeof(GLfloat));
+        m_instanceBuffer.release();
+        m_instancesDirty = false;
+    }
+
+    QOpenGLTexture *input = m_passPrograms.isEmpty() ? m_thumbnails : m_intermediates[(m_passPrograms.count() - 1) % 2];
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    m_program->bind();
+    glActiveTexture(GL_TEXTURE0);
+    input->bind();
+    m_program->setUniformValue("inputTexture", 0);
+    m_program->setUniformValue("textureSize", QVector2D(ThumbnailSize, ThumbnailSize));
+    m_program->setUniformValue("viewportSize", QVector2D(viewportSize.width(), viewportSize.height()));
+    m_program->setUniformValue("columns", GLfloat(columnCount(viewportSize)));
+    m_program->setUniformValue("scrollRow", GLfloat(m_scrollRow));
+    m_program->setUniformValue("cellSize", GLfloat(CellSize));
+    m_program->setUniformValue("thumbnailSize", GLfloat(ThumbnailSize));
+    bindColorLut(m_passPrograms.count(), m_program);
+
+    m_quadBuffer.bind();
+    m_program->setAttributeBuffer("textureCoordinate", GL_FLOAT, 2 * sizeof(GLfloat), 2, 4 * sizeof(GLfloat));
+    m_program->enableAttributeArray("textureCoordinate");
+    m_quadBuffer.release();
+
+    // The instances start at the first visible thumbnail
+    const int instanceLocation = m_program->attributeLocation("instance");
+    m_instanceBuffer.bind();
+    m_program->setAttributeBuffer(instanceLocation, GL_FLOAT, m_firstVisible * 2 * sizeof(GLfloat), 2, 2 * sizeof(GLfloat));
+    m_program->enableAttributeArray(instanceLocation);
+    glVertexAttribDivisor(instanceLocation, 1);
+    m_instanceBuffer.release();
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_visibleCount);
+
+    glVertexAttribDivisor(instanceLocation, 0);
+    m_program->disableAttributeArray(instanceLocation);
+    m_program->disableAttributeArray("textureCoordinate");
+
+    input->release();
+    m_program->release();
+    glActiveTexture(GL_TEXTURE0 + ColorLutUnit);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void ThumbnailGallery::setLayerVisible(int layer, bool visible)
+{
+    m_instances[2 * layer + 1] = visible ? 1.0 : 0.0;
+    m_instancesDirty = true;
+}
+
+int ThumbnailGallery::columnCount(const QSize &viewportSize) const
+{
+    return qMax(1, viewportSize.width() / CellSize);
+}
+
+void ThumbnailGallery::bindColorLut(int pass, QOpenGLShaderProgram *program)
+{
+    QOpenGLTexture *colorLut = m_colorLuts.value(pass);
+    if (!colorLut)
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + ColorLutUnit);
+    colorLut->bind();
+    glActiveTexture(GL_TEXTURE0);
+    program->setUniformValue("colorLut", ColorLutUnit);
+}
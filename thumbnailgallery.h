@@ -0,0 +1,125 @@
+#ifndef THUMBNAILGALLERY_H
+#define THUMBNAILGALLERY_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+#include <QPair>
+#include <QPoint>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+#include "shaderbuilder.h"
+
+class QOpenGLContext;
+class QOpenGLShaderProgram;
+class QOpenGLTexture;
+class ShaderCompiler;
+template <typename T> class QFutureWatcher;
+
+// Shows the images of a folder as a grid of thumbnails. The thumbnails are
+// decoded and downscaled on the thread pool and uploaded into the layers of
+// a 2D texture array as they arrive, a few of them per frame.
+//
+// The filter chain runs over every visible thumbnail in one instanced draw
+// of the last pass. Offscreen passes are rendered once per thumbnail into
+// two ping-ponged texture arrays when it arrives or the chain changes, so
+// scrolling only costs the instanced draw.
+class ThumbnailGallery : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+public:
+    static const int ThumbnailSize = 192;
+    static const int CellSize = 208;
+
+    explicit ThumbnailGallery(QObject *parent = 0);
+    ~ThumbnailGallery();
+
+    static bool isSupported(QOpenGLContext *context);
+
+    // Both need the widget's context to be current, the gallery has to be
+    // deleted with it current too
+    void initialize(ShaderCompiler *shaderCompiler);
+    void setImages(const QStringList &paths);
+
+    void setShaderConfig(const ShaderConfig &shaderConfig);
+    ShaderConfig shaderConfig() const { return m_shaderConfig; }
+
+    int imageCount() const { return m_paths.count(); }
+    int loadedCount() const { return m_loadedCount; }
+    QString imagePath(int index) const { return m_paths.value(index); }
+
+    void scroll(double rows);
+    int thumbnailAt(const QPoint &position, const QSize &viewportSize) const;
+
+    void paint(const QSize &viewportSize);
+    qint64 memoryBytes() const;
+    QString statistics() const;
+
+signals:
+    void thumbnailReady();
+
+private Q_SLOTS:
+    void onDecoderProgress();
+
+private:
+    struct DecodeTask {
+        int layer;
+        QString path;
+    };
+
+    static QImage decodeThumbnail(const QString &path);
+
+    void clear();
+    void updatePrograms();
+    void uploadPendingThumbnails();
+    void filterPendingLayers();
+    void drawThumbnails(const QSize &viewportSize);
+    void setLayerVisible(int layer, bool visible);
+    int columnCount(const QSize &viewportSize) const;
+    void bindColorLut(int pass, QOpenGLShaderProgram *program);
+
+    ShaderCompiler *m_shaderCompiler;
+    ShaderConfig m_shaderConfig;
+    bool m_programsDirty;
+
+    QStringList m_paths;
+    QVector<DecodeTask> m_decodeTasks;
+    QFutureWatcher<void> *m_decoderWatcher;
+    int m_loadedCount;
+
+    // Decoded on the thread pool and not uploaded yet
+    QMutex m_decodedMutex;
+    QList<QPair<int, QImage> > m_decodedThumbnails;
+
+    // Layer and visibility of every image, a thumbnail is shown once it has
+    // been uploaded and its offscreen passes have been rendered
+    QVector<GLfloat> m_instances;
+    QVector<bool> m_loadedLayers;
+    bool m_instancesDirty;
+
+    // Layers whose offscreen passes have to be rendered again
+    QVector<int> m_unfilteredLayers;
+
+    QOpenGLTexture *m_thumbnails;
+    QOpenGLTexture *m_intermediates[2];
+    GLuint m_framebuffer;
+    QOpenGLBuffer m_quadBuffer;
+    QOpenGLBuffer m_instanceBuffer;
+
+    QOpenGLShaderProgram *m_program;
+    QVector<QOpenGLShaderProgram *> m_passPrograms;
+    QVector<int> m_passLevels;
+    QVector<QOpenGLTexture *> m_colorLuts;
+
+    double m_scrollRow;
+    int m_firstVisible;
+    int m_visibleCount;
+};
+
+#endif // THUMBNAILGALLERY_H
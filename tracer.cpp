@@ -0,0 +1,172 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    qint64 start;
+    qint64 duration;
+};
+
+// Events beyond the capacity of a thread are counted but dropped, growing
+// the buffer would need a lock against the writer of the trace.
+const int BufferCapacity = 64 * 1024;
+
+struct ThreadBuffer {
+    int threadId;
+    QString threadName;
+    QAtomicInt count;
+    QAtomicInt dropped;
+    TraceEvent events[BufferCapacity];
+};
+
+// The buffers outlive their threads, the trace is written after the worker
+// threads have finished.
+QMutex registryMutex;
+QList<ThreadBuffer *> registry;
+QString traceOutputPath;
+QElapsedTimer traceClock;
+
+thread_local ThreadBuffer *currentBuffer = 0;
+
+ThreadBuffer *threadBuffer()
+{
+    if (currentBuffer)
+        return currentBuffer;
+
+    ThreadBuffer *buffer = new ThreadBuffer;
+    buffer->count.store(0);
+    buffer->dropped.store(0);
+
+    QMutexLocker locker(&registryMutex);
+    buffer->threadId = registry.count() + 1;
+    QThread *thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+        buffer->threadName = "Main";
+    else if (!thread->objectName().isEmpty())
+        buffer->threadName = QString("%0 %1").arg(thread->objectName()).arg(buffer->threadId);
+    else
+        buffer->threadName = QString("Thread %0").arg(buffer->threadId);
+    registry.append(buffer);
+
+    currentBuffer = buffer;
+    return buffer;
+}
+
+QString escaped(const char *name)
+{
+    QString result = QString::fromLatin1(name);
+    result.replace('\\', "\\\\");
+    result.replace('"', "\\\"");
+    return result;
+}
+
+void writeOnExit()
+{
+    Tracer::write();
+}
+
+} // namespace
+
+QAtomicInt Tracer::s_enabled(0);
+
+void Tracer::enable(const QString &outputPath)
+{
+    QMutexLocker locker(&registryMutex);
+    traceOutputPath = outputPath;
+
+    if (s_enabled.loadAcquire())
+        return;
+
+    traceClock.start();
+    qAddPostRoutine(writeOnExit);
+    s_enabled.storeRelease(1);
+}
+
+QString Tracer::outputPath()
+{
+    QMutexLocker locker(&registryMutex);
+    return traceOutputPath;
+}
+
+bool Tracer::write()
+{
+    const QString path = outputPath();
+    return !path.isEmpty() && write(path);
+}
+
+bool Tracer::write(const QString &path)
+{
+    if (!isEnabled())
+        return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Unable to write trace: " << path;
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    QMutexLocker locker(&registryMutex);
+    bool first = true;
+    foreach (ThreadBuffer *buffer, registry) {
+        out << (first ? "" : ",\n")
+            << QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%0,\"args\":{\"name\":\"%1\"}}")
+               .arg(buffer->threadId).arg(buffer->threadName);
+        first = false;
+
+        // Events up to the published count are complete, the thread may keep
+        // recording while they are written.
+        const int count = buffer->count.loadAcquire();
+        for (int i = 0; i < count; ++i) {
+            const TraceEvent &event = buffer->events[i];
+            out << QString(",\n{\"name\":\"%0\",\"cat\":\"qt-shader-demo\",\"ph\":\"X\",\"pid\":1,\"tid\":%1,\"ts\":%2,\"dur\":%3}")
+                   .arg(escaped(event.name))
+                   .arg(buffer->threadId)
+                   .arg(event.start / 1000.0, 0, 'f', 3)
+                   .arg(event.duration / 1000.0, 0, 'f', 3);
+        }
+
+        if (buffer->dropped.loadAcquire())
+            qWarning() << "Trace buffer of" << buffer->threadName << "dropped" << buffer->dropped.loadAcquire() << "events";
+    }
+
+    out << "\n]}\n";
+    return out.status() == QTextStream::Ok;
+}
+
+qint64 Tracer::now()
+{
+    return traceClock.nsecsElapsed();
+}
+
+void Tracer::record(const char *name, qint64 start, qint64 end)
+{
+    ThreadBuffer *buffer = threadBuffer();
+
+    // Only this thread writes the buffer, the release store publishes the
+    // event to write().
+    const int index = buffer->count.load();
+    if (index >= BufferCapacity) {
+        buffer->dropped.ref();
+        return;
+    }
+
+    TraceEvent &event = buffer->events[index];
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    buffer->count.storeRelease(index + 1);
+}
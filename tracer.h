@@ -0,0 +1,69 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+// Scoped zone tracer writing the Chrome trace event format, which can be
+// opened in chrome://tracing or Perfetto. Every thread records into a buffer
+// of its own without locking; when tracing is disabled a zone costs one
+// atomic load.
+//
+//   void GLWidget::paintGL()
+//   {
+//       TRACE_ZONE("GLWidget::paintGL");
+//       ...
+//   }
+//
+// Zone names must be string literals, only the pointer is recorded.
+class Tracer
+{
+public:
+    static bool isEnabled() { return s_enabled.loadAcquire(); }
+
+    // The trace is written to the output path by write() and on exit
+    static void enable(const QString &outputPath);
+    static QString outputPath();
+
+    static bool write();
+    static bool write(const QString &path);
+
+    static qint64 now();
+    static void record(const char *name, qint64 start, qint64 end);
+
+private:
+    static QAtomicInt s_enabled;
+};
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char *name)
+        : m_name(Tracer::isEnabled() ? name : 0)
+        , m_start(m_name ? Tracer::now() : 0)
+    {
+    }
+
+    ~TraceZone()
+    {
+        if (m_name)
+            Tracer::record(m_name, m_start, Tracer::now());
+    }
+
+private:
+    Q_DISABLE_COPY(TraceZone)
+
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+#if defined(QT_SHADER_DEMO_NO_TRACE)
+#define TRACE_ZONE(name)
+#else
+#define TRACE_ZONE(name) TraceZone TRACE_CONCATENATE(traceZone, __LINE__)(name)
+#endif
+
+#endif // TRACER_H
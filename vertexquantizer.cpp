@@ -0,0 +1,87 @@
+#include "vertexquantizer.h"
+
+namespace {
+
+inline QVector3D halfExtent(const QVector3D &boundsMin, const QVector3D &boundsMax)
+{
+    // Flat axes keep a unit scale so the encoding does not divide by zero
+    QVector3D half = (boundsMax - boundsMin) / 2.0;
+    return QVector3D(half.x() > 0.0f ? half.x() : 1.0f,
+                     half.y() > 0.0f ? half.y() : 1.0f,
+                     half.z() > 0.0f ? half.z() : 1.0f);
+}
+
+inline GLshort toSnorm16(float value)
+{
+    return qRound(qBound(-1.0f, value, 1.0f) * 32767.0f);
+}
+
+} // namespace
+
+void VertexQuantizer::computeBounds(const QVector3D *positions, int count, QVector3D *boundsMin, QVector3D *boundsMax)
+{
+    if (!count) {
+        *boundsMin = QVector3D();
+        *boundsMax = QVector3D();
+        return;
+    }
+
+    QVector3D minimum = positions[0];
+    QVector3D maximum = positions[0];
+    for (int i = 1; i < count; ++i) {
+        const QVector3D &position = positions[i];
+        minimum = QVector3D(qMin(minimum.x(), position.x()), qMin(minimum.y(), position.y()), qMin(minimum.z(), position.z()));
+        maximum = QVector3D(qMax(maximum.x(), position.x()), qMax(maximum.y(), position.y()), qMax(maximum.z(), position.z()));
+    }
+
+    *boundsMin = minimum;
+    *boundsMax = maximum;
+}
+
+QMatrix4x4 VertexQuantizer::positionDecodeMatrix(const QVector3D &boundsMin, const QVector3D &boundsMax)
+{
+    QMatrix4x4 matrix;
+    matrix.translate((boundsMin + boundsMax) / 2.0);
+    matrix.scale(halfExtent(boundsMin, boundsMax));
+    return matrix;
+}
+
+void VertexQuantizer::encodePositions(const QVector3D *positions, int count,
+                                      const QVector3D &boundsMin, const QVector3D &boundsMax,
+                                      GLshort *output)
+{
+    const QVector3D center = (boundsMin + boundsMax) / 2.0;
+    const QVector3D half = halfExtent(boundsMin, boundsMax);
+
+    for (int i = 0; i < count; ++i, output += 4) {
+        const QVector3D normalized = (positions[i] - center) / half;
+        output[0] = toSnorm16(normalized.x());
+        output[1] = toSnorm16(normalized.y());
+        output[2] = toSnorm16(normalized.z());
+        output[3] = 0;
+    }
+}
+
+QVector3D VertexQuantizer::decodePosition(const GLshort *encoded, const QVector3D &boundsMin, const QVector3D &boundsMax)
+{
+    const QVector3D normalized(encoded[0] / 32767.0f, encoded[1] / 32767.0f, encoded[2] / 32767.0f);
+    return (boundsMin + boundsMax) / 2.0 + normalized * halfExtent(boundsMin, boundsMax);
+}
+
+void VertexQuantizer::encodeColors(const QVector3D *colors, int count, GLubyte *output)
+{
+    for (int i = 0; i < count; ++i, output += 4) {
+        output[0] = qRound(qBound(0.0f, colors[i].x(), 1.0f) * 255.0f);
+        output[1] = qRound(qBound(0.0f, colors[i].y(), 1.0f) * 255.0f);
+        output[2] = qRound(qBound(0.0f, colors[i].z(), 1.0f) * 255.0f);
+        output[3] = 255;
+    }
+}
+
+void VertexQuantizer::encodeTextureCoordinates(const QVector2D *coordinates, int count, GLushort *output)
+{
+    for (int i = 0; i < count; ++i, output += 2) {
+        output[0] = qRound(qBound(0.0f, coordinates[i].x(), 1.0f) * 65535.0f);
+        output[1] = qRound(qBound(0.0f, coordinates[i].y(), 1.0f) * 65535.0f);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef VERTEXQUANTIZER_H
+#define VERTEXQUANTIZER_H
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <QVector2D>
+#include <QVector3D>
+
+// Compact vertex attribute encodings, all of them are read by the vertex
+// shader as normalized integers:
+//
+//   position            3 x snorm16 + padding, relative to the bounds
+//   color               3 x unorm8 + padding
+//   texture coordinate  2 x unorm16, clamped to [0, 1]
+//
+// The positions map the bounds onto [-1, 1], positionDecodeMatrix() maps
+// them back and is multiplied into the model matrix.
+class VertexQuantizer
+{
+public:
+    static const int PositionStride = 4 * sizeof(GLshort);
+    static const int ColorStride = 4 * sizeof(GLubyte);
+    static const int TextureCoordinateStride = 2 * sizeof(GLushort);
+
+    static void computeBounds(const QVector3D *positions, int count, QVector3D *boundsMin, QVector3D *boundsMax);
+    static QMatrix4x4 positionDecodeMatrix(const QVector3D &boundsMin, const QVector3D &boundsMax);
+
+    static void encodePositions(const QVector3D *positions, int count,
+                                const QVector3D &boundsMin, const QVector3D &boundsMax,
+                                GLshort *output);
+    static QVector3D decodePosition(const GLshort *encoded, const QVector3D &boundsMin, const QVector3D &boundsMax);
+
+    static void encodeColors(const QVector3D *colors, int count, GLubyte *output);
+    static void encodeTextureCoordinates(const QVector2D *coordinates, int count, GLushort *output);
+};
+
+#endif // VERTEXQUANTIZER_H